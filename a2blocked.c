@@ -2,14 +2,16 @@
 
 #include <a2blocked.h>
 #include "uarray2b.h"
+#include "a2parallel.h"
 
 // define a private version of each function in A2Methods_T that we implement
 
 typedef A2Methods_UArray2 A2;   // private abbreviation
 
+/* the default block size fits the caches of the machine; see cacheblock.h */
 static A2 new(int width, int height, int size)
 {
-        return UArray2b_new_64K_block(width, height, size);
+        return UArray2b_new_cache_block(width, height, size);
 }
 
 static A2 new_with_blocksize(int width, int height, int size, int blocksize)
@@ -72,6 +74,47 @@ static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
         UArray2b_map(a2, apply_small, &mycl);
 }
 
+// parallel versions: one task per block of the grid that UArray2b_map walks,
+// shared by the workers through work-stealing deques (see a2parallel.h for
+// the "disjoint-element" contract apply must follow)
+
+struct block_closure {
+        UArray2b_T array2b;
+        applyfun *apply;
+        void *cl;
+        int blocks_wide;
+};
+
+static void map_one_block(int task, void *vcl)
+{
+        struct block_closure *cl = vcl;
+        UArray2b_map_block(cl->array2b, task % cl->blocks_wide,
+                           task / cl->blocks_wide, cl->apply, cl->cl);
+}
+
+static void parallel_map(A2 array2, applyfun *apply, void *cl)
+{
+        int bs = UArray2b_blocksize(array2);
+        int blocks_wide = (UArray2b_width(array2) + bs - 1) / bs;
+        int blocks_high = (UArray2b_height(array2) + bs - 1) / bs;
+        struct block_closure mycl = { array2, apply, cl, blocks_wide };
+        A2Parallel_run(blocks_wide * blocks_high, map_one_block, &mycl);
+}
+
+static void parallel_map_block_major(A2 array2, A2Methods_applyfun apply,
+                                     void *cl)
+{
+        parallel_map(array2, (applyfun *) apply, cl);
+}
+
+static void parallel_small_map_block_major(A2 a2,
+                                           A2Methods_smallapplyfun apply,
+                                           void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        parallel_map(a2, apply_small, &mycl);
+}
+
 static struct A2Methods_T uarray2_methods_blocked_struct = {
         new,
         new_with_blocksize,
@@ -94,3 +137,25 @@ static struct A2Methods_T uarray2_methods_blocked_struct = {
 // finally the payoff: here is the exported pointer to the struct
 
 A2Methods_T uarray2_methods_blocked = &uarray2_methods_blocked_struct;
+
+static struct A2Methods_T uarray2_methods_blocked_parallel_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                           // map_row_major
+        NULL,                           // map_col_major
+        parallel_map_block_major,
+        parallel_map_block_major,       // map_default
+        NULL,                           // small_map_row_major
+        NULL,                           // small_map_col_major
+        parallel_small_map_block_major,
+        parallel_small_map_block_major, // small_map_default
+};
+
+A2Methods_T uarray2_methods_blocked_parallel =
+        &uarray2_methods_blocked_parallel_struct;
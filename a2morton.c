@@ -0,0 +1,165 @@
+/*
+ *     a2morton.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the A2Methods_T suite for UArray2m, the
+ *            array stored in Morton order, like a2blocked.c does for
+ *            UArray2b. The default map walks the elements in storage order;
+ *            there is no row, column, or block major map. The parallel
+ *            version runs one piece (an aligned square) of the array per
+ *            task.
+ */
+
+#include <string.h>
+
+#include "a2morton.h"
+#include "uarray2m.h"
+#include "a2parallel.h"
+
+typedef A2Methods_UArray2 A2;   // private abbreviation
+
+static A2 new(int width, int height, int size)
+{
+        return UArray2m_new(width, height, size);
+}
+
+/* Morton order needs no block size; the given one is not used */
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        (void) blocksize;
+        return UArray2m_new(width, height, size);
+}
+
+static void a2free(A2 * array2p)
+{
+        UArray2m_free((UArray2m_T *) array2p);
+}
+
+static int width(A2 array2)
+{
+        return UArray2m_width(array2);
+}
+static int height(A2 array2)
+{
+        return UArray2m_height(array2);
+}
+static int size(A2 array2)
+{
+        return UArray2m_size(array2);
+}
+
+/* the side of the squares the parallel map hands out */
+static int blocksize(A2 array2)
+{
+        return UArray2m_pieceEdge(array2);
+}
+
+static A2Methods_Object *at(A2 array2, int i, int j)
+{
+        return UArray2m_at(array2, i, j);
+}
+
+typedef void applyfun(int i, int j, UArray2m_T array2m, void *elem, void *cl);
+
+static void map_morton(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        UArray2m_map(array2, (applyfun *) apply, cl);
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void *cl;
+};
+
+static void apply_small(int i, int j, UArray2m_T array2, void *elem, void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)array2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_morton(A2 a2, A2Methods_smallapplyfun apply, void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        UArray2m_map(a2, apply_small, &mycl);
+}
+
+// parallel versions: one task per piece of the array, in storage order, so
+// every worker starts on squares that are stored together (see a2parallel.h
+// for the "disjoint-element" contract apply must follow)
+
+struct piece_closure {
+        UArray2m_T array2m;
+        applyfun *apply;
+        void *cl;
+};
+
+static void map_one_piece(int task, void *vcl)
+{
+        struct piece_closure *cl = vcl;
+        UArray2m_map_piece(cl->array2m, task, cl->apply, cl->cl);
+}
+
+static void parallel_map(A2 array2, applyfun *apply, void *cl)
+{
+        struct piece_closure mycl = { array2, apply, cl };
+        A2Parallel_run(UArray2m_pieces(array2), map_one_piece, &mycl);
+}
+
+static void parallel_map_morton(A2 array2, A2Methods_applyfun apply, void *cl)
+{
+        parallel_map(array2, (applyfun *) apply, cl);
+}
+
+static void parallel_small_map_morton(A2 a2, A2Methods_smallapplyfun apply,
+                                      void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        parallel_map(a2, apply_small, &mycl);
+}
+
+static struct A2Methods_T uarray2_methods_morton_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                   // map_row_major
+        NULL,                   // map_col_major
+        NULL,                   // map_block_major
+        map_morton,             // map_default
+        NULL,                   // small_map_row_major
+        NULL,                   // small_map_col_major
+        NULL,                   // small_map_block_major
+        small_map_morton,       // small_map_default
+};
+
+A2Methods_T uarray2_methods_morton = &uarray2_methods_morton_struct;
+
+static struct A2Methods_T uarray2_methods_morton_parallel_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                           // map_row_major
+        NULL,                           // map_col_major
+        NULL,                           // map_block_major
+        parallel_map_morton,            // map_default
+        NULL,                           // small_map_row_major
+        NULL,                           // small_map_col_major
+        NULL,                           // small_map_block_major
+        parallel_small_map_morton,      // small_map_default
+};
+
+A2Methods_T uarray2_methods_morton_parallel =
+        &uarray2_methods_morton_parallel_struct;
@@ -0,0 +1,19 @@
+/*
+ *     a2morton.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file declares the A2Methods_T suite of UArray2m arrays,
+ *            which store their elements in Morton (Z) order. Its only map is
+ *            map_default, which visits the elements in that order. The
+ *            parallel version of the suite is declared in a2parallel.h.
+ */
+
+#ifndef A2MORTON_INCLUDED
+#define A2MORTON_INCLUDED
+
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_morton;
+
+#endif
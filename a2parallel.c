@@ -0,0 +1,182 @@
+/*
+ *     a2parallel.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file runs the tasks of a parallel map on the thread pool.
+ *            Every worker starts with a deque holding an equal share of the
+ *            task indices. It takes tasks from the bottom of its own deque,
+ *            and when that is empty it steals from the top of the deques of
+ *            the others, so workers that got cheap tasks (for example the
+ *            partly used blocks at the right and bottom edges of a UArray2b)
+ *            help the ones that got expensive tasks.
+ *
+ *            No task is added after the start, so a deque is just the range
+ *            [top, bottom) of task indices, packed in one 64 bit word that is
+ *            only changed with compare-and-swap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <mem.h>
+
+#include "assert.h"
+#include "a2parallel.h"
+#include "threadpool.h"
+
+/**********struct deque********
+ * About: This struct holds the task range of one worker: the top index in
+ *        the upper 32 bits and the bottom index (one past the last task) in
+ *        the lower 32 bits. It is padded to a cache line so that workers do
+ *        not slow each other down when they update their own deques.
+************************/
+struct deque {
+        uint64_t range;
+        char padding[64 - sizeof(uint64_t)];
+};
+
+/**********struct runParameters********
+ * About: This struct holds an A2Parallel_run call for the workers
+************************/
+struct runParameters {
+        A2Parallel_task *run;
+        void *cl;
+        int workers;
+        struct deque *deques;
+};
+
+static ThreadPool_T parallelPool = NULL;
+
+static void stealingWorker(int worker, void *runStruct);
+static bool takeBottom(struct deque *deque, int *task);
+static bool stealTop(struct deque *deque, int *task);
+
+/**********A2Parallel_setPool********
+ * About: This function sets the thread pool used by the parallel map
+ *        functions
+ * Inputs:
+ * ThreadPool_T pool: the pool to use; NULL to run maps on the calling thread
+ * Return: none
+ * Note: The pool still belongs to the caller, who must not free it while the
+ * parallel suites may use it.
+************************/
+void A2Parallel_setPool(ThreadPool_T pool)
+{
+        parallelPool = pool;
+}
+
+/**********A2Parallel_run********
+ * About: This function calls run(task, cl) once for every task index from 0
+ *        to tasks - 1, on the workers of the pool, and returns when all of
+ *        them are done. Without a pool, the tasks run in increasing order on
+ *        the calling thread.
+ * Inputs:
+ * int tasks: number of tasks, at least 0
+ * A2Parallel_task run: the function to run for every task
+ * void *cl: client pointer handed to run
+ * Return: none
+ * Expects
+ * - tasks to be at least 0 and run to be nonnull; throws CRE otherwise
+************************/
+void A2Parallel_run(int tasks, A2Parallel_task run, void *cl)
+{
+        assert(tasks >= 0 && run != NULL);
+
+        if (parallelPool == NULL || tasks <= 1) {
+                for (int task = 0; task < tasks; task++)
+                        run(task, cl);
+                return;
+        }
+
+        /* give every worker an equal, contiguous share of the tasks */
+        int workers = ThreadPool_size(parallelPool);
+        struct deque *deques = ALLOC(workers * sizeof(struct deque));
+        assert(deques != NULL);
+        for (int w = 0; w < workers; w++) {
+                uint64_t top = (uint64_t)tasks * w / workers;
+                uint64_t bottom = (uint64_t)tasks * (w + 1) / workers;
+                deques[w].range = top << 32 | bottom;
+        }
+
+        struct runParameters prm = { run, cl, workers, deques };
+        ThreadPool_run(parallelPool, stealingWorker, &prm);
+
+        FREE(deques);
+}
+
+/**********stealingWorker********
+ * About: This function is run by every worker. It empties its own deque from
+ *        the bottom, then steals from the top of the others, one victim after
+ *        the other, until every deque is empty.
+ * Inputs:
+ * int worker: index of the worker, which is also the index of its deque
+ * void *runStruct: the runParameters of the call
+ * Return: none
+************************/
+static void stealingWorker(int worker, void *runStruct)
+{
+        struct runParameters *prm = runStruct;
+        int task;
+
+        while (takeBottom(&prm->deques[worker], &task))
+                prm->run(task, prm->cl);
+
+        for (int i = 1; i < prm->workers; i++) {
+                struct deque *victim = &prm->deques[(worker + i) %
+                                                    prm->workers];
+                while (stealTop(victim, &task))
+                        prm->run(task, prm->cl);
+        }
+}
+
+/**********takeBottom********
+ * About: This function removes the last task of a deque
+ * Inputs:
+ * struct deque *deque: the deque of the calling worker
+ * int *task: where to store the removed task
+ * Return: true if a task was removed; false if the deque was empty
+************************/
+static bool takeBottom(struct deque *deque, int *task)
+{
+        uint64_t old = __atomic_load_n(&deque->range, __ATOMIC_ACQUIRE);
+        for (;;) {
+                uint32_t top = old >> 32;
+                uint32_t bottom = (uint32_t)old;
+                if (top >= bottom)
+                        return false;
+                uint64_t new = (uint64_t)top << 32 | (bottom - 1);
+                if (__atomic_compare_exchange_n(&deque->range, &old, new,
+                                                false, __ATOMIC_ACQ_REL,
+                                                __ATOMIC_ACQUIRE)) {
+                        *task = bottom - 1;
+                        return true;
+                }
+        }
+}
+
+/**********stealTop********
+ * About: This function removes the first task of another worker's deque
+ * Inputs:
+ * struct deque *deque: the deque to steal from
+ * int *task: where to store the stolen task
+ * Return: true if a task was stolen; false if the deque was empty
+************************/
+static bool stealTop(struct deque *deque, int *task)
+{
+        uint64_t old = __atomic_load_n(&deque->range, __ATOMIC_ACQUIRE);
+        for (;;) {
+                uint32_t top = old >> 32;
+                uint32_t bottom = (uint32_t)old;
+                if (top >= bottom)
+                        return false;
+                uint64_t new = (uint64_t)(top + 1) << 32 | bottom;
+                if (__atomic_compare_exchange_n(&deque->range, &old, new,
+                                                false, __ATOMIC_ACQ_REL,
+                                                __ATOMIC_ACQUIRE)) {
+                        *task = top;
+                        return true;
+                }
+        }
+}
@@ -0,0 +1,43 @@
+/*
+ *     a2parallel.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file declares the parallel versions of the plain, blocked,
+ *            and Morton A2Methods_T suites. They create, free, and access
+ *            arrays like uarray2_methods_plain, uarray2_methods_blocked, and
+ *            uarray2_methods_morton, but their map functions split the array
+ *            into row bands, column bands, blocks, or Morton pieces and run
+ *            them on the workers of a thread pool, which share the work
+ *            through work-stealing deques.
+ *
+ *            Contract for apply functions used with these suites
+ *            ("disjoint-element" contract): apply may be called for
+ *            different elements at the same time from different threads and
+ *            in no particular order between bands or blocks. It may change
+ *            the element it is given, and anything else only if no other
+ *            call changes or reads it (for example, a different element of a
+ *            different array). The closure is shared by all threads.
+ *
+ *            Until A2Parallel_setPool is given a pool, or after it is given
+ *            NULL, the map functions run on the calling thread in the same
+ *            order as the sequential suites.
+ */
+
+#ifndef A2PARALLEL_INCLUDED
+#define A2PARALLEL_INCLUDED
+
+#include "a2methods.h"
+#include "threadpool.h"
+
+extern A2Methods_T uarray2_methods_plain_parallel;
+extern A2Methods_T uarray2_methods_blocked_parallel;
+extern A2Methods_T uarray2_methods_morton_parallel;
+
+/* a piece of a parallel map: task is a band or block index */
+typedef void A2Parallel_task(int task, void *cl);
+
+extern void A2Parallel_setPool(ThreadPool_T pool);
+extern void A2Parallel_run(int tasks, A2Parallel_task run, void *cl);
+
+#endif
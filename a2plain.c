@@ -15,6 +15,10 @@
 #include <stdlib.h>
 #include <a2plain.h>
 #include "uarray2.h"
+#include "a2parallel.h"
+
+/* number of rows (or columns) in one task of a parallel map */
+#define bandSize 8
 
 /******************
  * All the possible checked runtime errors are checked by UArray2.c.
@@ -203,6 +207,111 @@ static void small_map_col_major(A2Methods_UArray2        a2,
         UArray2_map_col_major(a2, apply_small, &mycl);
 }
 
+/**********struct bandParameters********
+ * About: This struct holds the array, apply function, and closure of a
+ *        parallel map, for the tasks that visit one band each
+************************/
+struct bandParameters {
+        UArray2_T array;
+        UArray2_applyfun *apply;
+        void *cl;
+};
+
+/**********rowBand********
+ * About: This function visits the rows of one band in row major order
+ * Inputs:
+ * int task: index of the band; band i holds rows i * bandSize and up
+ * void *bandStruct: bandParameters instance of the map
+ * Return: none
+************************/
+static void rowBand(int task, void *bandStruct)
+{
+        struct bandParameters *prm = bandStruct;
+        int rowEnd = (task + 1) * bandSize;
+        if (rowEnd > UArray2_height(prm->array))
+                rowEnd = UArray2_height(prm->array);
+
+        for (int row = task * bandSize; row < rowEnd; row++) {
+                for (int col = 0; col < UArray2_width(prm->array); col++) {
+                        prm->apply(col, row, prm->array, 
+                                   UArray2_at(prm->array, col, row), prm->cl);
+                }
+        }
+}
+
+/**********colBand********
+ * About: This function visits the columns of one band in column major order
+ * Inputs:
+ * int task: index of the band; band i holds columns i * bandSize and up
+ * void *bandStruct: bandParameters instance of the map
+ * Return: none
+************************/
+static void colBand(int task, void *bandStruct)
+{
+        struct bandParameters *prm = bandStruct;
+        int colEnd = (task + 1) * bandSize;
+        if (colEnd > UArray2_width(prm->array))
+                colEnd = UArray2_width(prm->array);
+
+        for (int col = task * bandSize; col < colEnd; col++) {
+                for (int row = 0; row < UArray2_height(prm->array); row++) {
+                        prm->apply(col, row, prm->array, 
+                                   UArray2_at(prm->array, col, row), prm->cl);
+                }
+        }
+}
+
+/**********parallelMap********
+ * About: This function runs one task for every band of rows or columns on
+ *        the workers set with A2Parallel_setPool. apply must follow the
+ *        "disjoint-element" contract described in a2parallel.h.
+ * Inputs:
+ * UArray2_T array: 2D array that is used to store data
+ * UArray2_applyfun *apply: the function to be applied on all the elements
+ * void *cl: client specific pointer input
+ * A2Parallel_task band: rowBand or colBand
+ * int lines: number of rows (for rowBand) or columns (for colBand)
+ * Return: none
+************************/
+static void parallelMap(UArray2_T array, UArray2_applyfun *apply, void *cl,
+                        A2Parallel_task band, int lines)
+{
+        struct bandParameters prm = { array, apply, cl };
+        A2Parallel_run((lines + bandSize - 1) / bandSize, band, &prm);
+}
+
+static void parallel_map_row_major(A2Methods_UArray2 uarray2,
+                                   A2Methods_applyfun apply,
+                                   void *cl)
+{
+        parallelMap(uarray2, (UArray2_applyfun*)apply, cl, rowBand,
+                    UArray2_height(uarray2));
+}
+
+static void parallel_map_col_major(A2Methods_UArray2 uarray2,
+                                   A2Methods_applyfun apply,
+                                   void *cl)
+{
+        parallelMap(uarray2, (UArray2_applyfun*)apply, cl, colBand,
+                    UArray2_width(uarray2));
+}
+
+static void parallel_small_map_row_major(A2Methods_UArray2        a2,
+                                         A2Methods_smallapplyfun  apply,
+                                         void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        parallelMap(a2, apply_small, &mycl, rowBand, UArray2_height(a2));
+}
+
+static void parallel_small_map_col_major(A2Methods_UArray2        a2,
+                                         A2Methods_smallapplyfun  apply,
+                                         void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        parallelMap(a2, apply_small, &mycl, colBand, UArray2_width(a2));
+}
+
 /**********struct A2Methods_T********
  * About: This struct wraps the functions for UArray2 in the A2Methods_T suite
  *        format
@@ -228,3 +337,29 @@ static struct A2Methods_T uarray2_methods_plain_struct = {
 
 
 A2Methods_T uarray2_methods_plain = &uarray2_methods_plain_struct;
+
+/**********struct A2Methods_T (parallel)********
+ * About: This struct wraps the same functions, except that the map functions
+ *        split the array into bands and run them on the thread pool
+************************/
+static struct A2Methods_T uarray2_methods_plain_parallel_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        parallel_map_row_major,
+        parallel_map_col_major,
+        NULL,
+        parallel_map_row_major,              /* map_default */
+        parallel_small_map_row_major,
+        parallel_small_map_col_major,
+        NULL,
+        parallel_small_map_row_major,        /* small map_default */
+};
+
+A2Methods_T uarray2_methods_plain_parallel = 
+        &uarray2_methods_plain_parallel_struct;
@@ -0,0 +1,445 @@
+/*
+ *     batch.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the batch mode. Every image is a job run by
+ *            operationHandler with its own input and output files. With a
+ *            thread pool, the workers take whole jobs from a shared counter,
+ *            so several images are read, rotated, and written at once (each
+ *            one on a single thread); without one, the jobs run in order on
+ *            the calling thread.
+ *
+ *            Each worker keeps the last array it is done with as a spare and
+ *            uses it again for the next image of the same size, so a batch of
+ *            same-size images does not allocate a new image buffer for every
+ *            job. When a worker starts a job, it asks the kernel to read ahead
+ *            the input of the job that will come after it, so that file is
+ *            read from disk while this one is rotated.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <mem.h>
+#include <except.h>
+
+#include "assert.h"
+#include "batch.h"
+#include "operations.h"
+#include "threadpool.h"
+#include "pnm.h"
+
+/**********struct job********
+ * About: This struct holds the input and output file names of one image
+************************/
+struct job {
+        char *input;
+        char *output;
+};
+
+/**********struct batch********
+ * About: This struct holds a whole batchRun call for the workers. next is
+ *        the index of the next job nobody has taken yet and failed the number
+ *        of jobs that could not be done; both are only changed with atomic
+ *        adds.
+************************/
+struct batch {
+        struct job *jobs;
+        int count;
+        int capacity;
+        int next;
+        int failed;
+        int workers;
+        A2Methods_T methods;
+        int rotation;
+        A2Methods_mapfun *map;
+        struct operationOptions *options;
+};
+
+static void addJob(struct batch *batch, const char *input, const char *output,
+                   const char *outDir);
+static void readManifest(struct batch *batch, char *list, char *outDir);
+static void readDirectory(struct batch *batch, char *list, char *outDir);
+static int compareJobs(const void *a, const void *b);
+static void batchWorker(int worker, void *batchStruct);
+static bool runJob(struct batch *batch, struct job *job,
+                   struct operationOptions *options);
+static void readAhead(struct batch *batch, int index);
+static bool isPpm(FILE *fp);
+static bool headerNumber(FILE *fp, unsigned *number);
+
+/**********batchRun********
+ * About: This function does the given operation on every image of a
+ *        manifest or a directory and writes each result to its output file
+ * Inputs:
+ * char *list: a manifest file, with one "input [output]" pair per line
+ * (blank lines and lines starting with '#' are skipped), or a directory,
+ * whose files are all inputs
+ * char *outDir: directory for the outputs not named in the manifest; NULL if
+ * every output is named
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * int rotation: The rotation type provided by the user
+ * A2Methods_mapfun *map: the mapping function to copy pixels, or NULL to use
+ * the tiled kernels; it must not be from a parallel suite
+ * struct operationOptions *options: the choices of the user; with a pool,
+ * its workers share the images
+ * Return: the number of images that could not be done
+ * Expects
+ * - list, methods, and options to be nonnull; throws CRE otherwise
+ * - the list to be readable and every output to have a name; prints an
+ *   error and exits otherwise
+ * Note: A file that is not a ppm is skipped with an error and counts as
+ * not done; the other images are still done.
+************************/
+int batchRun(char *list, char *outDir, A2Methods_T methods, int rotation,
+             A2Methods_mapfun *map, struct operationOptions *options)
+{
+        assert(list != NULL && methods != NULL && options != NULL);
+
+        struct batch batch = { NULL, 0, 0, 0, 0, 1, methods, rotation, map,
+                               options };
+        struct stat info;
+        if (stat(list, &info) == 0 && S_ISDIR(info.st_mode))
+                readDirectory(&batch, list, outDir);
+        else
+                readManifest(&batch, list, outDir);
+
+        if (options->pool != NULL && batch.count > 1) {
+                batch.workers = ThreadPool_size(options->pool);
+                ThreadPool_run(options->pool, batchWorker, &batch);
+        } else {
+                batchWorker(0, &batch);
+        }
+
+        for (int i = 0; i < batch.count; i++) {
+                FREE(batch.jobs[i].input);
+                FREE(batch.jobs[i].output);
+        }
+        FREE(batch.jobs);
+        return batch.failed;
+}
+
+/**********addJob********
+ * About: This function adds a job to the batch. Without an output name, the
+ *        output is the file of outDir with the name of the input.
+ * Inputs:
+ * struct batch *batch: the batch
+ * const char *input: name of the input file
+ * const char *output: name of the output file; NULL to use outDir
+ * const char *outDir: the output directory; may be NULL if output is not
+ * Return: none
+ * Expects
+ * - output or outDir to be nonnull; prints an error and exits otherwise
+************************/
+static void addJob(struct batch *batch, const char *input, const char *output,
+                   const char *outDir)
+{
+        if (output == NULL && outDir == NULL) {
+                fprintf(stderr, "No output for %s: name it in the manifest "
+                                "or give -out-dir\n", input);
+                exit(EXIT_FAILURE);
+        }
+
+        if (batch->count == batch->capacity) {
+                batch->capacity = batch->capacity == 0 ?
+                                  16 : 2 * batch->capacity;
+                if (batch->jobs == NULL)
+                        batch->jobs = ALLOC(batch->capacity *
+                                            sizeof(struct job));
+                else
+                        RESIZE(batch->jobs, batch->capacity *
+                                            sizeof(struct job));
+        }
+
+        struct job *job = &batch->jobs[batch->count++];
+        job->input = ALLOC(strlen(input) + 1);
+        strcpy(job->input, input);
+        if (output != NULL) {
+                job->output = ALLOC(strlen(output) + 1);
+                strcpy(job->output, output);
+        } else {
+                const char *name = strrchr(input, '/');
+                name = name == NULL ? input : name + 1;
+                job->output = ALLOC(strlen(outDir) + strlen(name) + 2);
+                sprintf(job->output, "%s/%s", outDir, name);
+        }
+}
+
+/**********readManifest********
+ * About: This function adds a job for every line of a manifest file
+ * Inputs:
+ * struct batch *batch: the batch
+ * char *list: name of the manifest
+ * char *outDir: the output directory; may be NULL
+ * Return: none
+ * Expects
+ * - the manifest to be readable; prints an error and exits otherwise
+************************/
+static void readManifest(struct batch *batch, char *list, char *outDir)
+{
+        FILE *fp = fopen(list, "r");
+        if (fp == NULL) {
+                fprintf(stderr, "Batch list %s cannot be opened\n", list);
+                exit(EXIT_FAILURE);
+        }
+
+        char *line = NULL;
+        size_t length = 0;
+        while (getline(&line, &length, fp) != -1) {
+                char *rest;
+                char *input = strtok_r(line, " \t\r\n", &rest);
+                if (input == NULL || *input == '#')
+                        continue;
+                char *output = strtok_r(NULL, " \t\r\n", &rest);
+                addJob(batch, input, output, outDir);
+        }
+
+        free(line);
+        fclose(fp);
+}
+
+/**********readDirectory********
+ * About: This function adds a job for every regular file of a directory
+ *        whose name does not start with '.', in the order of the names
+ * Inputs:
+ * struct batch *batch: the batch
+ * char *list: name of the directory
+ * char *outDir: the output directory; NULL is an error
+ * Return: none
+************************/
+static void readDirectory(struct batch *batch, char *list, char *outDir)
+{
+        DIR *dir = opendir(list);
+        if (dir == NULL) {
+                fprintf(stderr, "Batch directory %s cannot be opened\n", list);
+                exit(EXIT_FAILURE);
+        }
+
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+                if (entry->d_name[0] == '.')
+                        continue;
+                char *input = ALLOC(strlen(list) + strlen(entry->d_name) + 2);
+                sprintf(input, "%s/%s", list, entry->d_name);
+                struct stat info;
+                if (stat(input, &info) == 0 && S_ISREG(info.st_mode))
+                        addJob(batch, input, NULL, outDir);
+                FREE(input);
+        }
+        closedir(dir);
+
+        if (batch->count > 0)
+                qsort(batch->jobs, batch->count, sizeof(struct job),
+                      compareJobs);
+}
+
+/**********compareJobs********
+ * About: This function orders two jobs by the names of their inputs, for
+ *        qsort
+ * Inputs:
+ * const void *a, const void *b: the jobs
+ * Return: less than, equal to, or greater than 0 like strcmp
+************************/
+static int compareJobs(const void *a, const void *b)
+{
+        return strcmp(((const struct job *)a)->input,
+                      ((const struct job *)b)->input);
+}
+
+/**********batchWorker********
+ * About: This function is run by every worker. It takes jobs until every job
+ *        has been taken, with its own copy of the options: no pool (the job
+ *        runs on this worker only) and its own spare array.
+ * Inputs:
+ * int worker: index of the calling worker (unused)
+ * void *batchStruct: the batch
+ * Return: none
+************************/
+static void batchWorker(int worker, void *batchStruct)
+{
+        (void) worker;
+        struct batch *batch = batchStruct;
+        A2Methods_UArray2 spare = NULL;
+        struct operationOptions options = *batch->options;
+        options.pool = NULL;
+        options.spare = &spare;
+
+        for (;;) {
+                int index = __atomic_fetch_add(&batch->next, 1,
+                                               __ATOMIC_RELAXED);
+                if (index >= batch->count)
+                        break;
+
+                /* the job this worker will most likely take next */
+                readAhead(batch, index + batch->workers);
+                if (!runJob(batch, &batch->jobs[index], &options))
+                        __atomic_fetch_add(&batch->failed, 1,
+                                           __ATOMIC_RELAXED);
+        }
+
+        if (spare != NULL)
+                batch->methods->free(&spare);
+}
+
+/**********runJob********
+ * About: This function opens the files of a job and runs operationHandler
+ *        on them
+ * Inputs:
+ * struct batch *batch: the batch the job belongs to
+ * struct job *job: the job
+ * struct operationOptions *options: the options of the calling worker
+ * Return: true if the image was written; false if a file could not be opened
+ *         or written, or the input is not a ppm (an error is printed and
+ *         the output is removed)
+ * Note: Hanson's exceptions keep one stack of handlers for the whole
+ *       process, so TRY is only safe on the calling thread. The header of
+ *       every input is checked before it is read; that catches the files
+ *       that are not ppms on the workers of a pool too, and TRY catches the
+ *       rest (a broken P3 image, say) when the jobs run in order.
+************************/
+static bool runJob(struct batch *batch, struct job *job,
+                   struct operationOptions *options)
+{
+        /* writing over the input would destroy it before it is read */
+        char inputPath[PATH_MAX], outputPath[PATH_MAX];
+        if (realpath(job->input, inputPath) != NULL &&
+            realpath(job->output, outputPath) != NULL &&
+            strcmp(inputPath, outputPath) == 0) {
+                fprintf(stderr, "%s: output is the input; skipped\n",
+                        job->input);
+                return false;
+        }
+
+        FILE *in = fopen(job->input, "r");
+        if (in == NULL) {
+                fprintf(stderr, "%s cannot be opened for reading\n",
+                        job->input);
+                return false;
+        }
+        FILE *out = fopen(job->output, "w");
+        if (out == NULL) {
+                fprintf(stderr, "%s cannot be opened for writing\n",
+                        job->output);
+                fclose(in);
+                return false;
+        }
+
+        options->inputFile = job->input;
+        options->output = out;
+        volatile bool ppm = isPpm(in);
+        if (ppm && batch->workers > 1) {
+                operationHandler(in, batch->methods, batch->rotation,
+                                 batch->map, options);
+        } else if (ppm) {
+                TRY
+                        operationHandler(in, batch->methods, batch->rotation,
+                                         batch->map, options);
+                EXCEPT(Pnm_Badformat)
+                        /* the timer of the image was on its stack */
+                        options->phases = NULL;
+                        ppm = false;
+                END_TRY;
+        }
+
+        fclose(in);
+        if (!ppm) {
+                fprintf(stderr, "%s is not a ppm image; skipped\n",
+                        job->input);
+                fclose(out);
+                unlink(job->output);
+                return false;
+        }
+        if (fclose(out) != 0) {
+                fprintf(stderr, "%s could not be written\n", job->output);
+                return false;
+        }
+        return true;
+}
+
+/**********readAhead********
+ * About: This function asks the kernel to start reading the input of a job
+ *        into the page cache, without waiting for it
+ * Inputs:
+ * struct batch *batch: the batch
+ * int index: index of the job; nothing is done past the last job
+ * Return: none
+************************/
+static void readAhead(struct batch *batch, int index)
+{
+        if (index >= batch->count)
+                return;
+        int fd = open(batch->jobs[index].input, O_RDONLY);
+        if (fd < 0)
+                return;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+}
+
+/**********isPpm********
+ * About: This function checks the header of an input: "P3" or "P6", the
+ *        width, the height, and a maxval from 1 to 65535. For a P6 file,
+ *        the file must also be long enough for all of its pixels.
+ * Inputs:
+ * FILE *fp: the input, at its start; it is put back at its start
+ * Return: true if the header is that of a ppm image
+************************/
+static bool isPpm(FILE *fp)
+{
+        unsigned width, height, maxval;
+        bool ok = getc(fp) == 'P';
+        int kind = ok ? getc(fp) : EOF;
+        ok = (kind == '3' || kind == '6') &&
+             headerNumber(fp, &width) && headerNumber(fp, &height) &&
+             headerNumber(fp, &maxval) && isspace(getc(fp)) &&
+             width > 0 && height > 0 && maxval > 0 && maxval <= 65535;
+
+        struct stat info;
+        if (ok && kind == '6' && fstat(fileno(fp), &info) == 0 &&
+            S_ISREG(info.st_mode)) {
+                size_t pixelBytes = (size_t)width * height *
+                                    (maxval > 255 ? 6 : 3);
+                long at = ftell(fp);
+                ok = at >= 0 && (size_t)(info.st_size - at) >= pixelBytes;
+        }
+
+        rewind(fp);
+        return ok;
+}
+
+/**********headerNumber********
+ * About: This function reads a number of a ppm header, skipping the white
+ *        space and the comments (from '#' to the end of the line) before it
+ * Inputs:
+ * FILE *fp: the input
+ * unsigned *number: where to store the number
+ * Return: true if a number was found before the end of the file
+************************/
+static bool headerNumber(FILE *fp, unsigned *number)
+{
+        int c = getc(fp);
+        while (isspace(c) || c == '#') {
+                if (c == '#')
+                        while (c != '\n' && c != EOF)
+                                c = getc(fp);
+                c = getc(fp);
+        }
+        if (!isdigit(c))
+                return false;
+
+        *number = 0;
+        while (isdigit(c)) {
+                *number = *number * 10 + (c - '0');
+                c = getc(fp);
+        }
+        ungetc(c, fp);
+        return true;
+}
@@ -0,0 +1,24 @@
+/*
+ *     batch.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the batch mode, which does the same operation on
+ *            many images in one process. The images are listed in a manifest
+ *            file (one "input [output]" pair per line) or are the files of a
+ *            directory; outputs that are not named go to an output directory
+ *            under the name of their input. With several threads, each one
+ *            does whole images, instead of the threads sharing one image.
+ */
+
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED
+
+#include "a2methods.h"
+#include "operations.h"
+
+extern int batchRun(char *list, char *outDir, A2Methods_T methods,
+                    int rotation, A2Methods_mapfun *map,
+                    struct operationOptions *options);
+
+#endif
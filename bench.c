@@ -0,0 +1,737 @@
+/*
+ *     bench.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file is the benchmark harness run by "make bench". It times
+ *            rotate() on synthetic images for every combination of method
+ *            (row, col, block, or Morton major, copied per pixel by the map,
+ *            scattering or gathering, or by the tiled kernels), operation,
+ *            image size, and block size, the same way ppmtrans does the
+ *            operation. Every combination is run a few times untimed to warm
+ *            the caches, then timed over several trials.
+ *            The median, 95th percentile, and median per pixel are written as
+ *            CSV and/or JSON, and can be checked against a baseline CSV file
+ *            written by an earlier run: the program fails if a median got
+ *            slower than the baseline by more than a threshold, or if the
+ *            baseline has none of the combinations that were run. A
+ *            combination is the same only with the same number of threads
+ *            and with or without -counters.
+ *
+ *            The destination array is made once per combination with the
+ *            block size being measured and handed to rotate() as the spare
+ *            array, so the trials time the copy, not the allocation.
+ *
+ *            With -counters, the hardware counters of cputiming.h are read
+ *            around every trial too, and their mean per pixel (and the
+ *            instructions per cycle) are added to every result, so the cache
+ *            and TLB misses behind each time can be compared. They count the
+ *            main thread only, so they describe -threads 1 runs best; the
+ *            thread count is a column of the results for that reason too.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <mem.h>
+
+#include "assert.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "a2morton.h"
+#include "a2parallel.h"
+#include "pnm.h"
+#include "operations.h"
+#include "threadpool.h"
+#include "cputiming.h"
+
+#define maxList 32
+
+/**********struct config********
+ * About: This struct holds one way of doing an operation: the method name
+ *        of the ppmtrans option, the suite, whether the map copies the pixels
+ *        (-per-pixel) or the kernels do, the block size (0 for plain
+ *        arrays), and whether the map scatters or gathers the pixels
+************************/
+struct config {
+        const char *method;
+        A2Methods_T methods;
+        bool perPixel;
+        int blocksize;
+        int traversal;
+};
+
+/**********struct result********
+ * About: This struct holds the measurements of one combination, in
+ *        nanoseconds
+************************/
+struct result {
+        struct config config;
+        int rotation;
+        int width;
+        int height;
+        int threads;
+        bool counters;
+        double median;
+        double p95;
+        int counterMask;
+        double perPixel[CPUTime_counterCount];
+};
+
+/**********struct benchOptions********
+ * About: This struct holds the command line choices of the harness
+************************/
+struct benchOptions {
+        int widths[maxList];
+        int heights[maxList];
+        int sizes;
+        int blocksizes[maxList];
+        int blocksizeCount;
+        int warmup;
+        int trials;
+        int threads;
+        char *csvFile;
+        char *jsonFile;
+        char *baselineFile;
+        double threshold; /* allowed slow down, in percent */
+        bool counters;
+};
+
+static const char *counterNames[CPUTime_counterCount] = {
+        "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses"
+};
+
+static const int operations[] = { rotation0, rotation90, rotation180,
+                                  rotation270, flipHorizontal, flipVertical,
+                                  transpose };
+#define operationCount ((int)(sizeof(operations) / sizeof(operations[0])))
+
+static void usage(const char *progname);
+static void parseSizes(char *list, struct benchOptions *bo);
+static int parseInts(char *list, int *numbers);
+static void measure(struct config *config, int rotation, int width,
+                    int height, struct benchOptions *bo, ThreadPool_T pool,
+                    struct result *result);
+static void fillApply(int col, int row, A2Methods_UArray2 array, void *elem,
+                      void *cl);
+static A2Methods_UArray2 newImage(struct config *config, int width,
+                                  int height);
+static int compareTimes(const void *a, const void *b);
+static const char *operationLabel(int rotation);
+static const char *copyLabel(struct config *config);
+static void csvHeader(char *header, size_t size);
+static void writeCsv(FILE *fp, struct result *results, int count);
+static void writeJson(FILE *fp, struct result *results, int count,
+                      bool counters);
+static void writeCounters(FILE *fp, struct result *result, bool json);
+static void writeCounter(FILE *fp, bool known, double value, bool json);
+static int checkBaseline(char *file, struct result *results, int count,
+                         double threshold);
+
+/**********main********
+ * About: Reads the options, runs every combination, writes the results, and
+ *        compares them to the baseline
+ * Inputs:
+ * int argc: number of given arguments to start the program
+ * char *argv: an array that stores the arguments
+ * Return: EXIT_SUCCESS, or EXIT_FAILURE if a combination got slower than the
+ *         baseline allows
+ ************************/
+int main(int argc, char *argv[])
+{
+        struct benchOptions bo;
+        memset(&bo, 0, sizeof(bo));
+        bo.warmup = 2;
+        bo.trials = 7;
+        bo.threads = 1;
+        bo.threshold = 10.0;
+        char defaultSizes[] = "257x193,1024x768,2048x1536";
+        char defaultBlocksizes[] = "8,16,32,64";
+        parseSizes(defaultSizes, &bo);
+        bo.blocksizeCount = parseInts(defaultBlocksizes, bo.blocksizes);
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-counters") == 0) {
+                        bo.counters = true;
+                        continue;
+                }
+                if (i + 1 >= argc)
+                        usage(argv[0]);
+                char *value = argv[++i];
+                if (strcmp(argv[i - 1], "-sizes") == 0)
+                        parseSizes(value, &bo);
+                else if (strcmp(argv[i - 1], "-blocksizes") == 0)
+                        bo.blocksizeCount = parseInts(value, bo.blocksizes);
+                else if (strcmp(argv[i - 1], "-warmup") == 0)
+                        bo.warmup = atoi(value);
+                else if (strcmp(argv[i - 1], "-trials") == 0)
+                        bo.trials = atoi(value);
+                else if (strcmp(argv[i - 1], "-threads") == 0)
+                        bo.threads = atoi(value);
+                else if (strcmp(argv[i - 1], "-csv") == 0)
+                        bo.csvFile = value;
+                else if (strcmp(argv[i - 1], "-json") == 0)
+                        bo.jsonFile = value;
+                else if (strcmp(argv[i - 1], "-baseline") == 0)
+                        bo.baselineFile = value;
+                else if (strcmp(argv[i - 1], "-threshold") == 0)
+                        bo.threshold = atof(value);
+                else
+                        usage(argv[0]);
+        }
+        if (bo.warmup < 0 || bo.trials < 1 || bo.threads < 1 ||
+            bo.sizes == 0)
+                usage(argv[0]);
+        if (bo.counters) {
+                CPUTime_T probe = CPUTime_New();
+                if (CPUTime_EnableCounters(probe) == 0)
+                        fprintf(stderr, "Hardware counters are not "
+                                        "available; their columns stay "
+                                        "empty\n");
+                CPUTime_Free(&probe);
+        }
+
+        /* with threads, use the parallel suites like ppmtrans -threads */
+        ThreadPool_T pool = NULL;
+        A2Methods_T plain = uarray2_methods_plain;
+        A2Methods_T blocked = uarray2_methods_blocked;
+        A2Methods_T morton = uarray2_methods_morton;
+        if (bo.threads > 1) {
+                pool = ThreadPool_new(bo.threads);
+                A2Parallel_setPool(pool);
+                plain = uarray2_methods_plain_parallel;
+                blocked = uarray2_methods_blocked_parallel;
+                morton = uarray2_methods_morton_parallel;
+        }
+
+        /* col-major only differs from row-major when the map copies, and
+         * the kernels do not know Morton arrays; every map is measured
+         * scattering and gathering */
+        struct config configs[8 + 3 * maxList];
+        int configCount = 0;
+        for (int g = 0; g < 2; g++) {
+                int traversal = g == 0 ? traversalScatter : 
+                                         traversalGather;
+                struct config rowPixel = { "row-major", plain, true, 0,
+                                           traversal };
+                struct config colPixel = { "col-major", plain, true, 0,
+                                           traversal };
+                struct config mortonPixel = { "morton-major", morton, true, 0,
+                                              traversal };
+                configs[configCount++] = rowPixel;
+                configs[configCount++] = colPixel;
+                configs[configCount++] = mortonPixel;
+        }
+        struct config rowKernel = { "row-major", plain, false, 0,
+                                    traversalScatter };
+        configs[configCount++] = rowKernel;
+        for (int b = 0; b < bo.blocksizeCount; b++) {
+                int blocksize = bo.blocksizes[b];
+                struct config blockPixel = { "block-major", blocked, true,
+                                             blocksize, traversalScatter };
+                struct config blockGather = { "block-major", blocked, true,
+                                              blocksize, traversalGather };
+                struct config blockKernel = { "block-major", blocked, false,
+                                              blocksize, traversalScatter };
+                configs[configCount++] = blockPixel;
+                configs[configCount++] = blockGather;
+                configs[configCount++] = blockKernel;
+        }
+
+        int count = configCount * operationCount * bo.sizes;
+        struct result *results = ALLOC(count * sizeof(struct result));
+        assert(results != NULL);
+        int done = 0;
+        for (int s = 0; s < bo.sizes; s++) {
+                for (int c = 0; c < configCount; c++) {
+                        for (int o = 0; o < operationCount; o++) {
+                                measure(&configs[c], operations[o],
+                                        bo.widths[s], bo.heights[s], &bo,
+                                        pool, &results[done]);
+                                done++;
+                        }
+                }
+        }
+
+        writeCsv(stdout, results, count);
+        if (bo.csvFile != NULL) {
+                FILE *fp = fopen(bo.csvFile, "w");
+                assert(fp != NULL);
+                writeCsv(fp, results, count);
+                fclose(fp);
+        }
+        if (bo.jsonFile != NULL) {
+                FILE *fp = fopen(bo.jsonFile, "w");
+                assert(fp != NULL);
+                writeJson(fp, results, count, bo.counters);
+                fclose(fp);
+        }
+
+        int regressions = 0;
+        if (bo.baselineFile != NULL)
+                regressions = checkBaseline(bo.baselineFile, results, count,
+                                            bo.threshold);
+
+        FREE(results);
+        if (pool != NULL) {
+                A2Parallel_setPool(NULL);
+                ThreadPool_free(&pool);
+        }
+        return regressions > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**********usage********
+ * About: Prints the options of the harness and exits
+ * Inputs:
+ * const char *progname: name of the program
+ * Return: none
+ ************************/
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s [-sizes WxH,...] [-blocksizes b,...] "
+                        "[-warmup n] [-trials n] [-threads n] [-csv file] "
+                        "[-json file] [-baseline file] [-threshold percent] "
+                        "[-counters]\n",
+                        progname);
+        exit(1);
+}
+
+/**********parseSizes********
+ * About: Reads a comma separated list of WxH image sizes
+ * Inputs:
+ * char *list: the list; changed by strtok
+ * struct benchOptions *bo: where to store the sizes
+ * Return: none
+ ************************/
+static void parseSizes(char *list, struct benchOptions *bo)
+{
+        bo->sizes = 0;
+        for (char *size = strtok(list, ","); size != NULL &&
+             bo->sizes < maxList; size = strtok(NULL, ",")) {
+                int width, height;
+                if (sscanf(size, "%dx%d", &width, &height) != 2 ||
+                    width < 1 || height < 1) {
+                        fprintf(stderr, "Bad image size '%s'\n", size);
+                        exit(1);
+                }
+                bo->widths[bo->sizes] = width;
+                bo->heights[bo->sizes] = height;
+                bo->sizes++;
+        }
+}
+
+/**********parseInts********
+ * About: Reads a comma separated list of positive numbers
+ * Inputs:
+ * char *list: the list; changed by strtok
+ * int *numbers: where to store the numbers, room for maxList
+ * Return: how many numbers were read
+ ************************/
+static int parseInts(char *list, int *numbers)
+{
+        int count = 0;
+        for (char *number = strtok(list, ","); number != NULL &&
+             count < maxList; number = strtok(NULL, ",")) {
+                numbers[count] = atoi(number);
+                if (numbers[count] < 1) {
+                        fprintf(stderr, "Bad number '%s'\n", number);
+                        exit(1);
+                }
+                count++;
+        }
+        return count;
+}
+
+/**********measure********
+ * About: Runs one combination: warm-up runs, then timed runs of rotate() on
+ *        a synthetic image. Every run rotates the result of the one before,
+ *        with the array it just freed as the destination.
+ * Inputs:
+ * struct config *config: the method and block size
+ * int rotation: the operation
+ * int width, int height: the image size
+ * struct benchOptions *bo: number of warm-up runs and trials
+ * ThreadPool_T pool: the workers for rotate(); may be NULL
+ * struct result *result: where to store the measurements
+ * Return: none
+ ************************/
+static void measure(struct config *config, int rotation, int width,
+                    int height, struct benchOptions *bo, ThreadPool_T pool,
+                    struct result *result)
+{
+        A2Methods_T methods = config->methods;
+        A2Methods_mapfun *map = NULL;
+        if (config->perPixel && strcmp(config->method, "col-major") == 0)
+                map = methods->map_col_major;
+        else if (config->perPixel &&
+                 strcmp(config->method, "morton-major") == 0)
+                map = methods->map_default;
+        else if (config->perPixel && config->blocksize > 0)
+                map = methods->map_block_major;
+        else if (config->perPixel)
+                map = methods->map_row_major;
+
+        struct Pnm_ppm image;
+        image.width = width;
+        image.height = height;
+        image.denominator = 255;
+        image.pixels = newImage(config, width, height);
+        image.methods = methods;
+        methods->map_default(image.pixels, fillApply, NULL);
+
+        bool sidesSwap = rotationSwapsSides(rotation);
+        A2Methods_UArray2 spare = sidesSwap ? newImage(config, height, width) :
+                                              newImage(config, width, height);
+        struct operationOptions options = { NULL, NULL, pool, false, false,
+                                            stdout, &spare, NULL,
+                                            config->traversal, pixelsWide,
+                                            0, false, false };
+
+        /* the counters are summed over the timed trials */
+        CPUTime_T timer = NULL;
+        result->counterMask = 0;
+        double sums[CPUTime_counterCount] = { 0 };
+        if (bo->counters) {
+                timer = CPUTime_New();
+                result->counterMask = CPUTime_EnableCounters(timer);
+        }
+
+        double times[bo->trials];
+        for (int t = -bo->warmup; t < bo->trials; t++) {
+                int newWidth = sidesSwap ? image.height : image.width;
+                int newHeight = sidesSwap ? image.width : image.height;
+                struct timespec start, end;
+                if (timer != NULL)
+                        CPUTime_Start(timer);
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                rotate(methods, &image, map, newWidth, newHeight, rotation,
+                       &options);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                if (timer != NULL && t >= 0) {
+                        double counts[CPUTime_counterCount];
+                        CPUTime_StopCounters(timer, counts);
+                        for (int c = 0; c < CPUTime_counterCount; c++)
+                                sums[c] += counts[c];
+                }
+                if (t >= 0)
+                        times[t] = (end.tv_sec - start.tv_sec) * 1e9 +
+                                   (end.tv_nsec - start.tv_nsec);
+        }
+        if (timer != NULL)
+                CPUTime_Free(&timer);
+        for (int c = 0; c < CPUTime_counterCount; c++)
+                result->perPixel[c] = sums[c] / bo->trials /
+                                      ((double)width * height);
+
+        methods->free(&image.pixels);
+        if (spare != NULL)
+                methods->free(&spare);
+
+        qsort(times, bo->trials, sizeof(double), compareTimes);
+        result->config = *config;
+        result->rotation = rotation;
+        result->width = width;
+        result->height = height;
+        result->threads = bo->threads;
+        result->counters = bo->counters;
+        result->median = times[bo->trials / 2];
+        result->p95 = times[(bo->trials * 95 + 99) / 100 - 1];
+}
+
+/**********fillApply********
+ * About: Gives every pixel of the synthetic image a value that depends on
+ *        its place, so no two neighbours are the same
+ * Inputs: the usual apply arguments; cl is unused
+ * Return: none
+ ************************/
+static void fillApply(int col, int row, A2Methods_UArray2 array, void *elem,
+                      void *cl)
+{
+        (void) array;
+        (void) cl;
+        struct Pnm_rgb *pixel = elem;
+        pixel->red = (col * 7 + row) % 256;
+        pixel->green = (row * 13 + col) % 256;
+        pixel->blue = (col ^ row) % 256;
+}
+
+/**********newImage********
+ * About: Makes an array of Pnm_rgb for a combination: with its block size
+ *        for the blocked suite, a plain array otherwise
+ * Inputs:
+ * struct config *config: the method and block size
+ * int width, int height: dimensions of the array
+ * Return: the array
+ ************************/
+static A2Methods_UArray2 newImage(struct config *config, int width,
+                                  int height)
+{
+        if (config->blocksize > 0)
+                return config->methods->new_with_blocksize(width, height,
+                                        sizeof(struct Pnm_rgb),
+                                        config->blocksize);
+        return config->methods->new(width, height, sizeof(struct Pnm_rgb));
+}
+
+/**********compareTimes********
+ * About: Orders two times, for qsort
+ * Inputs:
+ * const void *a, const void *b: the times
+ * Return: less than, equal to, or greater than 0
+ ************************/
+static int compareTimes(const void *a, const void *b)
+{
+        double x = *(const double *)a;
+        double y = *(const double *)b;
+        return (x > y) - (x < y);
+}
+
+/**********operationLabel********
+ * About: Returns the short name of an operation used in the results
+ * Inputs:
+ * int rotation: the operation
+ * Return: the name
+ ************************/
+static const char *operationLabel(int rotation)
+{
+        switch (rotation) {
+        case rotation0:      return "rotate0";
+        case rotation90:     return "rotate90";
+        case rotation180:    return "rotate180";
+        case rotation270:    return "rotate270";
+        case flipHorizontal: return "flip-horizontal";
+        case flipVertical:   return "flip-vertical";
+        case transpose:      return "transpose";
+        default:             return "anti-transpose";
+        }
+}
+
+/**********copyLabel********
+ * About: Returns the name of how a combination copies the pixels used in
+ *        the results: the map scattering them (per-pixel) or gathering them
+ *        (gather), or the kernels
+ * Inputs:
+ * struct config *config: the combination
+ * Return: the name
+ ************************/
+static const char *copyLabel(struct config *config)
+{
+        if (!config->perPixel)
+                return "kernel";
+        return config->traversal == traversalGather ? "gather" : "per-pixel";
+}
+
+/**********csvHeader********
+ * About: Makes the header line of the CSV results. The counter columns are
+ *        always there (empty without -counters), so every run has the same
+ *        columns and can be the baseline of any other.
+ * Inputs:
+ * char *header: where to put the line, with its newline
+ * size_t size: size of header
+ * Return: none
+ ************************/
+static void csvHeader(char *header, size_t size)
+{
+        int used = snprintf(header, size, "method,copy,operation,width,"
+                            "height,blocksize,threads,counters,median_ns,"
+                            "p95_ns,ns_per_pixel");
+        for (int c = 0; c < CPUTime_counterCount; c++)
+                used += snprintf(header + used, size - used, ",%s_per_pixel",
+                                 counterNames[c]);
+        snprintf(header + used, size - used, ",ipc\n");
+}
+
+/**********writeCsv********
+ * About: Writes the results as CSV, with a header line
+ * Inputs:
+ * FILE *fp: where to write
+ * struct result *results: the results
+ * int count: number of results
+ * Return: none
+ ************************/
+static void writeCsv(FILE *fp, struct result *results, int count)
+{
+        char header[512];
+        csvHeader(header, sizeof(header));
+        fputs(header, fp);
+        for (int i = 0; i < count; i++) {
+                struct result *r = &results[i];
+                fprintf(fp, "%s,%s,%s,%d,%d,%d,%d,%d,%.0f,%.0f,%.4f",
+                        r->config.method,
+                        copyLabel(&r->config),
+                        operationLabel(r->rotation), r->width, r->height,
+                        r->config.blocksize, r->threads, r->counters,
+                        r->median, r->p95,
+                        r->median / ((double)r->width * r->height));
+                writeCounters(fp, r, false);
+                fprintf(fp, "\n");
+        }
+}
+
+/**********writeJson********
+ * About: Writes the results as a JSON array of objects with the same fields
+ *        as the CSV columns
+ * Inputs: same as writeCsv
+ * Return: none
+ ************************/
+static void writeJson(FILE *fp, struct result *results, int count,
+                      bool counters)
+{
+        fprintf(fp, "[\n");
+        for (int i = 0; i < count; i++) {
+                struct result *r = &results[i];
+                fprintf(fp, "  {\"method\": \"%s\", \"copy\": \"%s\", "
+                            "\"operation\": \"%s\", \"width\": %d, "
+                            "\"height\": %d, \"blocksize\": %d, "
+                            "\"threads\": %d, \"counters\": %s, "
+                            "\"median_ns\": %.0f, \"p95_ns\": %.0f, "
+                            "\"ns_per_pixel\": %.4f",
+                        r->config.method,
+                        copyLabel(&r->config),
+                        operationLabel(r->rotation), r->width, r->height,
+                        r->config.blocksize, r->threads,
+                        r->counters ? "true" : "false", r->median, r->p95,
+                        r->median / ((double)r->width * r->height));
+                if (counters)
+                        writeCounters(fp, r, true);
+                fprintf(fp, "}%s\n", i + 1 < count ? "," : "");
+        }
+        fprintf(fp, "]\n");
+}
+
+/**********writeCounters********
+ * About: Writes the counters of a result per pixel and its instructions per
+ *        cycle, as CSV fields or JSON members. Counters the machine does not
+ *        have are empty fields or null.
+ * Inputs:
+ * FILE *fp: where to write
+ * struct result *result: the result
+ * bool json: JSON members instead of CSV fields
+ * Return: none
+ ************************/
+static void writeCounters(FILE *fp, struct result *result, bool json)
+{
+        double *perPixel = result->perPixel;
+        for (int c = 0; c < CPUTime_counterCount; c++) {
+                if (json)
+                        fprintf(fp, ", \"%s_per_pixel\": ", counterNames[c]);
+                writeCounter(fp, (result->counterMask & (1 << c)) != 0,
+                             perPixel[c], json);
+        }
+
+        int both = (1 << CPUTime_cycles) | (1 << CPUTime_instructions);
+        if (json)
+                fprintf(fp, ", \"ipc\": ");
+        writeCounter(fp, (result->counterMask & both) == both,
+                     perPixel[CPUTime_cycles] > 0 ?
+                     perPixel[CPUTime_instructions] /
+                     perPixel[CPUTime_cycles] : 0, json);
+}
+
+/**********writeCounter********
+ * About: Writes one counter value, as a CSV field or the value of a JSON
+ *        member
+ * Inputs:
+ * FILE *fp: where to write
+ * bool known: whether the counter was read; if not, the field is left
+ *             empty, or null in JSON
+ * double value: the value
+ * bool json: JSON instead of CSV
+ * Return: none
+ ************************/
+static void writeCounter(FILE *fp, bool known, double value, bool json)
+{
+        if (!json)
+                putc(',', fp);
+        if (known)
+                fprintf(fp, "%.4f", value);
+        else if (json)
+                fprintf(fp, "null");
+}
+
+/**********checkBaseline********
+ * About: Compares the medians with the ones of a baseline CSV file written
+ *        by an earlier run and prints every combination that got slower by
+ *        more than the threshold. Combinations missing from the baseline are
+ *        not checked, but a baseline with none of them is an error.
+ * Inputs:
+ * char *file: the baseline CSV file
+ * struct result *results: the results
+ * int count: number of results
+ * double threshold: the allowed slow down, in percent
+ * Return: the number of regressions
+ * Expects
+ * - the file to be readable, to have the columns of writeCsv, and to have
+ *   some of the combinations; prints an error and exits otherwise
+ ************************/
+static int checkBaseline(char *file, struct result *results, int count,
+                         double threshold)
+{
+        FILE *fp = fopen(file, "r");
+        if (fp == NULL) {
+                fprintf(stderr, "Baseline %s cannot be opened\n", file);
+                exit(1);
+        }
+
+        /* a baseline of an older harness has other columns */
+        char header[512], expected[512];
+        csvHeader(expected, sizeof(expected));
+        if (fgets(header, sizeof(header), fp) == NULL ||
+            strcmp(header, expected) != 0) {
+                fprintf(stderr, "Baseline %s has other columns; record a "
+                                "new one with make bench-baseline\n", file);
+                exit(1);
+        }
+
+        int regressions = 0;
+        int compared = 0;
+        char line[512];
+        while (fgets(line, sizeof(line), fp) != NULL) {
+                char method[32], copy[32], operation[32];
+                int width, height, blocksize, threads, counters;
+                double median;
+                if (sscanf(line, "%31[^,],%31[^,],%31[^,],%d,%d,%d,%d,%d,%lf",
+                           method, copy, operation, &width, &height,
+                           &blocksize, &threads, &counters, &median) != 9)
+                        continue;
+
+                for (int i = 0; i < count; i++) {
+                        struct result *r = &results[i];
+                        if (strcmp(method, r->config.method) != 0 ||
+                            strcmp(copy, copyLabel(&r->config)) != 0 ||
+                            strcmp(operation,
+                                   operationLabel(r->rotation)) != 0 ||
+                            width != r->width || height != r->height ||
+                            blocksize != r->config.blocksize ||
+                            threads != r->threads ||
+                            counters != r->counters)
+                                continue;
+                        compared++;
+                        if (r->median > median * (1 + threshold / 100)) {
+                                fprintf(stderr, "REGRESSION %s %s %s %dx%d "
+                                        "block %d threads %d: %.0f ns, "
+                                        "baseline %.0f ns (+%.1f%%)\n",
+                                        method, copy, operation, width,
+                                        height, blocksize, threads,
+                                        r->median, median,
+                                        (r->median / median - 1) * 100);
+                                regressions++;
+                        }
+                }
+        }
+
+        fclose(fp);
+        if (compared == 0) {
+                fprintf(stderr, "Baseline %s has none of these combinations "
+                                "(other sizes, threads, or -counters?)\n",
+                        file);
+                exit(1);
+        }
+        fprintf(stderr, "%d regression%s beyond %.1f%% of %s, %d of %d "
+                "combinations compared\n", regressions,
+                regressions == 1 ? "" : "s", threshold, file, compared, count);
+        return regressions;
+}
@@ -0,0 +1,428 @@
+/*
+ *     cacheblock.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the block size choice of cacheblock.h. The
+ *            caches are read once per process, and the edge chosen for every
+ *            element size is remembered, so making many arrays (as -batch
+ *            does, from several threads) reads the caches and the calibration
+ *            file only once.
+ *
+ *            The calibration has the caller's timer do its work on a 1024 x
+ *            1024 image stored in blocks of each edge (ppmtrans rotates it
+ *            by 90 degrees with the tiled kernels, as -block-major does) and
+ *            keeps the edge with the fewest nanoseconds per pixel.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <mem.h>
+
+#include "assert.h"
+#include "cacheblock.h"
+
+#define KB 1024
+#define defaultL1 (32 * KB)
+#define defaultL2 (256 * KB)
+#define defaultLine 64
+#define minBlockSize 1
+#define maxSizes 8             /* element sizes whose edge is remembered */
+#define sysfsCaches "/sys/devices/system/cpu/cpu0/cache"
+
+static pthread_once_t topologyOnce = PTHREAD_ONCE_INIT;
+static struct cacheInfo topology;
+
+/* the edge chosen for every element size so far */
+static pthread_mutex_t chosenLock = PTHREAD_MUTEX_INITIALIZER;
+static int chosenSizes[maxSizes];
+static int chosenEdges[maxSizes];
+static int chosenCount = 0;
+
+static void readTopology(void);
+static long sysfsCache(int level, long *line);
+static bool sysfsRead(int index, const char *name, char *text, int length);
+static long parseSize(const char *text);
+static int topologyBlocksize(int size, struct cacheInfo *info);
+static int lineAlign(int edge, int size, long line);
+static void remember(int size, int edge);
+static char *cacheFile(int size, bool makeDirectory);
+static int readCached(int size, struct cacheInfo *info);
+static void writeCached(int size, int edge, struct cacheInfo *info);
+static int envInt(const char *name, int fallback);
+
+/**********cacheTopology********
+ * About: This function gives the data caches of the machine. They are read
+ *        the first time only.
+ * Inputs:
+ * struct cacheInfo *info: where to store the caches
+ * Return: none
+ * Expects
+ * - info to be nonnull; throws CRE otherwise
+************************/
+void cacheTopology(struct cacheInfo *info)
+{
+        assert(info != NULL);
+        pthread_once(&topologyOnce, readTopology);
+        *info = topology;
+}
+
+/**********cacheBlocksize********
+ * About: This function returns the block edge to use for elements of the
+ *        given size on this machine: UARRAY2B_BLOCKSIZE if it is set, else
+ *        the calibrated edge if this machine was calibrated, else the edge
+ *        that fits two blocks in the target cache
+ * Inputs:
+ * int size: size of an element in bytes
+ * Return: the block edge, at least 1
+ * Expects
+ * - size to be at least 0; throws CRE otherwise
+************************/
+int cacheBlocksize(int size)
+{
+        assert(size >= 0);
+        int forced = envInt("UARRAY2B_BLOCKSIZE", 0);
+        if (forced >= minBlockSize)
+                return forced;
+
+        pthread_mutex_lock(&chosenLock);
+        for (int i = 0; i < chosenCount; i++) {
+                if (chosenSizes[i] == size) {
+                        int edge = chosenEdges[i];
+                        pthread_mutex_unlock(&chosenLock);
+                        return edge;
+                }
+        }
+        pthread_mutex_unlock(&chosenLock);
+
+        struct cacheInfo info;
+        cacheTopology(&info);
+        int edge = readCached(size, &info);
+        if (edge < minBlockSize)
+                edge = topologyBlocksize(size, &info);
+        remember(size, edge);
+        return edge;
+}
+
+/**********cacheCalibrate********
+ * About: This function times the work on an image in blocks for a few edges
+ *        around the one the caches suggest, stores the fastest in the
+ *        calibration file, and uses it from then on
+ * Inputs:
+ * int size: size of an element in bytes
+ * cacheTimer *timeEdge: times the work for an edge
+ * Return: the fastest edge
+ * Expects
+ * - size to be at least 1 and timeEdge to be nonnull; throws CRE otherwise
+ * Note: This takes a fraction of a second; it is meant to be run once per
+ * machine, not for every image
+************************/
+int cacheCalibrate(int size, cacheTimer *timeEdge)
+{
+        assert(size >= 1 && timeEdge != NULL);
+        struct cacheInfo info;
+        cacheTopology(&info);
+        int guess = topologyBlocksize(size, &info);
+        int candidates[] = { guess / 2, guess * 3 / 4, guess, guess * 3 / 2,
+                             guess * 2 };
+        int count = sizeof(candidates) / sizeof(candidates[0]);
+
+        int best = guess;
+        double bestTime = -1;
+        for (int i = 0; i < count; i++) {
+                int edge = candidates[i];
+                if (edge < minBlockSize || edge > cacheCalibrationSide ||
+                    (i > 0 && edge == candidates[i - 1]))
+                        continue;
+                double time = timeEdge(edge, size);
+                if (bestTime < 0 || time < bestTime) {
+                        bestTime = time;
+                        best = edge;
+                }
+        }
+
+        writeCached(size, best, &info);
+        remember(size, best);
+        return best;
+}
+
+/**********readTopology********
+ * About: This function reads the L1 and L2 data caches and the line size,
+ *        from sysconf first and then from sysfs, with common sizes for what
+ *        neither knows. It is run once, by cacheTopology.
+ * Inputs: none
+ * Return: none
+************************/
+static void readTopology(void)
+{
+        long l1 = 0, l2 = 0, line = 0;
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+        l1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+        l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+#endif
+        long sysfsLine = 0;
+        if (l1 <= 0)
+                l1 = sysfsCache(1, &sysfsLine);
+        if (l2 <= 0)
+                l2 = sysfsCache(2, &sysfsLine);
+        if (line <= 0)
+                line = sysfsLine;
+
+        topology.l1 = l1 > 0 ? l1 : defaultL1;
+        topology.l2 = l2 > 0 ? l2 : defaultL2;
+        topology.line = line > 0 ? line : defaultLine;
+}
+
+/**********sysfsCache********
+ * About: This function finds the data (or unified) cache of a level in
+ *        sysfs
+ * Inputs:
+ * int level: the cache level
+ * long *line: where to store the line size of the cache, if sysfs has it
+ * Return: the size of the cache in bytes, or 0 if sysfs does not have it
+************************/
+static long sysfsCache(int level, long *line)
+{
+        char text[32];
+        for (int index = 0; sysfsRead(index, "level", text, sizeof(text));
+             index++) {
+                if (atoi(text) != level ||
+                    !sysfsRead(index, "type", text, sizeof(text)) ||
+                    strncmp(text, "Instruction", 11) == 0)
+                        continue;
+                if (sysfsRead(index, "coherency_line_size", text,
+                              sizeof(text)))
+                        *line = atol(text);
+                if (sysfsRead(index, "size", text, sizeof(text)))
+                        return parseSize(text);
+                return 0;
+        }
+        return 0;
+}
+
+/**********sysfsRead********
+ * About: This function reads one file of a cache in sysfs
+ * Inputs:
+ * int index: the cache, as numbered by sysfs
+ * const char *name: the file
+ * char *text: where to store the first line of the file
+ * int length: room in text
+ * Return: true if the file was read
+************************/
+static bool sysfsRead(int index, const char *name, char *text, int length)
+{
+        char path[128];
+        snprintf(path, sizeof(path), sysfsCaches "/index%d/%s", index, name);
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL)
+                return false;
+        bool read = fgets(text, length, fp) != NULL;
+        fclose(fp);
+        return read;
+}
+
+/**********parseSize********
+ * About: This function reads a sysfs cache size such as "48K" or "2M"
+ * Inputs:
+ * const char *text: the size
+ * Return: the size in bytes
+************************/
+static long parseSize(const char *text)
+{
+        char *end;
+        long bytes = strtol(text, &end, 10);
+        if (*end == 'K')
+                bytes *= KB;
+        else if (*end == 'M')
+                bytes *= KB * KB;
+        return bytes;
+}
+
+/**********topologyBlocksize********
+ * About: This function returns the largest edge that lets a source block
+ *        and a destination block fit in the target cache together, aligned
+ *        to the cache line if that is cheap
+ * Inputs:
+ * int size: size of an element in bytes
+ * struct cacheInfo *info: the caches
+ * Return: the block edge, at least 1
+************************/
+static int topologyBlocksize(int size, struct cacheInfo *info)
+{
+        long cache = envInt("UARRAY2B_CACHE_LEVEL", 2) == 1 ? info->l1 :
+                                                              info->l2;
+        if (size < 1)
+                size = 1;
+        if (2L * size > cache)
+                return minBlockSize;
+
+        int edge = sqrt(cache / (2.0 * size));
+        if (envInt("UARRAY2B_LINE_ALIGN", 1) != 0)
+                edge = lineAlign(edge, size, info->line);
+        return edge < minBlockSize ? minBlockSize : edge;
+}
+
+/**********lineAlign********
+ * About: This function rounds an edge down so that a row of a block is a
+ *        whole number of cache lines, so every block row starts on a line
+ *        of its own, unless that would lose more than a quarter of the edge
+ * Inputs:
+ * int edge: the edge
+ * int size: size of an element in bytes
+ * long line: the line size in bytes
+ * Return: the aligned edge, or edge
+************************/
+static int lineAlign(int edge, int size, long line)
+{
+        /* the smallest edge whose row is whole lines is line / gcd */
+        long a = size, b = line;
+        while (b != 0) {
+                long rest = a % b;
+                a = b;
+                b = rest;
+        }
+        long step = line / a;
+        long aligned = edge / step * step;
+        if (aligned > 0 && aligned * 4 >= (long)edge * 3)
+                return aligned;
+        return edge;
+}
+
+/**********remember********
+ * About: This function stores the edge chosen for an element size, so it is
+ *        not chosen again
+ * Inputs:
+ * int size: size of an element in bytes
+ * int edge: the edge
+ * Return: none
+************************/
+static void remember(int size, int edge)
+{
+        pthread_mutex_lock(&chosenLock);
+        int i = 0;
+        while (i < chosenCount && chosenSizes[i] != size)
+                i++;
+        if (i < maxSizes) {
+                chosenSizes[i] = size;
+                chosenEdges[i] = edge;
+                if (i == chosenCount)
+                        chosenCount++;
+        }
+        pthread_mutex_unlock(&chosenLock);
+}
+
+/**********cacheFile********
+ * About: This function returns the name of the calibration file of an
+ *        element size
+ * Inputs:
+ * int size: size of an element in bytes
+ * bool makeDirectory: whether to make the cache directory if it is missing
+ * Return: the name, or NULL if there is no cache directory; the user should
+ *         FREE it
+************************/
+static char *cacheFile(int size, bool makeDirectory)
+{
+        const char *base = getenv("XDG_CACHE_HOME");
+        const char *sub = "";
+        if (base == NULL || *base == '\0') {
+                base = getenv("HOME");
+                sub = "/.cache";
+        }
+        if (base == NULL || *base == '\0')
+                return NULL;
+
+        int length = strlen(base) + strlen(sub) + 48;
+        char *name = ALLOC(length);
+        snprintf(name, length, "%s%s", base, sub);
+        if (makeDirectory)
+                mkdir(name, 0755);     /* may exist already */
+        snprintf(name, length, "%s%s/uarray2b-blocksize-%d", base, sub, size);
+        return name;
+}
+
+/**********readCached********
+ * About: This function reads the calibrated edge of an element size. The
+ *        file holds the caches it was measured with, and is ignored if they
+ *        are not the caches of this machine.
+ * Inputs:
+ * int size: size of an element in bytes
+ * struct cacheInfo *info: the caches of this machine
+ * Return: the edge, or 0 if there is none for this machine
+************************/
+static int readCached(int size, struct cacheInfo *info)
+{
+        char *name = cacheFile(size, false);
+        if (name == NULL)
+                return 0;
+        FILE *fp = fopen(name, "r");
+        FREE(name);
+        if (fp == NULL)
+                return 0;
+
+        long l1, l2, line;
+        int edge;
+        bool same = fscanf(fp, "%ld %ld %ld %d", &l1, &l2, &line, &edge) == 4 &&
+                    l1 == info->l1 && l2 == info->l2 && line == info->line;
+        fclose(fp);
+        return same ? edge : 0;
+}
+
+/**********writeCached********
+ * About: This function stores the calibrated edge of an element size, with
+ *        the caches it was measured with. It writes a temporary file and
+ *        renames it, so a reader never sees half a file.
+ * Inputs:
+ * int size: size of an element in bytes
+ * int edge: the edge
+ * struct cacheInfo *info: the caches of this machine
+ * Return: none
+ * Note: If the file cannot be written, the edge is only used by this
+ * process; a warning is printed
+************************/
+static void writeCached(int size, int edge, struct cacheInfo *info)
+{
+        char *name = cacheFile(size, true);
+        if (name == NULL)
+                return;
+        int length = strlen(name) + 24;
+        char *temporary = ALLOC(length);
+        snprintf(temporary, length, "%s.%ld", name, (long)getpid());
+
+        FILE *fp = fopen(temporary, "w");
+        bool written = fp != NULL;
+        if (fp != NULL) {
+                fprintf(fp, "%ld %ld %ld %d\n", info->l1, info->l2,
+                        info->line, edge);
+                written = fclose(fp) == 0 && rename(temporary, name) == 0;
+        }
+        if (!written) {
+                fprintf(stderr, "Calibration cannot be saved to %s\n", name);
+                remove(temporary);
+        }
+        FREE(temporary);
+        FREE(name);
+}
+
+/**********envInt********
+ * About: This function reads a number from the environment
+ * Inputs:
+ * const char *name: the environment variable
+ * int fallback: the number to use if it is not set
+ * Return: the number
+************************/
+static int envInt(const char *name, int fallback)
+{
+        const char *value = getenv(name);
+        if (value == NULL || *value == '\0')
+                return fallback;
+        return atoi(value);
+}
@@ -0,0 +1,51 @@
+/*
+ *     cacheblock.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file picks the block size of a UArray2b from the caches of
+ *            the machine it runs on, instead of one constant for every
+ *            machine. The L1 and L2 data cache sizes and the cache line size
+ *            are read with sysconf, or from sysfs where sysconf does not
+ *            know them, and the block edge is the largest one that lets a
+ *            source block and a destination block fit in the target cache
+ *            together, rounded down so a row of a block is a whole number of
+ *            cache lines when that is cheap.
+ *
+ *            The environment can change the choice:
+ *              UARRAY2B_CACHE_LEVEL  1 or 2, the cache to fit (default 2)
+ *              UARRAY2B_LINE_ALIGN   0 to keep the edge off the line size
+ *              UARRAY2B_BLOCKSIZE    a block edge to use as is
+ *
+ *            cacheCalibrate times a few edges around the chosen one on this
+ *            machine with a timer given by the caller (kernelTimeBlocks of
+ *            kernels.h rotates a blocked image with the tiled kernels) and
+ *            stores the fastest in a file under $XDG_CACHE_HOME (or
+ *            ~/.cache), which cacheBlocksize then uses as long as the caches
+ *            it was measured with are the same.
+ */
+
+#ifndef CACHEBLOCK_INCLUDED
+#define CACHEBLOCK_INCLUDED
+
+/**********struct cacheInfo********
+ * About: This struct holds the data caches of the machine, in bytes
+************************/
+struct cacheInfo {
+        long l1;
+        long l2;
+        long line;
+};
+
+/* width and height of the image a calibration timer works on */
+#define cacheCalibrationSide 1024
+
+/* times the work on an image in blocks of edge x edge elements of size
+ * bytes; returns nanoseconds per pixel */
+typedef double cacheTimer(int edge, int size);
+
+extern void cacheTopology(struct cacheInfo *info);
+extern int cacheBlocksize(int size);
+extern int cacheCalibrate(int size, cacheTimer *timeEdge);
+
+#endif
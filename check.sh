@@ -0,0 +1,191 @@
+#!/bin/sh
+#
+#     check.sh
+#     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+#     HW3: locality
+#
+#     About: This file is the regression test run by "make check". It makes
+#            a few images with odd sides (so no tile, block, or micro-tile
+#            divides them) and one with a maxval over 255, and rotates each
+#            of them with every operation the way the assignment first did:
+#            the row-major map copying pixel by pixel. That is the baseline.
+#            Every other way of doing the operation has to print the same
+#            bytes: every method suite with the tiled kernels, -per-pixel,
+#            -gather, -in-place, -stream, -pipeline, -mem-limit, -threads, the
+#            pixel formats, and -io uring; the image read from the standard
+#            input, with and without -in-place, as P6 and as a P3 copy of the
+#            same pixels (which Pnm_ppmread decodes, so the decoded path and
+#            its in-place kernels are run too); a container written with
+#            -tiled and read back, and a container of each pixel format used
+#            as the input; and -batch.
+#            A chain of two operations also has to print what running them
+#            one after the other does. Every mismatch is printed, and the
+#            script fails if there is one.
+#
+#     Usage: ./check.sh [ppmtrans]
+
+PPMTRANS=${1:-./ppmtrans}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/ppmtrans-check.XXXXXX") || exit 1
+trap 'rm -rf "$WORK"' EXIT
+
+checks=0
+failures=0
+
+# the eight operations; anti-transpose has no option of its own
+OPERATIONS="rotate0:-rotate 0
+rotate90:-rotate 90
+rotate180:-rotate 180
+rotate270:-rotate 270
+flip-horizontal:-flip horizontal
+flip-vertical:-flip vertical
+transpose:-transpose
+anti-transpose:-transpose -rotate 180"
+
+SUITES="-row-major -col-major -block-major -morton-major"
+
+# the pixel formats of the containers used as inputs
+PIXELS="rgb8 rgbx8 pnm"
+
+MODES="-per-pixel
+-per-pixel -gather
+-in-place
+-stream
+-pipeline
+-mem-limit 16K
+-threads 3
+-pixels rgbx8
+-pixels pnm
+-io uring"
+
+# makeImage name width height maxval: a P6 image with a fixed pattern, so a
+# failure can be seen again, and a P3 copy of it named name.p3; no sample is
+# 0 or above the maxval
+makeImage()
+{
+        LC_ALL=C awk -v w="$2" -v h="$3" -v maxval="$4" \
+                     -v plain="$WORK/$1.p3" 'BEGIN {
+                printf "P6\n%d %d\n%d\n", w, h, maxval
+                printf "P3\n%d %d\n%d\n", w, h, maxval > plain
+                samples = w * h * 3
+                for (i = 0; i < samples; i++) {
+                        high = (i * 7) % 255 + 1
+                        low = (i * 131 + 7) % 255 + 1
+                        if (maxval > 255) {
+                                printf "%c", high
+                                printf "%d\n", high * 256 + low > plain
+                        } else {
+                                printf "%d\n", low > plain
+                        }
+                        printf "%c", low
+                }
+        }' > "$WORK/$1"
+}
+
+# expect description file baseline: counts a check, and prints it if the
+# file is empty (the program failed) or not the baseline
+expect()
+{
+        checks=$((checks + 1))
+        if [ ! -s "$2" ] || ! cmp -s "$2" "$3"; then
+                failures=$((failures + 1))
+                echo "FAIL: $1"
+        fi
+}
+
+makeImage odd.ppm 7 3 255
+makeImage one.ppm 1 1 255
+makeImage tiles.ppm 131 77 255
+makeImage deep.ppm 67 45 65535
+IMAGES="odd.ppm one.ppm tiles.ppm deep.ppm"
+
+mkdir "$WORK/batch"
+for image in $IMAGES; do
+        cp "$WORK/$image" "$WORK/batch/$image"
+done
+
+echo "$OPERATIONS" > "$WORK/operations"
+echo "$MODES" > "$WORK/modes"
+
+# the baseline of every operation and image
+while IFS=: read -r name operation; do
+        for image in $IMAGES; do
+                "$PPMTRANS" -row-major -per-pixel $operation "$WORK/$image" \
+                        > "$WORK/$name-$image"
+        done
+done < "$WORK/operations"
+
+while IFS=: read -r name operation; do
+        for image in $IMAGES; do
+                input="$WORK/$image"
+                baseline="$WORK/$name-$image"
+                output="$WORK/output.ppm"
+                for pixels in $PIXELS; do
+                        "$PPMTRANS" -rotate 0 -tiled -pixels $pixels \
+                                "$input" > "$WORK/$pixels.ptl"
+                done
+                for suite in $SUITES; do
+                        "$PPMTRANS" $suite $operation "$input" > "$output"
+                        expect "$suite $operation $image" "$output" \
+                               "$baseline"
+                        while read -r mode; do
+                                "$PPMTRANS" $suite $mode $operation \
+                                        "$input" > "$output"
+                                expect "$suite $mode $operation $image" \
+                                       "$output" "$baseline"
+                        done < "$WORK/modes"
+                        for mode in "" -in-place; do
+                                "$PPMTRANS" $suite $mode $operation \
+                                        < "$input" > "$output"
+                                expect "$suite $mode $operation < $image" \
+                                       "$output" "$baseline"
+                                "$PPMTRANS" $suite $mode $operation \
+                                        < "$input.p3" > "$output"
+                                expect "$suite $mode $operation < P3 $image" \
+                                       "$output" "$baseline"
+                        done
+
+                        "$PPMTRANS" $suite $operation -tiled "$input" \
+                                > "$WORK/result.ptl"
+                        "$PPMTRANS" -rotate 0 "$WORK/result.ptl" > "$output"
+                        expect "$suite $operation -tiled $image" "$output" \
+                               "$baseline"
+                        for pixels in $PIXELS; do
+                                "$PPMTRANS" $suite $operation \
+                                        "$WORK/$pixels.ptl" > "$output"
+                                expect "$suite $operation $image as $pixels" \
+                                       "$output" "$baseline"
+                        done
+                done
+        done
+
+        rm -rf "$WORK/out"
+        mkdir "$WORK/out"
+        "$PPMTRANS" $operation -threads 2 -batch "$WORK/batch" \
+                -out-dir "$WORK/out"
+        for image in $IMAGES; do
+                expect "-batch $operation $image" "$WORK/out/$image" \
+                       "$WORK/$name-$image"
+        done
+done < "$WORK/operations"
+
+# every chain of two operations against the two run one after the other
+while IFS=: read -r first firstOperation; do
+        while IFS=: read -r second secondOperation; do
+                for image in odd.ppm deep.ppm; do
+                        "$PPMTRANS" -row-major -per-pixel $firstOperation \
+                                "$WORK/$image" |
+                        "$PPMTRANS" -row-major -per-pixel $secondOperation \
+                                > "$WORK/baseline.ppm"
+                        "$PPMTRANS" $firstOperation $secondOperation \
+                                "$WORK/$image" > "$WORK/output.ppm"
+                        expect "$firstOperation then $secondOperation $image" \
+                               "$WORK/output.ppm" "$WORK/baseline.ppm"
+                done
+        done < "$WORK/operations"
+done < "$WORK/operations"
+
+if [ "$failures" -gt 0 ]; then
+        echo "$failures of $checks checks failed"
+        exit 1
+fi
+echo "All $checks checks passed"
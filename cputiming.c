@@ -26,10 +26,25 @@
  *       Note that printf format %.0f is typically a reasonable way to
  *       print such integers.
  *
+ *       CPUTime_StopWall works like CPUTime_Stop, but returns the
+ *       wall-clock (CLOCK_MONOTONIC) nanoseconds since CPUTime_Start,
+ *       and CPUTime_StopThread the CPU nanoseconds of the calling
+ *       thread (CLOCK_THREAD_CPUTIME_ID).
+ *
+ *       The hardware counters are opened with perf_event_open as one
+ *       group, so they count over the same instructions, and only in
+ *       user space, which is what an unprivileged process is allowed
+ *       to see. They count from the moment they are opened; Start
+ *       reads them and Stop subtracts, like the clocks.
+ *
  *****************************************************************/
 
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 #include "assert.h"
 #include "cputiming_impl.h"
 
@@ -43,6 +58,24 @@ static int timespec_subtract (struct timespec *result, struct timespec *x,
 
 static double timespec_to_double(struct timespec *x);
 
+static int read_counters(CPUTime_T startTimep, uint64_t *values);
+
+/* the type and config of every counter, in CPUTime_ order */
+#define CACHE_READ_MISS(cache) ((cache) |                              \
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |                    \
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+        uint32_t type;
+        uint64_t config;
+} counters[CPUTime_counterCount] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+        { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+        { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) },
+};
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
  *              Functions implementing the CPUTime interface
  * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -52,6 +85,10 @@ CPUTime_T CPUTime_New()
 {
         CPUTime_T startTimep = malloc(sizeof(*startTimep));
         assert (startTimep != NULL);
+        startTimep->leader = -1;
+        startTimep->opened = 0;
+        for (int i = 0; i < CPUTime_counterCount; i++)
+                startTimep->fds[i] = -1;
         return startTimep;
 }
 
@@ -59,6 +96,9 @@ void CPUTime_Free(CPUTime_T *startTimepp)
 {
         assert(startTimepp != NULL);
         assert(*startTimepp != NULL);
+        for (int i = 0; i < CPUTime_counterCount; i++)
+                if ((*startTimepp)->fds[i] >= 0)
+                        close((*startTimepp)->fds[i]);
         free(*startTimepp);
         *startTimepp = NULL;
         return;
@@ -66,7 +106,18 @@ void CPUTime_Free(CPUTime_T *startTimepp)
 
 void CPUTime_Start(CPUTime_T startTimep)
 {
+        clock_gettime(CLOCK_MONOTONIC, &(startTimep->wall));
         clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &(startTimep->time));
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &(startTimep->thread));
+        if (startTimep->leader >= 0) {
+                uint64_t values[3 + CPUTime_counterCount];
+                if (read_counters(startTimep, values)) {
+                        startTimep->enabled = values[1];
+                        startTimep->running = values[2];
+                        memcpy(startTimep->count, values + 3,
+                               startTimep->opened * sizeof(uint64_t));
+                }
+        }
         return;
 }
 
@@ -78,6 +129,81 @@ double CPUTime_Stop(CPUTime_T startTimep)
         return timespec_to_double(&time_used);
 }
 
+double CPUTime_StopWall(CPUTime_T startTimep)
+{
+        struct timespec stop, start, time_used;
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        start = startTimep->wall;   /* timespec_subtract changes its y */
+        assert(timespec_subtract(&time_used, &stop, &start) == 0);
+        return timespec_to_double(&time_used);
+}
+
+double CPUTime_StopThread(CPUTime_T startTimep)
+{
+        struct timespec stop, start, time_used;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &stop);
+        start = startTimep->thread;
+        assert(timespec_subtract(&time_used, &stop, &start) == 0);
+        return timespec_to_double(&time_used);
+}
+
+int CPUTime_EnableCounters(CPUTime_T startTimep)
+{
+        assert(startTimep != NULL);
+
+        /* open the group the first time only */
+        int first = startTimep->leader < 0;
+        for (int i = 0; first && i < CPUTime_counterCount; i++) {
+                struct perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = counters[i].type;
+                attr.config = counters[i].config;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP |
+                                   PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                   PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+                /* this thread, any CPU; the first one opened leads */
+                int fd = syscall(SYS_perf_event_open, &attr, 0, -1,
+                                 startTimep->leader, 0);
+                if (fd < 0)
+                        continue;       /* not on this machine */
+                if (startTimep->leader < 0)
+                        startTimep->leader = fd;
+                startTimep->fds[i] = fd;
+                startTimep->slots[startTimep->opened++] = i;
+        }
+
+        int mask = 0;
+        for (int i = 0; i < CPUTime_counterCount; i++)
+                if (startTimep->fds[i] >= 0)
+                        mask |= 1 << i;
+        return mask;
+}
+
+void CPUTime_StopCounters(CPUTime_T startTimep, double *counts)
+{
+        assert(startTimep != NULL && counts != NULL);
+        uint64_t values[3 + CPUTime_counterCount];
+        for (int i = 0; i < CPUTime_counterCount; i++)
+                counts[i] = 0;
+        if (startTimep->leader < 0 || !read_counters(startTimep, values))
+                return;
+
+        /* the kernel shares the hardware between groups when it has to;
+         * scale up to the whole time the group was enabled */
+        double enabled = values[1] - startTimep->enabled;
+        double running = values[2] - startTimep->running;
+        if (running == 0)
+                return;
+        for (int s = 0; s < startTimep->opened; s++)
+                counts[startTimep->slots[s]] = 
+                        (double)(values[3 + s] - startTimep->count[s]) *
+                        enabled / running;
+}
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
  *     Utility functions called internally
  * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -140,3 +266,18 @@ timespec_to_double(struct timespec *ts)
                 + ts->tv_nsec;
 
 }
+
+/*
+ *                 read_counters
+ *
+ *     Reads the counter group: the number of counters, the time
+ *     enabled, the time running, then one value per counter in the
+ *     order they were opened. Returns 1 if the read worked.
+ */
+
+static int
+read_counters(CPUTime_T startTimep, uint64_t *values)
+{
+        size_t size = (3 + startTimep->opened) * sizeof(uint64_t);
+        return read(startTimep->leader, values, size) == (ssize_t)size;
+}
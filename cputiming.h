@@ -28,6 +28,33 @@
  *       Note that printf format %.0f is typically a reasonable way to
  *       print such integers.
  *
+ *       CPU time is summed over all threads of the process. To
+ *       see how long multithreaded work took on the clock, call
+ *       CPUTime_StopWall, which returns the wall-clock nanoseconds
+ *       since the same CPUTime_Start:
+ *
+ *       double cputime = CPUTime_Stop(timer);
+ *       double walltime = CPUTime_StopWall(timer);
+ *
+ *       CPUTime_StopThread returns the CPU time of the calling
+ *       thread alone, which must be the thread that started the
+ *       timer.
+ *
+ *       A timer can also read the hardware counters of the calling
+ *       thread (cycles, instructions, L1D, LLC and dTLB read misses)
+ *       through perf_event_open. CPUTime_EnableCounters opens them
+ *       once and returns a bit per counter that could be opened
+ *       (0 where the kernel or machine offers none); from then on
+ *       every CPUTime_Start also reads them, and
+ *
+ *       double counts[CPUTime_counterCount];
+ *       CPUTime_StopCounters(timer, counts);
+ *
+ *       stores the events since then, scaled up if the kernel had to
+ *       share the hardware with other counters. Counters that could
+ *       not be opened read as 0. Only the thread that enabled the
+ *       counters is counted, not the other threads of the process.
+ *
  *****************************************************************/
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
@@ -36,6 +63,14 @@
 
 typedef struct CPU_Time *CPUTime_T;
 
+/* the hardware counters, in the order of CPUTime_StopCounters */
+#define CPUTime_cycles 0
+#define CPUTime_instructions 1
+#define CPUTime_l1dMisses 2
+#define CPUTime_llcMisses 3
+#define CPUTime_dtlbMisses 4
+#define CPUTime_counterCount 5
+
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 
  *              Functions implementing the CPUTime interface
  * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
@@ -50,4 +85,12 @@ void CPUTime_Start(CPUTime_T StartTimep) ;
 
 double CPUTime_Stop(CPUTime_T startTimep) ;
 
+double CPUTime_StopWall(CPUTime_T startTimep) ;
+
+double CPUTime_StopThread(CPUTime_T startTimep) ;
+
+int CPUTime_EnableCounters(CPUTime_T startTimep) ;
+
+void CPUTime_StopCounters(CPUTime_T startTimep, double *counts) ;
+
 #endif
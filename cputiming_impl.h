@@ -0,0 +1,41 @@
+#ifndef CPUTIMING_IMPL_INCLUDED
+#define CPUTIMING_IMPL_INCLUDED
+/****************************************************************
+ *
+ *                         cputiming_impl.h
+ *
+ *                   Author: Noah Mendelsohn
+ *
+ *       Private representation of type CPUTime_T. Only
+ *       cputiming.c should include this file.
+ *
+ *       time holds the process CPU clock, thread the CPU clock of
+ *       the calling thread, and wall the monotonic wall clock, all
+ *       read by CPUTime_Start.
+ *
+ *       The hardware counters are one perf_event group: leader is
+ *       the descriptor read, fds the descriptor of every counter
+ *       (-1 if it could not be opened), and slots the counter at
+ *       every place of the group's read. count, enabled and running
+ *       hold the values read by CPUTime_Start.
+ *
+ *****************************************************************/
+
+#include <time.h>
+#include <stdint.h>
+#include "cputiming.h"
+
+struct CPU_Time {
+        struct timespec time;
+        struct timespec thread;
+        struct timespec wall;
+        int leader;
+        int fds[CPUTime_counterCount];
+        int slots[CPUTime_counterCount];
+        int opened;
+        uint64_t count[CPUTime_counterCount];
+        uint64_t enabled;
+        uint64_t running;
+};
+
+#endif
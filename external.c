@@ -0,0 +1,386 @@
+/*
+ *     external.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the out-of-core mode. The rotated image is
+ *            cut into square tiles of edge pixels on a side, and the
+ *            temporary file holds them like the slab of a UArray2b holds its
+ *            blocks: tile after tile in row-major order of the grid, and the
+ *            pixels of a tile in row-major order, as raw P6 bytes.
+ *
+ *            The first pass reads the input rows in bands. A band is the set
+ *            of input rows that end up in one row of tiles of the result
+ *            (0, 180 degree rotations and the flips) or in one column of
+ *            tiles (90, 270 degree rotations and the transposes). Its pixels
+ *            are scattered into those tiles in memory, already rotated, and
+ *            the tiles are written to their places in the file.
+ *
+ *            The second pass reads the file back one row of tiles at a
+ *            time, which is one contiguous run of the file, and writes the
+ *            rows of the result in order.
+ *
+ *            Both passes hold one band of input rows and one row (or column)
+ *            of tiles, so the edge is the largest power of two that keeps
+ *            those two under the limit. The temporary file is created under
+ *            $TMPDIR (or /tmp) and unlinked at once, so it goes away even if
+ *            the program is killed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <mem.h>
+#include <except.h>
+
+#include "assert.h"
+#include "external.h"
+#include "operations.h"
+#include "kernels.h"
+#include "stream.h"
+#include "pnm.h"
+#include "timing.h"
+
+#define maxTileEdge 1024
+
+/**********struct tiling********
+ * About: This struct holds the layout of an out-of-core rotation: the
+ *        image before it, the tiles of the result, and the temporary file.
+ *        byRows tells whether a band of input rows fills a row of tiles (the
+ *        rows stay rows) or a column of tiles (the rows become columns).
+************************/
+struct tiling {
+        int rotation;
+        unsigned width, height; /* the image before the rotation */
+        unsigned newWidth, newHeight; /* the image after it */
+        int pixelBytes;
+        int shift; /* edge is 1 << shift */
+        int edge;
+        int tilesAcross, tilesDown; /* the grid of tiles of the result */
+        size_t tileBytes;
+        bool byRows;
+        int fd;
+};
+
+static unsigned bandOf(struct tiling *tiling, unsigned row);
+static void splitBand(struct tiling *tiling, const unsigned char *band,
+                      unsigned firstRow, unsigned rows, unsigned char *tiles);
+static void writeTiles(struct tiling *tiling, unsigned band,
+                       const unsigned char *tiles);
+static void writeRows(struct tiling *tiling, unsigned band,
+                      const unsigned char *tiles, FILE *output);
+static int tempFile(void);
+static void fileIO(int fd, unsigned char *bytes, size_t length, off_t at,
+                   bool writing);
+
+/**********externalOperation********
+ * About: This function reads a P6 image from fp and prints the result of the
+ *        given operation to options->output, through a temporary file of
+ *        tiles, holding at most options->memLimit bytes of pixels. If the
+ *        user asked for timing, the input rows count as the read phase, the
+ *        tiles and the temporary file as the transform phase, and the output
+ *        rows as the write phase.
+ * Inputs:
+ * FILE *fp: Pointer to the ppm file provided by the user
+ * int rotation: The rotation type provided by the user
+ * struct operationOptions *options: the memory limit, phases to time (NULL
+ * for none), and output stream
+ * Return: none
+ * Expects
+ * - fp and options to be nonnull and options->memLimit to be above 0;
+ *   throws CRE otherwise
+ * - the image to be a binary (P6) ppm; raises Pnm_Badformat otherwise
+ * - the limit to hold a band of one row; prints an error and exits
+ *   otherwise, as it does if the temporary file cannot be used
+************************/
+void externalOperation(FILE *fp, int rotation, struct operationOptions *options)
+{
+        assert(fp != NULL && options != NULL && options->memLimit > 0);
+        struct phaseTimes *phases = options->phases;
+
+        struct tiling tiling;
+        tiling.rotation = rotation;
+        phaseStart(phases);
+        unsigned maxval;
+        streamReadHeader(fp, &tiling.width, &tiling.height, &maxval);
+        phaseStop(phases, phaseRead, 0);
+
+        bool sidesSwap = rotationSwapsSides(rotation);
+        tiling.newWidth = sidesSwap ? tiling.height : tiling.width;
+        tiling.newHeight = sidesSwap ? tiling.width : tiling.height;
+        phaseSize(phases, tiling.newWidth, tiling.newHeight);
+        tiling.pixelBytes = maxval > 255 ? 6 : 3;
+        tiling.edge = externalTileEdge(tiling.width, tiling.height,
+                                       tiling.pixelBytes, options->memLimit);
+        if (tiling.edge == 0) {
+                fprintf(stderr, "A memory limit of %zu bytes cannot hold a "
+                                "%ux%u image a row at a time\n",
+                        options->memLimit, tiling.width, tiling.height);
+                exit(EXIT_FAILURE);
+        }
+        tiling.shift = 0;
+        while ((1 << tiling.shift) < tiling.edge)
+                tiling.shift++;
+        tiling.tilesAcross = (tiling.newWidth + tiling.edge - 1) >>
+                             tiling.shift;
+        tiling.tilesDown = (tiling.newHeight + tiling.edge - 1) >>
+                           tiling.shift;
+        tiling.tileBytes = (size_t)tiling.edge * tiling.edge *
+                           tiling.pixelBytes;
+        tiling.byRows = !sidesSwap;
+
+        /* one band of input rows, and one row or column of tiles */
+        phaseStart(phases);
+        size_t rowBytes = (size_t)tiling.width * tiling.pixelBytes;
+        int tileCount = tiling.tilesAcross > tiling.tilesDown ?
+                        tiling.tilesAcross : tiling.tilesDown;
+        unsigned char *band = ALLOC(rowBytes * tiling.edge + 1);
+        unsigned char *tiles = CALLOC(tileCount, tiling.tileBytes);
+        tiling.fd = tempFile();
+        phaseStop(phases, phaseAllocate, rowBytes * tiling.edge +
+                                         tileCount * tiling.tileBytes);
+
+        /* first pass: bands of input rows to tiles in the file */
+        unsigned row = 0;
+        while (row < tiling.height) {
+                unsigned bandIndex = bandOf(&tiling, row);
+                unsigned rows = 0;
+                phaseStart(phases);
+                while (row + rows < tiling.height &&
+                       bandOf(&tiling, row + rows) == bandIndex) {
+                        if (fread(band + rows * rowBytes, 1, rowBytes, fp) !=
+                            rowBytes)
+                                RAISE(Pnm_Badformat);
+                        rows++;
+                }
+                phaseStop(phases, phaseRead, rows * rowBytes);
+
+                phaseStart(phases);
+                splitBand(&tiling, band, row, rows, tiles);
+                writeTiles(&tiling, bandIndex, tiles);
+                phaseStop(phases, phaseTransform, rows * rowBytes);
+                row += rows;
+        }
+
+        /* second pass: rows of tiles to rows of the result */
+        phaseStart(phases);
+        fprintf(options->output, "P6\n%u %u\n%u\n", tiling.newWidth,
+                tiling.newHeight, maxval);
+        phaseStop(phases, phaseWrite, 0);
+        for (int tileRow = 0; tileRow < tiling.tilesDown; tileRow++) {
+                size_t bytes = tiling.tilesAcross * tiling.tileBytes;
+                phaseStart(phases);
+                fileIO(tiling.fd, tiles, bytes, (off_t)tileRow * bytes, false);
+                phaseStop(phases, phaseTransform, bytes);
+
+                phaseStart(phases);
+                writeRows(&tiling, tileRow, tiles, options->output);
+                phaseStop(phases, phaseWrite, (size_t)tiling.edge *
+                                              tiling.newWidth *
+                                              tiling.pixelBytes);
+        }
+
+        phaseStart(phases);
+        close(tiling.fd);
+        FREE(band);
+        FREE(tiles);
+        phaseStop(phases, phaseFree, 0);
+}
+
+/**********externalTileEdge********
+ * About: This function finds the tile edge of an out-of-core rotation: the
+ *        largest power of two, up to maxTileEdge, for which a band of that
+ *        many input rows and a row or column of tiles of that edge fit in
+ *        the limit together
+ * Inputs:
+ * unsigned width, unsigned height: dimensions of the image
+ * int pixelBytes: bytes in a pixel (3 or 6)
+ * size_t memLimit: bytes of pixels that may be held in memory
+ * Return: the edge; 0 if not even an edge of 1 fits
+************************/
+int externalTileEdge(unsigned width, unsigned height, int pixelBytes,
+                     size_t memLimit)
+{
+        unsigned longer = width > height ? width : height;
+        for (int edge = maxTileEdge; edge >= 1; edge /= 2) {
+                size_t tileBytes = (size_t)edge * edge * pixelBytes;
+                size_t tiles = (longer + edge - 1) / edge;
+                size_t bandBytes = (size_t)width * edge * pixelBytes;
+                if (bandBytes + tiles * tileBytes <= memLimit)
+                        return edge;
+        }
+        return 0;
+}
+
+/**********bandOf********
+ * About: This function finds the band of an input row: the row of tiles of
+ *        the result it ends up in, or the column of tiles
+ * Inputs:
+ * struct tiling *tiling: the layout
+ * unsigned row: the input row
+ * Return: the index of the row or column of tiles
+************************/
+static unsigned bandOf(struct tiling *tiling, unsigned row)
+{
+        int newCol, newRow;
+        kernelMapPoint(tiling->rotation, tiling->width, tiling->height, 0,
+                       row, &newCol, &newRow);
+        return (tiling->byRows ? newRow : newCol) >> tiling->shift;
+}
+
+/**********splitBand********
+ * About: This function moves every pixel of a band of input rows to its
+ *        rotated place in the tiles of its band. The tiles are numbered
+ *        along the band: by column in a row of tiles, by row in a column.
+ * Inputs:
+ * struct tiling *tiling: the layout
+ * const unsigned char *band: the input rows of the band, one after another
+ * unsigned firstRow: the input row of the first row of the band
+ * unsigned rows: the number of rows in the band
+ * unsigned char *tiles: the tiles of the band
+ * Return: none
+************************/
+static void splitBand(struct tiling *tiling, const unsigned char *band,
+                      unsigned firstRow, unsigned rows, unsigned char *tiles)
+{
+        int px = tiling->pixelBytes;
+        int shift = tiling->shift;
+        int mask = tiling->edge - 1;
+        for (unsigned r = 0; r < rows; r++) {
+                const unsigned char *from = band +
+                                            (size_t)r * tiling->width * px;
+                for (unsigned c = 0; c < tiling->width; c++, from += px) {
+                        int newCol, newRow;
+                        kernelMapPoint(tiling->rotation, tiling->width,
+                                       tiling->height, c, firstRow + r,
+                                       &newCol, &newRow);
+                        int tile = (tiling->byRows ? newCol : newRow) >>
+                                   shift;
+                        size_t cell = ((size_t)(newRow & mask) << shift) +
+                                      (newCol & mask);
+                        memcpy(tiles + tile * tiling->tileBytes + cell * px,
+                               from, px);
+                }
+        }
+}
+
+/**********writeTiles********
+ * About: This function writes the tiles of a band to their places in the
+ *        temporary file. A row of tiles is one run of the file; the tiles
+ *        of a column are one row of tiles apart.
+ * Inputs:
+ * struct tiling *tiling: the layout
+ * unsigned band: the row or column of tiles
+ * const unsigned char *tiles: the tiles, numbered as in splitBand
+ * Return: none
+************************/
+static void writeTiles(struct tiling *tiling, unsigned band,
+                       const unsigned char *tiles)
+{
+        size_t tileRowBytes = tiling->tilesAcross * tiling->tileBytes;
+        if (tiling->byRows) {
+                fileIO(tiling->fd, (unsigned char *)tiles, tileRowBytes,
+                       (off_t)band * tileRowBytes, true);
+                return;
+        }
+        for (int tileRow = 0; tileRow < tiling->tilesDown; tileRow++)
+                fileIO(tiling->fd, (unsigned char *)tiles +
+                       tileRow * tiling->tileBytes, tiling->tileBytes,
+                       (off_t)tileRow * tileRowBytes +
+                       band * tiling->tileBytes, true);
+}
+
+/**********writeRows********
+ * About: This function writes the rows of the result that lie in one row of
+ *        tiles, each row a piece of every tile in turn
+ * Inputs:
+ * struct tiling *tiling: the layout
+ * unsigned band: the row of tiles
+ * const unsigned char *tiles: the row of tiles, read from the file
+ * FILE *output: where the result goes
+ * Return: none
+************************/
+static void writeRows(struct tiling *tiling, unsigned band,
+                      const unsigned char *tiles, FILE *output)
+{
+        unsigned firstRow = band << tiling->shift;
+        unsigned rows = tiling->newHeight - firstRow < (unsigned)tiling->edge ?
+                        tiling->newHeight - firstRow : (unsigned)tiling->edge;
+        size_t pieceBytes = (size_t)tiling->edge * tiling->pixelBytes;
+        for (unsigned r = 0; r < rows; r++) {
+                for (int tile = 0; tile < tiling->tilesAcross; tile++) {
+                        unsigned col = tile << tiling->shift;
+                        unsigned cols = tiling->newWidth - col <
+                                        (unsigned)tiling->edge ?
+                                        tiling->newWidth - col :
+                                        (unsigned)tiling->edge;
+                        fwrite(tiles + tile * tiling->tileBytes +
+                               r * pieceBytes, tiling->pixelBytes, cols,
+                               output);
+                }
+        }
+}
+
+/**********tempFile********
+ * About: This function creates the temporary file and unlinks it, so only
+ *        the descriptor keeps it
+ * Inputs: none
+ * Return: the file descriptor
+ * Expects
+ * - a file to be creatable under $TMPDIR or /tmp; prints an error and
+ *   exits otherwise
+************************/
+static int tempFile(void)
+{
+        const char *dir = getenv("TMPDIR");
+        if (dir == NULL || *dir == '\0')
+                dir = "/tmp";
+        int length = strlen(dir) + 32;
+        char *name = ALLOC(length);
+        snprintf(name, length, "%s/ppmtrans-tiles-XXXXXX", dir);
+        int fd = mkstemp(name);
+        if (fd < 0) {
+                fprintf(stderr, "Temporary file %s cannot be created\n",
+                        name);
+                exit(EXIT_FAILURE);
+        }
+        unlink(name);
+        FREE(name);
+        return fd;
+}
+
+/**********fileIO********
+ * About: This function reads or writes a run of the temporary file in
+ *        full, retrying short transfers
+ * Inputs:
+ * int fd: the temporary file
+ * unsigned char *bytes: the bytes to write, or where to read them
+ * size_t length: the length of the run
+ * off_t at: where the run starts in the file
+ * bool writing: true to write, false to read
+ * Return: none
+ * Expects
+ * - the whole run to be transferred; prints an error and exits otherwise
+************************/
+static void fileIO(int fd, unsigned char *bytes, size_t length, off_t at,
+                   bool writing)
+{
+        while (length > 0) {
+                ssize_t done = writing ? pwrite(fd, bytes, length, at) :
+                                         pread(fd, bytes, length, at);
+                if (done < 0 && errno == EINTR)
+                        continue;
+                if (done <= 0) {
+                        fprintf(stderr, "Temporary file cannot be %s\n",
+                                writing ? "written" : "read");
+                        exit(EXIT_FAILURE);
+                }
+                bytes += done;
+                length -= done;
+                at += done;
+        }
+}
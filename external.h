@@ -0,0 +1,25 @@
+/*
+ *     external.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the out-of-core mode, for images too large to
+ *            keep in memory twice. A binary (P6) image is rotated through a
+ *            temporary file of tiles, holding at most a given number of
+ *            bytes of pixels in memory at any time, and the result is
+ *            written in the order of its rows.
+ */
+
+#ifndef EXTERNAL_INCLUDED
+#define EXTERNAL_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+#include "operations.h"
+
+extern void externalOperation(FILE *fp, int rotation,
+                              struct operationOptions *options);
+extern int externalTileEdge(unsigned width, unsigned height, int pixelBytes,
+                            size_t memLimit);
+
+#endif
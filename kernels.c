@@ -0,0 +1,943 @@
+/*
+ *     kernels.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the tiled rotation kernels. The destination
+ *            array is visited one tile at a time. For every tile the matching
+ *            source rectangle is found with the inverse transform and split
+ *            into pieces that lie inside a single source tile. Inside a tile
+ *            both arrays have a fixed distance between rows, so each piece is
+ *            copied with two pointers and two byte steps, without calling
+ *            methods->at for every pixel.
+ *
+ *            180 degree rotation and the flips move every pixel to the place
+ *            of its mirror image, so they can also run in place: the same
+ *            tiles are visited, but only the source pixels of one half of
+ *            the image are kept, and each of them is swapped with its image.
+ *
+ *            90, 270 degree rotations and the transposes of a plain array can
+ *            run in place too, by following the cycles of the permutation that
+ *            takes the row major order of the source to the one of the
+ *            destination. A bitmap (one bit per pixel) remembers which places
+ *            already hold their final pixel.
+ *
+ *            The source can also be the pixel bytes of a memory-mapped P6
+ *            file (see mapped.c). It is then a plain row-major run of 3 or 6
+ *            byte pixels. The destination can keep them as they are (RGB8 or
+ *            RGB16), pad 3 byte pixels to 4 (RGBX8), or widen every pixel to
+ *            a Pnm_rgb while it is copied.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "assert.h"
+#include "kernels.h"
+#include "microtile.h"
+#include "threadpool.h"
+#include "numa.h"
+#include "operations.h"
+#include "a2methods.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "a2parallel.h"
+#include "pnm.h"
+#include "uarray2.h"
+#include "cacheblock.h"
+#include <mem.h>
+
+/* edge (in pixels) of a tile of a plain array; a source and a destination
+ * tile of Pnm_rgb pixels (2 * 64 * 64 * 12 bytes) fit together in L2 */
+#define tileEdge 64
+
+/* timed rotations per edge for kernelTimeBlocks, after one warm-up */
+#define calibrationRuns 3
+
+/**********struct view********
+ * About: This struct holds what the kernels need to know about an array:
+ *        its dimensions, the element size, the edge of the square regions
+ *        that are stored with a fixed row stride (the block for UArray2b,
+ *        a tileEdge square for UArray2), and that row stride in bytes. For
+ *        the pixels of a mapped file, array is NULL and base is the first
+ *        pixel.
+************************/
+struct view {
+        A2Methods_UArray2 array;
+        const char *base;
+        int width;
+        int height;
+        int size;
+        int tile;
+        long rowStride;
+};
+
+/**********struct rect********
+ * About: This struct holds the columns [col, colEnd) and rows [row, rowEnd)
+ *        of a rectangle of pixels
+************************/
+struct rect {
+        int col;
+        int row;
+        int colEnd;
+        int rowEnd;
+};
+
+/**********struct tileJob********
+ * About: This struct holds a whole kernelRotate (or kernelRotateInPlace)
+ *        call so that the workers of a thread pool can share its destination
+ *        tiles. Only source pixels inside one of the regions are moved; when
+ *        swap is set they are swapped with their images instead of copied.
+ *        next is the index of the next tile nobody has taken yet; it is only
+ *        changed with atomic adds, and every tile writes its own part of the
+ *        destination, so the workers need no locks. In the first-touch NUMA
+ *        mode, workers is the size of the pool and every worker takes its
+ *        own band of tiles instead (see tileWorker); it is 0 otherwise.
+************************/
+struct tileJob {
+        A2Methods_T methods;
+        struct view *src;
+        struct view *dst;
+        int rotationType;
+        bool swap;
+        int regions;
+        struct rect region[2];
+        int tilesAcross;
+        int tileCount;
+        int next;
+        int workers;
+};
+
+static bool isPlain(A2Methods_T methods);
+static void tileWorker(int worker, void *jobStruct);
+static void runTiles(struct tileJob *job, ThreadPool_T pool);
+static long sourceIndex(int inverse, int width, int height, long index);
+static void copyTile(struct tileJob *job, int dCol, int dRow);
+static void viewOf(A2Methods_T methods, A2Methods_UArray2 array,
+                   struct view *view);
+static int inverseOf(int rotationType);
+static void mapPoint(int rotationType, int width, int height, int col,
+                     int row, int *newCol, int *newRow);
+static void copyPiece(struct tileJob *job, int col, int row, int cols,
+                      int rows);
+static void swapPixels(char *from, long fromRowStride, char *to,
+                       long colStep, long rowStep, int cols, int rows,
+                       int size);
+static void copyPixels(const char *from, long fromRowStride, char *to,
+                       long colStep, long rowStep, int cols, int rows,
+                       int pixelBytes, int size);
+static int copyMicroTiles(const struct microTile *kernel, const char *from,
+                          long fromRowStride, char *to, long colStep,
+                          long rowStep, int cols, int rows);
+static void copyRest(const char *from, long fromRowStride, char *to,
+                     long colStep, long rowStep, int cols, int rows,
+                     int pixelBytes, int size);
+static void copyScalar(const char *from, long fromRowStride, char *to,
+                       long colStep, long rowStep, int cols, int rows,
+                       int size);
+static void widenPixels(const char *from, long fromRowStride, char *to,
+                        long colStep, long rowStep, int cols, int rows,
+                        int pixelBytes, int size);
+
+/**********kernelSupports********
+ * About: This function tells whether the kernels know the memory layout of
+ *        the arrays created by the given method suite
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * Return: true if the suite is the plain or the blocked suite (sequential or
+ *         parallel); false otherwise
+************************/
+bool kernelSupports(A2Methods_T methods)
+{
+        return isPlain(methods) || methods == uarray2_methods_blocked ||
+               methods == uarray2_methods_blocked_parallel;
+}
+
+/**********kernelRotate********
+ * About: This function copies every pixel of source to its place in rotated
+ *        for the given rotation type, one destination tile at a time. With a
+ *        thread pool, the workers take tiles from a shared counter until none
+ *        are left.
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * A2Methods_UArray2 source: the array holding the pixels of the source image
+ * A2Methods_UArray2 rotated: the array to hold the rotated image; its width
+ * and height must already be the ones of the rotated image
+ * int rotationType: value keeping track of the type of rotation to be
+ * implemented
+ * ThreadPool_T pool: the workers to share the tiles; NULL to copy all the
+ * tiles on the calling thread
+ * Return: none
+ * Expects
+ * - methods, source, and rotated to be nonnull and methods to be supported
+ *   by kernelSupports; throws CRE otherwise
+************************/
+void kernelRotate(A2Methods_T methods, A2Methods_UArray2 source,
+                  A2Methods_UArray2 rotated, int rotationType,
+                  ThreadPool_T pool)
+{
+        assert(methods != NULL && source != NULL && rotated != NULL);
+        assert(kernelSupports(methods));
+
+        struct view src, dst;
+        viewOf(methods, source, &src);
+        viewOf(methods, rotated, &dst);
+        assert(src.size == dst.size);
+
+        struct tileJob job = { methods, &src, &dst, rotationType, false, 1,
+                               { { 0, 0, src.width, src.height } },
+                               0, 0, 0, 0 };
+        runTiles(&job, pool);
+}
+
+/**********kernelRotateMapped********
+ * About: This function does the same as kernelRotate, but the source is the
+ *        pixels of a mapped P6 file, read where they are. Each pixel is
+ *        turned into the element format of rotated as it is written there,
+ *        so the file is never decoded into an array of its own.
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * const struct mappedImage *image: the mapped file
+ * A2Methods_UArray2 rotated: the array to hold the rotated image; its width
+ * and height must already be the ones of the rotated image, and its elements
+ * are either Pnm_rgb, the file's own pixels, or pixelRgbx8 for 3 byte ones
+ * int rotationType: value keeping track of the type of rotation
+ * ThreadPool_T pool: the workers to share the tiles; NULL to copy all the
+ * tiles on the calling thread
+ * Return: none
+ * Expects
+ * - methods, image, and rotated to be nonnull, methods to be supported by
+ *   kernelSupports, and rotated to hold one of those formats; throws CRE
+ *   otherwise
+************************/
+void kernelRotateMapped(A2Methods_T methods, const struct mappedImage *image,
+                        A2Methods_UArray2 rotated, int rotationType,
+                        ThreadPool_T pool)
+{
+        assert(methods != NULL && image != NULL && rotated != NULL);
+        assert(kernelSupports(methods));
+
+        struct view src, dst;
+        viewOf(methods, rotated, &dst);
+        assert(dst.size == sizeof(struct Pnm_rgb) ||
+               dst.size == image->pixelBytes ||
+               (dst.size == pixelRgbx8 && image->pixelBytes == pixelRgb8));
+        src.array = NULL;
+        src.base = (const char *)image->pixels;
+        src.width = image->width;
+        src.height = image->height;
+        src.size = image->pixelBytes;
+        src.tile = tileEdge;
+        src.rowStride = (long)src.width * src.size;
+
+        struct tileJob job = { methods, &src, &dst, rotationType, false, 1,
+                               { { 0, 0, src.width, src.height } },
+                               0, 0, 0, 0 };
+        runTiles(&job, pool);
+}
+
+/**********kernelInPlace********
+ * About: This function tells whether kernelRotateInPlace can do the given
+ *        rotation type
+ * Inputs:
+ * int rotationType: value keeping track of the type of rotation
+ * Return: true for 180 degree rotation and the flips; false otherwise
+************************/
+bool kernelInPlace(int rotationType)
+{
+        return rotationType == rotation180 || rotationType == flipHorizontal ||
+               rotationType == flipVertical;
+}
+
+/**********kernelRotateInPlace********
+ * About: This function does the given rotation inside the array, without a
+ *        second array. Each pixel of one half of the image (the left half
+ *        for horizontal flip, the top half otherwise, plus the left half of
+ *        the middle row for 180 degrees when the height is odd) is swapped
+ *        with its image.
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * A2Methods_UArray2 array: the array holding the image to rotate
+ * int rotationType: value keeping track of the type of rotation
+ * ThreadPool_T pool: the workers to share the tiles; NULL to swap on the
+ * calling thread
+ * Return: none
+ * Expects
+ * - methods and array to be nonnull, methods to be supported by
+ *   kernelSupports, and the rotation type to be allowed by kernelInPlace;
+ *   throws CRE otherwise
+************************/
+void kernelRotateInPlace(A2Methods_T methods, A2Methods_UArray2 array,
+                         int rotationType, ThreadPool_T pool)
+{
+        assert(methods != NULL && array != NULL);
+        assert(kernelSupports(methods) && kernelInPlace(rotationType));
+
+        struct view view;
+        viewOf(methods, array, &view);
+        int width = view.width;
+        int height = view.height;
+
+        struct tileJob job = { methods, &view, &view, rotationType, true, 1,
+                               { { 0, 0, width, height / 2 } },
+                               0, 0, 0, 0 };
+        if (rotationType == flipHorizontal) {
+                job.region[0].colEnd = width / 2;
+                job.region[0].rowEnd = height;
+        } else if (rotationType == rotation180 && height % 2 == 1) {
+                struct rect middle = { 0, height / 2, width / 2,
+                                       height / 2 + 1 };
+                job.region[1] = middle;
+                job.regions = 2;
+        }
+
+        runTiles(&job, pool);
+}
+
+/**********kernelCycles********
+ * About: This function tells whether kernelRotateByCycles can do the given
+ *        rotation type on arrays of the given suite
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * int rotationType: value keeping track of the type of rotation
+ * Return: true for 90, 270 degree rotations and the transposes of plain
+ *         arrays; false otherwise
+************************/
+bool kernelCycles(A2Methods_T methods, int rotationType)
+{
+        return isPlain(methods) && rotationSwapsSides(rotationType);
+}
+
+/**********kernelRotateByCycles********
+ * About: This function rotates a plain array inside its own buffer and gives
+ *        it the dimensions of the rotated image. For every place not yet
+ *        done, it follows the cycle of places that pull their pixel from the
+ *        next one, keeping the first pixel of the cycle aside until the cycle
+ *        comes back to it. Every pixel is moved once; the only extra memory
+ *        is the bitmap, 1/96 of the image for Pnm_rgb pixels. The cycles jump
+ *        across the whole buffer, so this is slower than kernelRotate and
+ *        runs on one thread; it is meant for images that do not fit twice in
+ *        memory.
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * A2Methods_UArray2 array: the array holding the image to rotate
+ * int rotationType: value keeping track of the type of rotation
+ * Return: none
+ * Expects
+ * - methods and array to be nonnull and the rotation type to be allowed by
+ *   kernelCycles; throws CRE otherwise
+************************/
+void kernelRotateByCycles(A2Methods_T methods, A2Methods_UArray2 array,
+                          int rotationType)
+{
+        assert(methods != NULL && array != NULL);
+        assert(kernelCycles(methods, rotationType));
+
+        int width = methods->width(array);
+        int height = methods->height(array);
+        int size = methods->size(array);
+        long count = (long)width * height;
+        if (count == 0) {
+                UArray2_reshape(array, height, width);
+                return;
+        }
+
+        char *pixels = methods->at(array, 0, 0);
+        unsigned char *done = CALLOC(count / 8 + 1, 1);
+        assert(done != NULL);
+        char saved[size > 0 ? size : 1];
+        int inverse = inverseOf(rotationType);
+
+        for (long start = 0; start < count; start++) {
+                if (done[start / 8] & (1 << start % 8))
+                        continue;
+
+                /* walk the cycle through start, pulling every pixel into
+                 * place from the source of that place */
+                memcpy(saved, pixels + start * size, size);
+                long place = start;
+                for (;;) {
+                        done[place / 8] |= 1 << place % 8;
+                        long from = sourceIndex(inverse, height, width, place);
+                        if (from == start) {
+                                memcpy(pixels + place * size, saved, size);
+                                break;
+                        }
+                        memcpy(pixels + place * size, pixels + from * size,
+                               size);
+                        place = from;
+                }
+        }
+
+        FREE(done);
+        UArray2_reshape(array, height, width);
+}
+
+/**********sourceIndex********
+ * About: This function finds, for a place in the row major order of the
+ *        rotated image, the place in the row major order of the source image
+ *        whose pixel goes there
+ * Inputs:
+ * int inverse: the rotation type that undoes the rotation being done
+ * int width, int height: dimensions of the rotated image
+ * long index: the place in the rotated image
+ * Return: the place in the source image
+************************/
+static long sourceIndex(int inverse, int width, int height, long index)
+{
+        int col, row;
+        mapPoint(inverse, width, height, index % width, index / width,
+                 &col, &row);
+
+        /* the source image is height pixels wide */
+        return (long)row * height + col;
+}
+
+/**********runTiles********
+ * About: This function sets up the tile counter of a job and runs its tiles,
+ *        on the workers of the pool or on the calling thread
+ * Inputs:
+ * struct tileJob *job: the job; the fields before the tile counter are set
+ * ThreadPool_T pool: the workers to share the tiles; may be NULL
+ * Return: none
+************************/
+static void runTiles(struct tileJob *job, ThreadPool_T pool)
+{
+        int tilesAcross = (job->dst->width + job->dst->tile - 1) /
+                          job->dst->tile;
+        int tilesDown = (job->dst->height + job->dst->tile - 1) /
+                        job->dst->tile;
+        job->tilesAcross = tilesAcross;
+        job->tileCount = tilesAcross * tilesDown;
+        job->next = 0;
+        job->workers = pool != NULL && numaMode() == numaFirstTouch ?
+                       ThreadPool_size(pool) : 0;
+
+        if (pool == NULL)
+                tileWorker(0, job);
+        else
+                ThreadPool_run(pool, tileWorker, job);
+}
+
+/**********tileWorker********
+ * About: This function takes destination tiles of a tileJob, in row-major
+ *        order, until every tile has been taken. When the job has a number
+ *        of workers, the tiles are cut into that many bands of neighbouring
+ *        tiles instead, and a worker copies the band of its index: the same
+ *        worker then writes the same part of the destination in every job,
+ *        so the pages it touches first are on its node.
+ * Inputs:
+ * int worker: index of the calling worker
+ * void *jobStruct: the tileJob to work on
+ * Return: none
+************************/
+static void tileWorker(int worker, void *jobStruct)
+{
+        struct tileJob *job = jobStruct;
+
+        if (job->workers > 0) {
+                int first = (long)job->tileCount * worker / job->workers;
+                int end = (long)job->tileCount * (worker + 1) / job->workers;
+                for (int tile = first; tile < end; tile++)
+                        copyTile(job, tile % job->tilesAcross * job->dst->tile,
+                                 tile / job->tilesAcross * job->dst->tile);
+                return;
+        }
+
+        for (;;) {
+                int tile = __atomic_fetch_add(&job->next, 1,
+                                              __ATOMIC_RELAXED);
+                if (tile >= job->tileCount)
+                        break;
+                copyTile(job, tile % job->tilesAcross * job->dst->tile,
+                         tile / job->tilesAcross * job->dst->tile);
+        }
+}
+
+/**********copyTile********
+ * About: This function fills one destination tile. The matching source
+ *        rectangle is found from the source positions of two opposite
+ *        corners of the tile, cut down to the regions of the job, and split
+ *        along the source tiles.
+ * Inputs:
+ * struct tileJob *job: the job the tile belongs to
+ * int dCol, int dRow: top left corner of the tile in the destination
+ * Return: none
+************************/
+static void copyTile(struct tileJob *job, int dCol, int dRow)
+{
+        struct view *src = job->src;
+        struct view *dst = job->dst;
+        int inverse = inverseOf(job->rotationType);
+        int dColEnd = dCol + dst->tile < dst->width ?
+                      dCol + dst->tile : dst->width;
+        int dRowEnd = dRow + dst->tile < dst->height ?
+                      dRow + dst->tile : dst->height;
+
+        int c0, r0, c1, r1;
+        mapPoint(inverse, dst->width, dst->height, dCol, dRow, &c0, &r0);
+        mapPoint(inverse, dst->width, dst->height, dColEnd - 1, dRowEnd - 1,
+                 &c1, &r1);
+
+        for (int i = 0; i < job->regions; i++) {
+                struct rect *region = &job->region[i];
+                int sCol = c0 < c1 ? c0 : c1;
+                int sColEnd = (c0 < c1 ? c1 : c0) + 1;
+                int sRow = r0 < r1 ? r0 : r1;
+                int sRowEnd = (r0 < r1 ? r1 : r0) + 1;
+                if (sCol < region->col)
+                        sCol = region->col;
+                if (sColEnd > region->colEnd)
+                        sColEnd = region->colEnd;
+                if (sRow < region->row)
+                        sRow = region->row;
+                if (sRowEnd > region->rowEnd)
+                        sRowEnd = region->rowEnd;
+
+                int row = sRow;
+                while (row < sRowEnd) {
+                        int rowEnd = (row / src->tile + 1) * src->tile;
+                        if (rowEnd > sRowEnd)
+                                rowEnd = sRowEnd;
+                        int col = sCol;
+                        while (col < sColEnd) {
+                                int colEnd = (col / src->tile + 1) *
+                                             src->tile;
+                                if (colEnd > sColEnd)
+                                        colEnd = sColEnd;
+                                copyPiece(job, col, row, colEnd - col,
+                                          rowEnd - row);
+                                col = colEnd;
+                        }
+                        row = rowEnd;
+                }
+        }
+}
+
+/**********isPlain********
+ * About: This function tells whether arrays of the given suite are UArray2s
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * Return: true for the sequential and parallel plain suites; false otherwise
+************************/
+static bool isPlain(A2Methods_T methods)
+{
+        return methods == uarray2_methods_plain ||
+               methods == uarray2_methods_plain_parallel;
+}
+
+/**********viewOf********
+ * About: This function fills a view struct for the given array
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * A2Methods_UArray2 array: the array to describe
+ * struct view *view: the struct to fill
+ * Return: none
+************************/
+static void viewOf(A2Methods_T methods, A2Methods_UArray2 array,
+                   struct view *view)
+{
+        view->array = array;
+        view->base = NULL;
+        view->width = methods->width(array);
+        view->height = methods->height(array);
+        view->size = methods->size(array);
+
+        /* a plain array is one row-major run, so any square can be a tile;
+         * a blocked array keeps its rows contiguous only inside a block */
+        if (isPlain(methods)) {
+                view->tile = tileEdge;
+                view->rowStride = (long)view->width * view->size;
+        } else {
+                view->tile = methods->blocksize(array);
+                view->rowStride = (long)view->tile * view->size;
+        }
+}
+
+/**********inverseOf********
+ * About: This function returns the rotation type that undoes the given one
+ * Inputs:
+ * int rotationType: value keeping track of the type of rotation
+ * Return: 270 for 90, 90 for 270, the same type for all the others
+************************/
+static int inverseOf(int rotationType)
+{
+        if (rotationType == rotation90)
+                return rotation270;
+        else if (rotationType == rotation270)
+                return rotation90;
+        return rotationType;
+}
+
+/**********kernelMapPoint********
+ * About: This function computes where a pixel of a width x height image ends
+ *        up after the given rotation, for code that moves pixels its own
+ *        way (see external.c) or checks where they go (see
+ *        rotation_test.c)
+ * Inputs: same as mapPoint
+ * Return: none
+************************/
+void kernelMapPoint(int rotationType, int width, int height, int col, int row,
+                    int *newCol, int *newRow)
+{
+        mapPoint(rotationType, width, height, col, row, newCol, newRow);
+}
+
+/**********kernelTimeBlocks********
+ * About: This function times a 90 degree rotation of the calibration image
+ *        between two blocked arrays of the given block edge, with the same
+ *        kernels (and micro-tile kernels) as -block-major, on one thread. It
+ *        is the timer of cacheCalibrate (see cacheblock.h).
+ * Inputs:
+ * int edge: the block edge
+ * int size: size of an element in bytes
+ * Return: the fastest of a few rotations, after one warm-up, in nanoseconds
+ *         per pixel of the image
+************************/
+double kernelTimeBlocks(int edge, int size)
+{
+        A2Methods_T methods = uarray2_methods_blocked;
+        int side = cacheCalibrationSide;
+        A2Methods_UArray2 source = methods->new_with_blocksize(side, side,
+                                                               size, edge);
+        A2Methods_UArray2 rotated = methods->new_with_blocksize(side, side,
+                                                                size, edge);
+
+        double best = -1;
+        for (int run = -1; run < calibrationRuns; run++) {
+                struct timespec start, end;
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                kernelRotate(methods, source, rotated, rotation90, NULL);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                double time = (end.tv_sec - start.tv_sec) * 1e9 +
+                              (end.tv_nsec - start.tv_nsec);
+                if (run >= 0 && (best < 0 || time < best))
+                        best = time;
+        }
+
+        methods->free(&source);
+        methods->free(&rotated);
+        return best / ((double)side * side);
+}
+
+/**********mapPoint********
+ * About: This function computes where a pixel of a width x height image ends
+ *        up after the given rotation. It is plain arithmetic, so it also
+ *        works for positions just outside the image.
+ * Inputs:
+ * int rotationType: value keeping track of the type of rotation
+ * int width, int height: dimensions of the image before the rotation
+ * int col, int row: position of the pixel before the rotation
+ * int *newCol, int *newRow: where to store the position after the rotation
+ * Return: none
+************************/
+static void mapPoint(int rotationType, int width, int height, int col,
+                     int row, int *newCol, int *newRow)
+{
+        if (rotationType == rotation90) {
+                *newCol = height - row - 1;
+                *newRow = col;
+        } else if (rotationType == rotation180) {
+                *newCol = width - col - 1;
+                *newRow = height - row - 1;
+        } else if (rotationType == rotation270) {
+                *newCol = row;
+                *newRow = width - col - 1;
+        } else if (rotationType == flipHorizontal) {
+                *newCol = width - col - 1;
+                *newRow = row;
+        } else if (rotationType == flipVertical) {
+                *newCol = col;
+                *newRow = height - row - 1;
+        } else if (rotationType == transpose) {
+                *newCol = row;
+                *newRow = col;
+        } else if (rotationType == antiTranspose) {
+                *newCol = height - row - 1;
+                *newRow = width - col - 1;
+        } else {
+                *newCol = col;
+                *newRow = row;
+        }
+}
+
+/**********copyPiece********
+ * About: This function copies (or swaps) a rectangle of the source that lies
+ *        inside a single source tile and whose image lies inside a single
+ *        destination tile. The byte steps in the destination for one source
+ *        column and one source row are found by mapping the neighbours of the
+ *        corner.
+ * Inputs:
+ * struct tileJob *job: the job the rectangle belongs to
+ * int col, int row: top left corner of the rectangle in the source
+ * int cols, int rows: dimensions of the rectangle
+ * Return: none
+************************/
+static void copyPiece(struct tileJob *job, int col, int row, int cols,
+                      int rows)
+{
+        struct view *src = job->src;
+        struct view *dst = job->dst;
+        int dCol, dRow, colNextCol, colNextRow, rowNextCol, rowNextRow;
+        mapPoint(job->rotationType, src->width, src->height, col, row,
+                 &dCol, &dRow);
+        mapPoint(job->rotationType, src->width, src->height, col + 1, row,
+                 &colNextCol, &colNextRow);
+        mapPoint(job->rotationType, src->width, src->height, col, row + 1,
+                 &rowNextCol, &rowNextRow);
+
+        long colStep = (colNextCol - dCol) * (long)dst->size +
+                       (colNextRow - dRow) * dst->rowStride;
+        long rowStep = (rowNextCol - dCol) * (long)dst->size +
+                       (rowNextRow - dRow) * dst->rowStride;
+
+        char *from = src->base != NULL ?
+                     (char *)src->base + row * src->rowStride +
+                     col * (long)src->size :
+                     job->methods->at(src->array, col, row);
+        char *to = job->methods->at(dst->array, dCol, dRow);
+        if (job->swap)
+                swapPixels(from, src->rowStride, to, colStep, rowStep, cols,
+                           rows, src->size);
+        else
+                copyPixels(from, src->rowStride, to, colStep, rowStep, cols,
+                           rows, src->size, dst->size);
+}
+
+/**********copyPixels********
+ * About: This function is the inner loop of the kernels. It copies a source
+ *        rectangle to the destination, moving the destination pointer by the
+ *        given byte steps, and widens the pixels on the way if the
+ *        destination ones are larger. When one source row becomes one
+ *        destination column (90, 270 degree rotations and the transposes),
+ *        whole groups of rows are copied with the micro-tile kernels first,
+ *        if there is one for the two pixel sizes.
+ * Inputs:
+ * const char *from: first pixel of the source rectangle
+ * long fromRowStride: bytes between two rows of the source rectangle
+ * char *to: the destination of the first pixel
+ * long colStep: destination bytes to move for one source column
+ * long rowStep: destination bytes to move for one source row
+ * int cols, int rows: dimensions of the rectangle
+ * int pixelBytes: size of a source pixel in bytes
+ * int size: size of a destination pixel in bytes
+ * Return: none
+************************/
+static void copyPixels(const char *from, long fromRowStride, char *to,
+                       long colStep, long rowStep, int cols, int rows,
+                       int pixelBytes, int size)
+{
+        int done = 0;
+        if (rowStep == size || rowStep == -size) {
+                const struct microTile *kernel = microTileSelect(pixelBytes,
+                                                                 size);
+                if (kernel != NULL)
+                        done = copyMicroTiles(kernel, from, fromRowStride, to,
+                                              colStep, rowStep, cols, rows);
+        }
+
+        copyRest(from + done * fromRowStride, fromRowStride,
+                 to + done * rowStep, colStep, rowStep, cols, rows - done,
+                 pixelBytes, size);
+}
+
+/**********copyRest********
+ * About: This function copies a rectangle one pixel at a time, with
+ *        copyScalar, or with widenPixels if the destination pixels are
+ *        larger
+ * Inputs: same as copyPixels
+ * Return: none
+************************/
+static void copyRest(const char *from, long fromRowStride, char *to,
+                     long colStep, long rowStep, int cols, int rows,
+                     int pixelBytes, int size)
+{
+        if (pixelBytes == size)
+                copyScalar(from, fromRowStride, to, colStep, rowStep, cols,
+                           rows, size);
+        else
+                widenPixels(from, fromRowStride, to, colStep, rowStep, cols,
+                            rows, pixelBytes, size);
+}
+
+/**********copyMicroTiles********
+ * About: This function copies the rectangle in groups of microTileRows rows.
+ *        The micro-tile kernel writes the pixels of a group in increasing
+ *        address order, so when rowStep goes backwards the rows are handed
+ *        to it in reverse and every output starts at the last row. Columns
+ *        left over at the right of a group are copied by copyRest.
+ * Inputs:
+ * const struct microTile *kernel: the kernel for the two pixel sizes
+ * the others: same as copyPixels, with rowStep of plus or minus one
+ * destination pixel
+ * Return: the number of rows copied, a multiple of microTileRows
+************************/
+static int copyMicroTiles(const struct microTile *kernel, const char *from,
+                          long fromRowStride, char *to, long colStep,
+                          long rowStep, int cols, int rows)
+{
+        const char *tileRows[microTileRows];
+        char *outs[8];
+        assert(kernel->cols <= 8);
+
+        int row = 0;
+        for (; row + microTileRows <= rows; row += microTileRows) {
+                const char *src = from + row * fromRowStride;
+                char *dst = to + row * rowStep;
+                if (rowStep < 0)
+                        dst += (microTileRows - 1) * rowStep;
+                for (int i = 0; i < microTileRows; i++) {
+                        int r = rowStep < 0 ? microTileRows - 1 - i : i;
+                        tileRows[i] = src + r * fromRowStride;
+                }
+
+                int col = 0;
+                for (; col + kernel->cols <= cols; col += kernel->cols) {
+                        for (int i = 0; i < kernel->cols; i++)
+                                outs[i] = dst + (col + i) * colStep;
+                        kernel->copy(tileRows, outs);
+                        for (int i = 0; i < microTileRows; i++)
+                                tileRows[i] += kernel->cols *
+                                               kernel->fromSize;
+                }
+
+                copyRest(src + col * (long)kernel->fromSize, fromRowStride,
+                         to + row * rowStep + col * colStep, colStep,
+                         rowStep, cols - col, microTileRows,
+                         kernel->fromSize, kernel->toSize);
+        }
+        return row;
+}
+
+/**********copyScalar********
+ * About: This function copies the rectangle one pixel at a time. Pnm_rgb
+ *        pixels are copied as structs, and the compact formats with a
+ *        memcpy of a constant size, so the compiler can use plain loads and
+ *        stores for them.
+ * Inputs: same as copyPixels
+ * Return: none
+************************/
+static void copyScalar(const char *from, long fromRowStride, char *to,
+                       long colStep, long rowStep, int cols, int rows,
+                       int size)
+{
+        for (int row = 0; row < rows; row++) {
+                const char *src = from + row * fromRowStride;
+                char *dst = to + row * rowStep;
+                if (size == sizeof(struct Pnm_rgb)) {
+                        for (int col = 0; col < cols; col++) {
+                                *(struct Pnm_rgb *)dst =
+                                        *(const struct Pnm_rgb *)src;
+                                src += size;
+                                dst += colStep;
+                        }
+                } else if (size == pixelRgb8) {
+                        for (int col = 0; col < cols; col++) {
+                                memcpy(dst, src, pixelRgb8);
+                                src += size;
+                                dst += colStep;
+                        }
+                } else if (size == pixelRgbx8) {
+                        for (int col = 0; col < cols; col++) {
+                                memcpy(dst, src, pixelRgbx8);
+                                src += size;
+                                dst += colStep;
+                        }
+                } else if (size == pixelRgb16) {
+                        for (int col = 0; col < cols; col++) {
+                                memcpy(dst, src, pixelRgb16);
+                                src += size;
+                                dst += colStep;
+                        }
+                } else {
+                        for (int col = 0; col < cols; col++) {
+                                memcpy(dst, src, size);
+                                src += size;
+                                dst += colStep;
+                        }
+                }
+        }
+}
+
+/**********widenPixels********
+ * About: This function copies a rectangle of P6 pixels (3 bytes, or 6 bytes
+ *        of big-endian 16 bit samples) to Pnm_rgb pixels, or 3 byte pixels
+ *        to RGBX8 ones with a zero padding byte (as scalarPad in microtile.c
+ *        does), walking the pointers like copyScalar
+ * Inputs: same as copyPixels, with the size of a source pixel in pixelBytes
+ * and the size of a destination pixel in size
+ * Return: none
+************************/
+static void widenPixels(const char *from, long fromRowStride, char *to,
+                        long colStep, long rowStep, int cols, int rows,
+                        int pixelBytes, int size)
+{
+        for (int row = 0; row < rows; row++) {
+                const unsigned char *src = (const unsigned char *)from +
+                                           row * fromRowStride;
+                char *dst = to + row * rowStep;
+                if (size == pixelRgbx8) {
+                        for (int col = 0; col < cols; col++) {
+                                unsigned char pixel[pixelRgbx8] =
+                                        { src[0], src[1], src[2], 0 };
+                                memcpy(dst, pixel, pixelRgbx8);
+                                src += pixelBytes;
+                                dst += colStep;
+                        }
+                        continue;
+                }
+                for (int col = 0; col < cols; col++) {
+                        struct Pnm_rgb *pixel = (struct Pnm_rgb *)dst;
+                        if (pixelBytes == pixelRgb8) {
+                                pixel->red = src[0];
+                                pixel->green = src[1];
+                                pixel->blue = src[2];
+                        } else {
+                                pixel->red = src[0] << 8 | src[1];
+                                pixel->green = src[2] << 8 | src[3];
+                                pixel->blue = src[4] << 8 | src[5];
+                        }
+                        src += pixelBytes;
+                        dst += colStep;
+                }
+        }
+}
+
+/**********swapPixels********
+ * About: This function swaps every pixel of a rectangle with its image, for
+ *        the in-place rotations. It walks the pointers like copyScalar.
+ * Inputs: same as copyPixels, except that the source is changed too
+ * Return: none
+************************/
+static void swapPixels(char *from, long fromRowStride, char *to,
+                       long colStep, long rowStep, int cols, int rows,
+                       int size)
+{
+        char tmp[size > 0 ? size : 1];
+        for (int row = 0; row < rows; row++) {
+                char *src = from + row * fromRowStride;
+                char *dst = to + row * rowStep;
+                if (size == sizeof(struct Pnm_rgb)) {
+                        for (int col = 0; col < cols; col++) {
+                                struct Pnm_rgb pixel = 
+                                        *(struct Pnm_rgb *)src;
+                                *(struct Pnm_rgb *)src = 
+                                        *(struct Pnm_rgb *)dst;
+                                *(struct Pnm_rgb *)dst = pixel;
+                                src += size;
+                                dst += colStep;
+                        }
+                } else {
+                        for (int col = 0; col < cols; col++) {
+                                memcpy(tmp, src, size);
+                                memcpy(src, dst, size);
+                                memcpy(dst, tmp, size);
+                                src += size;
+                                dst += colStep;
+                        }
+                }
+        }
+}
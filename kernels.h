@@ -0,0 +1,47 @@
+/*
+ *     kernels.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the tiled rotation kernels. Instead of calling
+ *            an apply function for every pixel, the kernels copy pixels
+ *            between raw row pointers of the source and destination arrays,
+ *            one cache-sized tile at a time. They work on the plain (UArray2)
+ *            and blocked (UArray2b) method suites. Some rotations can also
+ *            be done inside the source array, without a second one, and
+ *            the source can be the pixels of a memory-mapped P6 file.
+ */
+
+#ifndef KERNELS_INCLUDED
+#define KERNELS_INCLUDED
+
+#include <stdbool.h>
+#include "a2methods.h"
+#include "threadpool.h"
+#include "mapped.h"
+
+/* element sizes of the compact pixel formats the kernels can fill from a
+ * mapped file; an array of Pnm_rgb has sizeof(struct Pnm_rgb) instead */
+#define pixelRgb8 3   /* red, green, blue bytes */
+#define pixelRgbx8 4  /* red, green, blue, and a padding byte */
+#define pixelRgb16 6  /* big-endian 16 bit samples, as in a P6 file */
+
+extern bool kernelSupports(A2Methods_T methods);
+extern void kernelRotate(A2Methods_T methods, A2Methods_UArray2 source,
+                         A2Methods_UArray2 rotated, int rotationType,
+                         ThreadPool_T pool);
+extern void kernelRotateMapped(A2Methods_T methods,
+                               const struct mappedImage *image,
+                               A2Methods_UArray2 rotated, int rotationType,
+                               ThreadPool_T pool);
+extern bool kernelInPlace(int rotationType);
+extern void kernelRotateInPlace(A2Methods_T methods, A2Methods_UArray2 array,
+                                int rotationType, ThreadPool_T pool);
+extern bool kernelCycles(A2Methods_T methods, int rotationType);
+extern void kernelRotateByCycles(A2Methods_T methods, A2Methods_UArray2 array,
+                                 int rotationType);
+extern void kernelMapPoint(int rotationType, int width, int height, int col,
+                           int row, int *newCol, int *newRow);
+extern double kernelTimeBlocks(int edge, int size);
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ *     mapped.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the memory-mapped input path. The file is
+ *            mapped with mmap and the kernel is told with madvise that the
+ *            pages will be needed soon and read mostly in order, so it can
+ *            read ahead. Files already in the page cache are then used
+ *            without any copy. Anything that is not a complete P6 file is
+ *            left to Pnm_ppmread.
+ *
+ *            With the io_uring backend (see uring.h), the file is read into
+ *            memory through the ring instead of being mapped, many chunks at
+ *            a time, so no page of it faults on first use. A stream that
+ *            cannot be mapped, such as the standard input, is read whole
+ *            into memory by mappedRead and used the same way.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mem.h>
+
+#include "assert.h"
+#include "mapped.h"
+#include "uring.h"
+
+static bool readHeader(struct mappedImage *image);
+static bool headerNumber(const unsigned char *bytes, size_t length,
+                         size_t *at, unsigned *number);
+static void release(struct mappedImage *image);
+
+/**********mappedOpen********
+ * About: This function maps the given file and reads its P6 header
+ * Inputs:
+ * const char *path: name of the ppm file
+ * struct mappedImage *image: the struct to fill
+ * Return: true if the file is a complete P6 image and could be mapped; false
+ *         otherwise (nothing is left mapped then)
+ * Expects
+ * - path and image to be nonnull; throws CRE otherwise
+ * Note: The user should call mappedClose after a successful call
+************************/
+bool mappedOpen(const char *path, struct mappedImage *image)
+{
+        assert(path != NULL && image != NULL);
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || 
+            info.st_size < 2) {
+                close(fd);
+                return false;
+        }
+
+        size_t length = info.st_size;
+        void *map = NULL;
+        image->read = false;
+        if (uringEnabled()) {
+                map = ALLOC(length);
+                image->read = uringRead(fd, map, length, 0);
+                if (!image->read)
+                        FREE(map);
+        }
+        if (!image->read) {
+                map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (map == MAP_FAILED) {
+                        close(fd);
+                        return false;
+                }
+                madvise(map, length, MADV_WILLNEED);
+                madvise(map, length, MADV_SEQUENTIAL);
+        }
+        close(fd);
+        image->map = map;
+        image->length = length;
+
+        if (!readHeader(image)) {
+                release(image);
+                return false;
+        }
+        return true;
+}
+
+/**********mappedRead********
+ * About: This function reads a whole stream into memory and reads its P6
+ *        header, for input that cannot be mapped (a pipe, say)
+ * Inputs:
+ * FILE *fp: the stream, read to its end
+ * struct mappedImage *image: the struct to fill
+ * Return: true if the stream holds a complete P6 image; false otherwise, and
+ *         then image->map and image->length still hold the bytes read (map
+ *         is NULL if there were none), so the caller can read them some
+ *         other way
+ * Expects
+ * - fp and image to be nonnull; throws CRE otherwise
+ * Note: The user should call mappedClose when image->map is not NULL
+************************/
+bool mappedRead(FILE *fp, struct mappedImage *image)
+{
+        assert(fp != NULL && image != NULL);
+
+        /* a regular file says how long it is; a pipe grows the buffer */
+        struct stat info;
+        size_t capacity = 1 << 16;
+        if (fstat(fileno(fp), &info) == 0 && S_ISREG(info.st_mode) &&
+            info.st_size > 0)
+                capacity = info.st_size + 1;
+        unsigned char *bytes = ALLOC(capacity);
+        size_t length = 0;
+        size_t count;
+        while ((count = fread(bytes + length, 1, capacity - length, fp)) > 0) {
+                length += count;
+                if (length == capacity) {
+                        capacity *= 2;
+                        RESIZE(bytes, capacity);
+                }
+        }
+
+        image->read = true;
+        image->map = bytes;
+        image->length = length;
+        if (length == 0) {
+                release(image);
+                return false;
+        }
+        return readHeader(image);
+}
+
+/**********mappedClose********
+ * About: This function unmaps (or frees) a file opened by mappedOpen
+ * Inputs:
+ * struct mappedImage *image: the mapped file
+ * Return: none
+ * Expects
+ * - image to be nonnull and mapped; throws CRE otherwise
+************************/
+void mappedClose(struct mappedImage *image)
+{
+        assert(image != NULL && image->map != NULL);
+        release(image);
+        image->pixels = NULL;
+}
+
+/**********release********
+ * About: This function gives back the memory holding a file: the mapping,
+ *        or the buffer it was read into
+ * Inputs:
+ * struct mappedImage *image: the file
+ * Return: none
+************************/
+static void release(struct mappedImage *image)
+{
+        if (image->read)
+                FREE(image->map);
+        else
+                munmap(image->map, image->length);
+        image->map = NULL;
+}
+
+/**********readHeader********
+ * About: This function reads the header of the file in image->map: P6, the
+ *        width, the height, the maxval, and one white space, and checks
+ *        that all of the pixels follow
+ * Inputs:
+ * struct mappedImage *image: the file; its header values and pixels are
+ * filled in
+ * Return: true if the file is a complete P6 image
+************************/
+static bool readHeader(struct mappedImage *image)
+{
+        const unsigned char *bytes = image->map;
+        size_t length = image->length;
+        size_t at = 2;
+        bool ok = length >= 2 && bytes[0] == 'P' && bytes[1] == '6' &&
+                  headerNumber(bytes, length, &at, &image->width) &&
+                  headerNumber(bytes, length, &at, &image->height) &&
+                  headerNumber(bytes, length, &at, &image->maxval) &&
+                  at < length && isspace(bytes[at]) &&
+                  image->maxval > 0 && image->maxval <= 65535;
+        if (ok) {
+                image->pixelBytes = image->maxval > 255 ? 6 : 3;
+                size_t pixelBytes = (size_t)image->width * image->height *
+                                    image->pixelBytes;
+                ok = length - (at + 1) >= pixelBytes;
+        }
+        if (ok)
+                image->pixels = bytes + at + 1;
+        return ok;
+}
+
+/**********headerNumber********
+ * About: This function reads a number of the header, skipping the white
+ *        space and the comments (from '#' to the end of the line) before it
+ * Inputs:
+ * const unsigned char *bytes, size_t length: the mapped file
+ * size_t *at: position to start from; moved past the number
+ * unsigned *number: where to store the number
+ * Return: true if a number was found before the end of the file
+************************/
+static bool headerNumber(const unsigned char *bytes, size_t length,
+                         size_t *at, unsigned *number)
+{
+        size_t i = *at;
+        while (i < length && (isspace(bytes[i]) || bytes[i] == '#')) {
+                if (bytes[i] == '#') {
+                        while (i < length && bytes[i] != '\n')
+                                i++;
+                } else {
+                        i++;
+                }
+        }
+        if (i >= length || !isdigit(bytes[i]))
+                return false;
+
+        *number = 0;
+        while (i < length && isdigit(bytes[i]))
+                *number = *number * 10 + (bytes[i++] - '0');
+        *at = i;
+        return true;
+}
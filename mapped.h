@@ -0,0 +1,42 @@
+/*
+ *     mapped.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the memory-mapped input path. A binary (P6)
+ *            ppm file is mapped read-only into memory and its pixel bytes
+ *            are used in place as the source of a rotation, instead of being
+ *            decoded into a new A2Methods_UArray2 by Pnm_ppmread. A stream
+ *            that cannot be mapped is read whole into memory instead.
+ */
+
+#ifndef MAPPED_INCLUDED
+#define MAPPED_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**********struct mappedImage********
+ * About: This struct holds a mapped P6 file: the mapping, the header values,
+ *        and where the pixels start. A pixel is pixelBytes bytes (3, or 6
+ *        when maxval is over 255) and the rows follow each other. read is
+ *        set when the file was read into a buffer (see uring.h, and
+ *        mappedRead) instead.
+************************/
+struct mappedImage {
+        void *map;
+        size_t length;
+        bool read;
+        unsigned width;
+        unsigned height;
+        unsigned maxval;
+        int pixelBytes;
+        const unsigned char *pixels;
+};
+
+extern bool mappedOpen(const char *path, struct mappedImage *image);
+extern bool mappedRead(FILE *fp, struct mappedImage *image);
+extern void mappedClose(struct mappedImage *image);
+
+#endif
@@ -0,0 +1,443 @@
+/*
+ *     microtile.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the micro-tile kernels. A Pnm_rgb pixel is
+ *            12 bytes, so 4 pixels of a row are exactly three 16 byte SSE2
+ *            registers. The vector kernels cut the 4 pixels of every source
+ *            row out of those registers with byte shifts and masks, and glue
+ *            one pixel of each row together into 3 registers per output row.
+ *            The AVX2 kernel does the same for 8 columns, one 4 x 4 micro-tile
+ *            in each 128 bit lane.
+ *
+ *            An RGBX8 pixel is 4 bytes, so 4 pixels of a row fill one SSE2
+ *            register and the micro-tile is a 4 x 4 transpose of 32 bit
+ *            lanes. The 3 byte pixels of a mapped P6 file are first spread to
+ *            32 bit lanes with byte shifts (their padding byte masked to 0),
+ *            then transposed the same way. Only the 12 bytes of the 4 pixels
+ *            of a row are loaded, so a row at the end of the mapping is
+ *            never read past. All kernels only move bytes, so they give the
+ *            same output as the scalar ones.
+ *
+ *            The environment variable PPMTRANS_SIMD (scalar, sse2 or avx2)
+ *            can force a kernel the CPU supports, to compare them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "assert.h"
+#include "microtile.h"
+#include "kernels.h"
+#include "pnm.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/**********scalarTile********
+ * About: This function copies a 4 x 4 micro-tile one pixel at a time. It is
+ *        the fallback for CPUs without SSE2.
+ * Inputs:
+ * const char *rows[]: the 4 source rows, in destination order
+ * char *outs[]: the 4 destination rows, one for each source column
+ * Return: none
+************************/
+static void scalarTile(const char *rows[], char *outs[])
+{
+        for (int col = 0; col < 4; col++) {
+                struct Pnm_rgb *out = (struct Pnm_rgb *)outs[col];
+                for (int row = 0; row < microTileRows; row++)
+                        out[row] = ((const struct Pnm_rgb *)rows[row])[col];
+        }
+}
+
+/**********scalarRgbx********
+ * About: This function copies a 4 x 4 micro-tile of RGBX8 pixels one pixel
+ *        at a time
+ * Inputs: same as scalarTile
+ * Return: none
+************************/
+static void scalarRgbx(const char *rows[], char *outs[])
+{
+        for (int col = 0; col < 4; col++) {
+                for (int row = 0; row < microTileRows; row++)
+                        memcpy(outs[col] + row * pixelRgbx8,
+                               rows[row] + col * pixelRgbx8, pixelRgbx8);
+        }
+}
+
+/**********scalarPad********
+ * About: This function copies a 4 x 4 micro-tile of 3 byte pixels to RGBX8
+ *        pixels with a zero padding byte, one pixel at a time
+ * Inputs: same as scalarTile
+ * Return: none
+************************/
+static void scalarPad(const char *rows[], char *outs[])
+{
+        for (int col = 0; col < 4; col++) {
+                for (int row = 0; row < microTileRows; row++) {
+                        const char *from = rows[row] + col * pixelRgb8;
+                        char pixel[pixelRgbx8] = { from[0], from[1],
+                                                   from[2], 0 };
+                        memcpy(outs[col] + row * pixelRgbx8, pixel,
+                               pixelRgbx8);
+                }
+        }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/**********sse2Tile********
+ * About: This function copies a 4 x 4 micro-tile with SSE2 registers. The
+ *        pixels of a row are p0 = a[0..11], p1 = a[12..15] b[0..7],
+ *        p2 = b[8..15] c[0..3] and p3 = c[4..15]; every pixel is moved to
+ *        bytes 0..11 of its own register and four of them are packed back
+ *        into 3 registers for the output row.
+ * Inputs:
+ * const char *rows[]: the 4 source rows, in destination order
+ * char *outs[]: the 4 destination rows, one for each source column
+ * Return: none
+************************/
+__attribute__((target("sse2")))
+static void sse2Tile(const char *rows[], char *outs[])
+{
+        const __m128i low12 = _mm_set_epi32(0, -1, -1, -1);
+        __m128i pixel[4][microTileRows];
+
+        for (int row = 0; row < microTileRows; row++) {
+                const __m128i *src = (const __m128i *)rows[row];
+                __m128i a = _mm_loadu_si128(src);
+                __m128i b = _mm_loadu_si128(src + 1);
+                __m128i c = _mm_loadu_si128(src + 2);
+
+                pixel[0][row] = _mm_and_si128(a, low12);
+                pixel[1][row] = _mm_and_si128(_mm_or_si128(
+                                _mm_srli_si128(a, 12), _mm_slli_si128(b, 4)),
+                                low12);
+                pixel[2][row] = _mm_and_si128(_mm_or_si128(
+                                _mm_srli_si128(b, 8), _mm_slli_si128(c, 8)),
+                                low12);
+                pixel[3][row] = _mm_srli_si128(c, 4);
+        }
+
+        for (int col = 0; col < 4; col++) {
+                __m128i *dst = (__m128i *)outs[col];
+                __m128i *p = pixel[col];
+                _mm_storeu_si128(dst, _mm_or_si128(p[0],
+                                 _mm_slli_si128(p[1], 12)));
+                _mm_storeu_si128(dst + 1, _mm_or_si128(
+                                 _mm_srli_si128(p[1], 4),
+                                 _mm_slli_si128(p[2], 8)));
+                _mm_storeu_si128(dst + 2, _mm_or_si128(
+                                 _mm_srli_si128(p[2], 8),
+                                 _mm_slli_si128(p[3], 4)));
+        }
+}
+
+/**********avx2Tile********
+ * About: This function copies a 4 x 8 micro-tile with AVX2 registers. The
+ *        low lane holds source columns 0..3 and the high lane columns 4..7;
+ *        AVX2 byte shifts stay inside a lane, so each lane runs the SSE2
+ *        algorithm on its own.
+ * Inputs:
+ * const char *rows[]: the 4 source rows, in destination order
+ * char *outs[]: the 8 destination rows, one for each source column
+ * Return: none
+************************/
+__attribute__((target("avx2")))
+static void avx2Tile(const char *rows[], char *outs[])
+{
+        const __m256i low12 = _mm256_set_epi32(0, -1, -1, -1,
+                                               0, -1, -1, -1);
+        __m256i pixel[4][microTileRows];
+
+        for (int row = 0; row < microTileRows; row++) {
+                const __m128i *src = (const __m128i *)rows[row];
+                __m256i a = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                            _mm_loadu_si128(src)), _mm_loadu_si128(src + 3),
+                            1);
+                __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                            _mm_loadu_si128(src + 1)),
+                            _mm_loadu_si128(src + 4), 1);
+                __m256i c = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                            _mm_loadu_si128(src + 2)),
+                            _mm_loadu_si128(src + 5), 1);
+
+                pixel[0][row] = _mm256_and_si256(a, low12);
+                pixel[1][row] = _mm256_and_si256(_mm256_or_si256(
+                                _mm256_srli_si256(a, 12),
+                                _mm256_slli_si256(b, 4)), low12);
+                pixel[2][row] = _mm256_and_si256(_mm256_or_si256(
+                                _mm256_srli_si256(b, 8),
+                                _mm256_slli_si256(c, 8)), low12);
+                pixel[3][row] = _mm256_srli_si256(c, 4);
+        }
+
+        for (int col = 0; col < 4; col++) {
+                __m256i *p = pixel[col];
+                __m256i out[3];
+                out[0] = _mm256_or_si256(p[0], _mm256_slli_si256(p[1], 12));
+                out[1] = _mm256_or_si256(_mm256_srli_si256(p[1], 4),
+                                         _mm256_slli_si256(p[2], 8));
+                out[2] = _mm256_or_si256(_mm256_srli_si256(p[2], 8),
+                                         _mm256_slli_si256(p[3], 4));
+
+                __m128i *low = (__m128i *)outs[col];
+                __m128i *high = (__m128i *)outs[col + 4];
+                for (int i = 0; i < 3; i++) {
+                        _mm_storeu_si128(low + i,
+                                         _mm256_castsi256_si128(out[i]));
+                        _mm_storeu_si128(high + i,
+                                         _mm256_extracti128_si256(out[i], 1));
+                }
+        }
+}
+
+/**********sse2Load12********
+ * About: This function loads the 12 bytes of 4 pixels of 3 bytes into bytes
+ *        0..11 of a register, without reading the 4 bytes after them
+ * Inputs:
+ * const char *from: the first pixel
+ * Return: the register; bytes 12..15 are 0
+************************/
+__attribute__((target("sse2")))
+static __m128i sse2Load12(const char *from)
+{
+        int last;
+        memcpy(&last, from + 8, sizeof(last));
+        return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)from),
+                                  _mm_cvtsi32_si128(last));
+}
+
+/**********sse2Spread********
+ * About: This function moves the 4 pixels of 3 bytes in bytes 0..11 of a
+ *        register to its 4 32 bit lanes, with a padding byte of 0 each
+ * Inputs:
+ * __m128i pixels: the packed pixels
+ * Return: the RGBX8 pixels
+************************/
+__attribute__((target("sse2")))
+static __m128i sse2Spread(__m128i pixels)
+{
+        const __m128i low24 = _mm_set1_epi32(0x00ffffff);
+        __m128i first = _mm_unpacklo_epi32(pixels,
+                                           _mm_srli_si128(pixels, 3));
+        __m128i second = _mm_unpacklo_epi32(_mm_srli_si128(pixels, 6),
+                                            _mm_srli_si128(pixels, 9));
+        return _mm_and_si128(_mm_unpacklo_epi64(first, second), low24);
+}
+
+/**********sse2Transpose********
+ * About: This function transposes 4 rows of 4 RGBX8 pixels and stores
+ *        every column of them as a destination row
+ * Inputs:
+ * __m128i rows[]: the 4 source rows, in destination order
+ * char *outs[]: the 4 destination rows, one for each source column
+ * Return: none
+************************/
+__attribute__((target("sse2")))
+static void sse2Transpose(__m128i rows[], char *outs[])
+{
+        __m128i low01 = _mm_unpacklo_epi32(rows[0], rows[1]);
+        __m128i low23 = _mm_unpacklo_epi32(rows[2], rows[3]);
+        __m128i high01 = _mm_unpackhi_epi32(rows[0], rows[1]);
+        __m128i high23 = _mm_unpackhi_epi32(rows[2], rows[3]);
+        _mm_storeu_si128((__m128i *)outs[0], _mm_unpacklo_epi64(low01, low23));
+        _mm_storeu_si128((__m128i *)outs[1], _mm_unpackhi_epi64(low01, low23));
+        _mm_storeu_si128((__m128i *)outs[2],
+                         _mm_unpacklo_epi64(high01, high23));
+        _mm_storeu_si128((__m128i *)outs[3],
+                         _mm_unpackhi_epi64(high01, high23));
+}
+
+/**********sse2Rgbx********
+ * About: This function copies a 4 x 4 micro-tile of RGBX8 pixels with SSE2
+ *        registers, one register per source row
+ * Inputs: same as sse2Tile
+ * Return: none
+************************/
+__attribute__((target("sse2")))
+static void sse2Rgbx(const char *rows[], char *outs[])
+{
+        __m128i pixels[microTileRows];
+        for (int row = 0; row < microTileRows; row++)
+                pixels[row] = _mm_loadu_si128((const __m128i *)rows[row]);
+        sse2Transpose(pixels, outs);
+}
+
+/**********sse2Pad********
+ * About: This function copies a 4 x 4 micro-tile of 3 byte pixels to RGBX8
+ *        pixels with SSE2 registers
+ * Inputs: same as sse2Tile
+ * Return: none
+************************/
+__attribute__((target("sse2")))
+static void sse2Pad(const char *rows[], char *outs[])
+{
+        __m128i pixels[microTileRows];
+        for (int row = 0; row < microTileRows; row++)
+                pixels[row] = sse2Spread(sse2Load12(rows[row]));
+        sse2Transpose(pixels, outs);
+}
+
+/**********avx2Transpose********
+ * About: This function transposes 4 rows of 8 RGBX8 pixels, one 4 x 4
+ *        transpose in each 128 bit lane, and stores the columns of the low
+ *        lane as destination rows 0..3 and of the high lane as rows 4..7
+ * Inputs:
+ * __m256i rows[]: the 4 source rows, in destination order
+ * char *outs[]: the 8 destination rows, one for each source column
+ * Return: none
+************************/
+__attribute__((target("avx2")))
+static void avx2Transpose(__m256i rows[], char *outs[])
+{
+        __m256i low01 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+        __m256i low23 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+        __m256i high01 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+        __m256i high23 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+        __m256i out[4] = { _mm256_unpacklo_epi64(low01, low23),
+                           _mm256_unpackhi_epi64(low01, low23),
+                           _mm256_unpacklo_epi64(high01, high23),
+                           _mm256_unpackhi_epi64(high01, high23) };
+
+        for (int col = 0; col < 4; col++) {
+                _mm_storeu_si128((__m128i *)outs[col],
+                                 _mm256_castsi256_si128(out[col]));
+                _mm_storeu_si128((__m128i *)outs[col + 4],
+                                 _mm256_extracti128_si256(out[col], 1));
+        }
+}
+
+/**********avx2Rgbx********
+ * About: This function copies a 4 x 8 micro-tile of RGBX8 pixels with AVX2
+ *        registers, one register per source row
+ * Inputs: same as avx2Tile
+ * Return: none
+************************/
+__attribute__((target("avx2")))
+static void avx2Rgbx(const char *rows[], char *outs[])
+{
+        __m256i pixels[microTileRows];
+        for (int row = 0; row < microTileRows; row++)
+                pixels[row] = _mm256_loadu_si256((const __m256i *)rows[row]);
+        avx2Transpose(pixels, outs);
+}
+
+/**********avx2Pad********
+ * About: This function copies a 4 x 8 micro-tile of 3 byte pixels to RGBX8
+ *        pixels with AVX2 registers. Each lane gets 4 pixels of a row and
+ *        spreads them as sse2Spread does; AVX2 byte shifts stay inside a
+ *        lane, so the same shifts work.
+ * Inputs: same as avx2Tile
+ * Return: none
+************************/
+__attribute__((target("avx2")))
+static void avx2Pad(const char *rows[], char *outs[])
+{
+        const __m256i low24 = _mm256_set1_epi32(0x00ffffff);
+        __m256i pixels[microTileRows];
+
+        for (int row = 0; row < microTileRows; row++) {
+                __m256i packed = _mm256_inserti128_si256(
+                                 _mm256_castsi128_si256(
+                                 sse2Load12(rows[row])),
+                                 sse2Load12(rows[row] + 4 * pixelRgb8), 1);
+                __m256i first = _mm256_unpacklo_epi32(packed,
+                                _mm256_srli_si256(packed, 3));
+                __m256i second = _mm256_unpacklo_epi32(
+                                 _mm256_srli_si256(packed, 6),
+                                 _mm256_srli_si256(packed, 9));
+                pixels[row] = _mm256_and_si256(_mm256_unpacklo_epi64(first,
+                                               second), low24);
+        }
+        avx2Transpose(pixels, outs);
+}
+
+#endif
+
+#define pixelFormats 3
+
+/* the kernels of every pixel format, for each instruction set */
+static const struct microTile scalarKernels[pixelFormats] = {
+        { "scalar", sizeof(struct Pnm_rgb), sizeof(struct Pnm_rgb), 4,
+          scalarTile },
+        { "scalar", pixelRgbx8, pixelRgbx8, 4, scalarRgbx },
+        { "scalar", pixelRgb8, pixelRgbx8, 4, scalarPad },
+};
+#ifdef HAVE_X86_SIMD
+static const struct microTile sse2Kernels[pixelFormats] = {
+        { "sse2", sizeof(struct Pnm_rgb), sizeof(struct Pnm_rgb), 4,
+          sse2Tile },
+        { "sse2", pixelRgbx8, pixelRgbx8, 4, sse2Rgbx },
+        { "sse2", pixelRgb8, pixelRgbx8, 4, sse2Pad },
+};
+static const struct microTile avx2Kernels[pixelFormats] = {
+        { "avx2", sizeof(struct Pnm_rgb), sizeof(struct Pnm_rgb), 8,
+          avx2Tile },
+        { "avx2", pixelRgbx8, pixelRgbx8, 8, avx2Rgbx },
+        { "avx2", pixelRgb8, pixelRgbx8, 8, avx2Pad },
+};
+#endif
+
+static pthread_once_t selectOnce = PTHREAD_ONCE_INIT;
+static const struct microTile *selected = NULL;
+
+static void selectKernel(void);
+
+/**********microTileSelect********
+ * About: This function picks the micro-tile kernels on its first call and
+ *        returns the one for the given pixel sizes on every call. The
+ *        workers of a pool may make the first call at the same time; only
+ *        one of them picks.
+ * Inputs:
+ * int fromSize: bytes of a source pixel
+ * int toSize: bytes of a destination pixel
+ * Return: the chosen micro-tile kernel; NULL if there is none for those
+ *         sizes (Pnm_rgb to Pnm_rgb, RGBX8 to RGBX8, and 3 byte pixels to
+ *         RGBX8 have one)
+************************/
+const struct microTile *microTileSelect(int fromSize, int toSize)
+{
+        pthread_once(&selectOnce, selectKernel);
+        for (int i = 0; i < pixelFormats; i++) {
+                if (selected[i].fromSize == fromSize &&
+                    selected[i].toSize == toSize)
+                        return &selected[i];
+        }
+        return NULL;
+}
+
+/**********selectKernel********
+ * About: This function picks the micro-tile kernels from the CPUID bits
+ *        reported by the compiler runtime. PPMTRANS_SIMD may ask for
+ *        slower kernels, never for unsupported ones.
+ * Inputs: none
+ * Return: none
+ * Expects
+ * - Pnm_rgb pixels to be 12 bytes, which the vector kernels rely on; throws
+ *   CRE otherwise
+************************/
+static void selectKernel(void)
+{
+        assert(sizeof(struct Pnm_rgb) == 12);
+        selected = scalarKernels;
+
+#ifdef HAVE_X86_SIMD
+        const char *wanted = getenv("PPMTRANS_SIMD");
+        bool scalarOnly = wanted != NULL && strcmp(wanted, "scalar") == 0;
+        bool sse2Only = wanted != NULL && strcmp(wanted, "sse2") == 0;
+
+        __builtin_cpu_init();
+        if (!scalarOnly && __builtin_cpu_supports("sse2"))
+                selected = sse2Kernels;
+        if (!scalarOnly && !sse2Only && __builtin_cpu_supports("avx2"))
+                selected = avx2Kernels;
+#endif
+}
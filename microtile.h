@@ -0,0 +1,44 @@
+/*
+ *     microtile.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the register-blocked micro-tile kernels used by
+ *            kernels.c for 90, 270 degree rotations and the transposes. A
+ *            micro-tile is 4 source rows of pixels; each source column of it
+ *            is written as one packed row of 4 pixels in the destination.
+ *            There are kernels for Pnm_rgb pixels, for RGBX8 pixels, and for
+ *            the 3 byte pixels of a mapped P6 file padded to RGBX8 as they
+ *            are copied. The fastest kernels the CPU supports are picked at
+ *            runtime.
+ */
+
+#ifndef MICROTILE_INCLUDED
+#define MICROTILE_INCLUDED
+
+/* number of source rows in every micro-tile */
+#define microTileRows 4
+
+/**********microTileFun********
+ * About: copies a micro-tile. rows holds microTileRows source pointers, in the
+ *        order the pixels must appear in every destination row; outs holds
+ *        one destination pointer for each of the cols source columns.
+************************/
+typedef void microTileFun(const char *rows[], char *outs[]);
+
+/**********struct microTile********
+ * About: a micro-tile kernel, its name (scalar, sse2 or avx2), the bytes of
+ *        a source and of a destination pixel, and the number of source
+ *        columns it copies at once
+************************/
+struct microTile {
+        const char *name;
+        int fromSize;
+        int toSize;
+        int cols;
+        microTileFun *copy;
+};
+
+extern const struct microTile *microTileSelect(int fromSize, int toSize);
+
+#endif
@@ -0,0 +1,246 @@
+/*
+ *     numa.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the NUMA placement. The online nodes and
+ *            the CPUs of every node are read once from sysfs. Interleaving
+ *            is an mbind call on the mapping of a slab; first touch needs no
+ *            call at all, only that nobody writes the slab before the
+ *            workers (see slab.c) and that every worker always gets the
+ *            same tiles (see kernels.c).
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#include "assert.h"
+#include "numa.h"
+
+#define maxNodes 64
+#define mpolInterleave 3   /* MPOL_INTERLEAVE of <linux/mempolicy.h> */
+#define sysfsNodes "/sys/devices/system/node"
+#define modeVariable "UARRAY2_NUMA"
+
+static pthread_once_t nodesOnce = PTHREAD_ONCE_INIT;
+static pthread_once_t modeOnce = PTHREAD_ONCE_INIT;
+static int mode = -1;
+static int nodeCount = 1;
+static cpu_set_t nodeCpus[maxNodes]; /* by place among the online nodes */
+static unsigned long nodeMask;
+
+static void readNodes(void);
+static void readMode(void);
+static bool readList(const char *path, cpu_set_t *set);
+
+/**********numaParseMode********
+ * About: This function finds the mode with the given name
+ * Inputs:
+ * const char *name: "off", "interleave", or "first-touch"
+ * Return: numaOff, numaInterleave, or numaFirstTouch; -1 for any other name
+************************/
+int numaParseMode(const char *name)
+{
+        if (name == NULL)
+                return -1;
+        if (strcmp(name, "off") == 0)
+                return numaOff;
+        if (strcmp(name, "interleave") == 0)
+                return numaInterleave;
+        if (strcmp(name, "first-touch") == 0)
+                return numaFirstTouch;
+        return -1;
+}
+
+/**********numaSetMode********
+ * About: This function sets the placement mode, in place of the mode of the
+ *        environment
+ * Inputs:
+ * int newMode: numaOff, numaInterleave, or numaFirstTouch
+ * Return: none
+ * Expects
+ * - newMode to be one of the modes; throws CRE otherwise
+ * Note: It should be called before any slab is allocated or pool created.
+************************/
+void numaSetMode(int newMode)
+{
+        assert(newMode == numaOff || newMode == numaInterleave ||
+               newMode == numaFirstTouch);
+        mode = newMode;
+}
+
+/**********numaMode********
+ * About: This function returns the placement mode in effect
+ * Inputs: none
+ * Return: the mode that was set or read from the environment; numaOff on a
+ *         machine with a single node
+************************/
+int numaMode(void)
+{
+        pthread_once(&modeOnce, readMode);
+        return numaNodes() > 1 ? mode : numaOff;
+}
+
+/**********numaNodes********
+ * About: This function returns the number of online memory nodes
+ * Inputs: none
+ * Return: the number of nodes; 1 if sysfs does not tell
+************************/
+int numaNodes(void)
+{
+        pthread_once(&nodesOnce, readNodes);
+        return nodeCount;
+}
+
+/**********numaPlace********
+ * About: This function interleaves the pages of a mapping over the nodes
+ *        when that is the mode; it does nothing otherwise. The policy only
+ *        decides where pages go when they are first touched, so it must be
+ *        set before the mapping is written. Failures are ignored: the pages
+ *        then go where the kernel puts them anyway.
+ * Inputs:
+ * void *start: the first byte of the mapping, on a page boundary
+ * size_t length: the length of the mapping
+ * Return: none
+************************/
+void numaPlace(void *start, size_t length)
+{
+        if (numaMode() != numaInterleave)
+                return;
+        unsigned long mask = nodeMask;
+        syscall(SYS_mbind, start, length, mpolInterleave, &mask,
+                (unsigned long)maxNodes + 1, 0UL);
+}
+
+/**********numaPinWorker********
+ * About: This function pins a worker of a pool to the CPUs of its node.
+ *        The workers are split into one group per node, in order, and a
+ *        worker gets the CPU of its node that its place in the group picks,
+ *        so the workers holding neighbouring bands of tiles share a node.
+ * Inputs:
+ * pthread_t thread: the worker thread
+ * int worker: index of the worker
+ * int workers: number of workers in the pool
+ * Return: true if the worker was pinned; false if there is no placement
+ *         to follow, and the caller should pin the worker its own way
+************************/
+bool numaPinWorker(pthread_t thread, int worker, int workers)
+{
+        if (numaMode() == numaOff)
+                return false;
+
+        int node = (long)worker * nodeCount / workers;
+        int first = ((long)node * workers + nodeCount - 1) / nodeCount;
+        cpu_set_t allowed, cpus;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+                return false;
+        CPU_AND(&cpus, &allowed, &nodeCpus[node]);
+        int count = CPU_COUNT(&cpus);
+        if (count == 0)
+                return false;
+
+        /* find the (place mod count)-th CPU of the node */
+        int wanted = (worker - first) % count;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (!CPU_ISSET(cpu, &cpus))
+                        continue;
+                if (wanted-- == 0) {
+                        cpu_set_t one;
+                        CPU_ZERO(&one);
+                        CPU_SET(cpu, &one);
+                        return pthread_setaffinity_np(thread, sizeof(one),
+                                                      &one) == 0;
+                }
+        }
+        return false;
+}
+
+/**********readNodes********
+ * About: This function reads the online nodes and their CPUs from sysfs.
+ *        Nodes past maxNodes or without a CPU list are left out, and if
+ *        fewer than two nodes are left, the machine counts as one node.
+ * Inputs: none
+ * Return: none
+************************/
+static void readNodes(void)
+{
+        cpu_set_t online;
+        if (!readList(sysfsNodes "/online", &online))
+                return;
+
+        int count = 0;
+        unsigned long mask = 0;
+        for (int node = 0; node < maxNodes; node++) {
+                if (!CPU_ISSET(node, &online))
+                        continue;
+                char path[64];
+                snprintf(path, sizeof(path), sysfsNodes "/node%d/cpulist",
+                         node);
+                if (!readList(path, &nodeCpus[count]))
+                        continue;
+                count++;
+                mask |= 1UL << node;
+        }
+        if (count > 1) {
+                nodeCount = count;
+                nodeMask = mask;
+        }
+}
+
+/**********readMode********
+ * About: This function reads the mode from the environment, unless
+ *        numaSetMode already chose one; an unknown name is off
+ * Inputs: none
+ * Return: none
+************************/
+static void readMode(void)
+{
+        if (mode >= 0)
+                return;
+        const char *name = getenv(modeVariable);
+        mode = numaParseMode(name);
+        if (mode < 0 && name != NULL && *name != '\0')
+                fprintf(stderr, "%s: unknown mode '%s', using off\n",
+                        modeVariable, name);
+        if (mode < 0)
+                mode = numaOff;
+}
+
+/**********readList********
+ * About: This function reads a sysfs list such as "0-3,8-11" into a set
+ * Inputs:
+ * const char *path: the sysfs file
+ * cpu_set_t *set: where to store the numbers of the list
+ * Return: true if the file could be read; false otherwise
+************************/
+static bool readList(const char *path, cpu_set_t *set)
+{
+        FILE *fp = fopen(path, "r");
+        if (fp == NULL)
+                return false;
+        char text[1024];
+        bool read = fgets(text, sizeof(text), fp) != NULL;
+        fclose(fp);
+        if (!read)
+                return false;
+
+        CPU_ZERO(set);
+        char *next = text;
+        while (isdigit((unsigned char)*next)) {
+                long low = strtol(next, &next, 10);
+                long high = low;
+                if (*next == '-')
+                        high = strtol(next + 1, &next, 10);
+                for (long i = low; i <= high && i < CPU_SETSIZE; i++)
+                        CPU_SET(i, set);
+                if (*next == ',')
+                        next++;
+        }
+        return true;
+}
@@ -0,0 +1,43 @@
+/*
+ *     numa.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file places the pages of large arrays and the workers of a
+ *            thread pool on the memory nodes of a machine with more than one
+ *            of them, so that workers do not pull every pixel across the
+ *            interconnect from the node of the thread that read the image:
+ *              off          the kernel's default (the default)
+ *              interleave   the pages of a large slab go round robin over
+ *                           the nodes
+ *              first-touch  a large slab is left untouched until the
+ *                           workers fill it, each worker always filling the
+ *                           same band of tiles, so every page lands on the
+ *                           node of the worker that writes it
+ *            In both modes the workers are pinned node by node: the first
+ *            ones to the CPUs of node 0, the next ones to node 1, and so on.
+ *            The mode is set by numaSetMode, or else read from the
+ *            UARRAY2_NUMA environment variable. On a machine with a single
+ *            node every mode acts like off. The policy is set with the raw
+ *            mbind system call, so libnuma is not needed.
+ */
+
+#ifndef NUMA_INCLUDED
+#define NUMA_INCLUDED
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define numaOff 0
+#define numaInterleave 1
+#define numaFirstTouch 2
+
+extern int numaParseMode(const char *name);
+extern void numaSetMode(int mode);
+extern int numaMode(void);
+extern int numaNodes(void);
+extern void numaPlace(void *start, size_t length);
+extern bool numaPinWorker(pthread_t thread, int worker, int workers);
+
+#endif
@@ -14,27 +14,23 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <mem.h>
 
 #include "assert.h"
 #include "operations.h"
 #include "a2methods.h"
 #include "pnm.h"
-#include "cputiming.h"
-
-/***********************
- * rotation operation without an explicit degree were assigned an integer value
- * for easier calculation and operation. rotation operations with an explicit
- * degree were assigned to their angle values for easier operation
-************************/
-#define rotation0 0
-#define rotation90 90
-#define rotation180 180
-#define rotation270 270
-
-#define flipHorizontal 1
-#define flipVertical 2
-#define transpose 3
-
+#include "timing.h"
+#include "kernels.h"
+#include "stream.h"
+#include "pipeline.h"
+#include "external.h"
+#include "mapped.h"
+#include "tiled.h"
+#include "writer.h"
+#include "uring.h"
+#include "a2parallel.h"
+#include "uarray2.h"
 
 /**********struct rotateParameters********
  * About: This struct hold the parameters A2Methods_T methods suite, client 
@@ -47,234 +43,695 @@ struct rotateParameters {
         int rotationType;
 };
 
+/**********struct workerPhases********
+ * About: This struct holds the phases every worker of the pool times for
+ *        itself while the pool does a phase of an image, with the log that
+ *        says which counters to open and the phase they are stopped as
+************************/
+struct workerPhases {
+        TimeLog_T log;
+        struct phaseTimes *workers;
+        int phase;
+};
+
+/**********struct d4Element********
+ * About: This struct pairs a rotation type with the matrix of what it does
+ *        to the (col, row) position of a pixel measured from the center of
+ *        the image: new col = m[0] * col + m[1] * row and new row = m[2] * col
+ *        + m[3] * row. The eight rotation types (0, 90, 180, 270 degrees,
+ *        the two flips, transpose, and anti-transpose) are the eight
+ *        elements of the dihedral group D4, the symmetries of a square, so
+ *        any two of them in a row are one of them again.
+************************/
+struct d4Element {
+        int rotationType;
+        int m[4];
+};
+
+static const struct d4Element d4[] = {
+        { rotation0,      {  1,  0,  0,  1 } },
+        { rotation90,     {  0, -1,  1,  0 } },
+        { rotation180,    { -1,  0,  0, -1 } },
+        { rotation270,    {  0,  1, -1,  0 } },
+        { flipHorizontal, { -1,  0,  0,  1 } },
+        { flipVertical,   {  1,  0,  0, -1 } },
+        { transpose,      {  0,  1,  1,  0 } },
+        { antiTranspose,  {  0, -1, -1,  0 } },
+};
+
+#define d4Size ((int)(sizeof(d4) / sizeof(d4[0])))
+
+static bool mappedStart(FILE *fp, struct mappedImage *mapped,
+                        struct operationOptions *options);
+static void mappedOperation(A2Methods_T methods, struct mappedImage *mapped,
+                            int rotation, struct operationOptions *options);
+static void mappedInPlace(A2Methods_T methods, struct mappedImage *mapped,
+                          int rotation, struct operationOptions *options);
+static bool rotatesInPlace(A2Methods_T methods, int rotation,
+                           struct operationOptions *options);
+static bool tiledStart(struct tiledImage *tiled,
+                       struct operationOptions *options);
+static void tiledOperation(A2Methods_T methods, struct tiledImage *tiled,
+                           int rotation, A2Methods_mapfun *map,
+                           struct operationOptions *options);
+static void decodedOperation(FILE *fp, A2Methods_T methods, int rotation,
+                             A2Methods_mapfun *map,
+                             struct mappedImage *read,
+                             struct operationOptions *options);
+static int pixelSize(const struct mappedImage *mapped, int pixels);
+static void outputImage(Pnm_ppm image, struct operationOptions *options);
+static double ppmBytes(int width, int height, unsigned maxval);
+static void operationName(int rotationType, char operation[20]);
+static A2Methods_UArray2 newArray(A2Methods_T methods, int width, int height,
+                                  int size, struct operationOptions *options);
+static void freeArray(A2Methods_T methods, A2Methods_UArray2 *array,
+                      struct operationOptions *options);
+static struct phaseTimes *poolStart(struct operationOptions *options);
+static void poolStop(struct operationOptions *options,
+                     struct phaseTimes *workers, int phase, double bytes);
+static void workerStart(int worker, void *workerStruct);
+static void workerStop(int worker, void *workerStruct);
+
+/**********d4Find********
+ * About: This function finds the group element of a rotation type
+ * Inputs:
+ * int rotationType: value keeping track of the type of rotation
+ * Return: the element of d4 with that rotation type
+ * Expects
+ * - rotationType to be one of the rotation types; throws CRE otherwise
+************************/
+static const struct d4Element *d4Find(int rotationType)
+{
+        for (int i = 0; i < d4Size; i++) {
+                if (d4[i].rotationType == rotationType)
+                        return &d4[i];
+        }
+        assert(false);
+        return NULL;
+}
+
+/**********composeRotation********
+ * About: This function returns the single rotation type that does the same
+ *        as doing first and then second, so a chain of command line
+ *        operations can be done in one pass over the image
+ * Inputs:
+ * int first: the rotation type done first
+ * int second: the rotation type done after it
+ * Return: the rotation type equal to the two in a row
+ * Expects
+ * - first and second to be rotation types; throws CRE otherwise
+************************/
+int composeRotation(int first, int second)
+{
+        const int *a = d4Find(first)->m;
+        const int *b = d4Find(second)->m;
+
+        /* the matrix of the composition is b * a */
+        int m[4] = { b[0] * a[0] + b[1] * a[2], b[0] * a[1] + b[1] * a[3],
+                     b[2] * a[0] + b[3] * a[2], b[2] * a[1] + b[3] * a[3] };
+
+        for (int i = 0; i < d4Size; i++) {
+                if (memcmp(d4[i].m, m, sizeof(m)) == 0)
+                        return d4[i].rotationType;
+        }
+        assert(false);
+        return rotation0;
+}
+
+/**********rotationSwapsSides********
+ * About: This function tells whether a rotation type makes the columns of
+ *        the image its rows, so that the width and height trade places
+ * Inputs:
+ * int rotationType: value keeping track of the type of rotation
+ * Return: true for 90, 270 degree rotations, transpose, and anti-transpose;
+ *         false otherwise
+************************/
+bool rotationSwapsSides(int rotationType)
+{
+        return rotationType == rotation90 || rotationType == rotation270 ||
+               rotationType == transpose || rotationType == antiTranspose;
+}
+
 /**********rotationHandler********
  * About: This function copies pixel values from an image to a Pnm_ppm struct,
  *        implements the given rotation type on the image, and prints resulting
- *        image to the stdout. If the user provided a nonnull time_file_name,
- *        the user also records the timing information for the rotation 
- *        implemented
+ *        image to options->output. If the user gave a timing log, the phases
+ *        of the image (read, allocate, transform, write, free) are timed and
+ *        recorded in it.
  * Inputs:
  * FILE *fp: Pointer to the ppm file provided by the user
  * A2Methods_T methods: The method suite for A2Methods_UArray2
  * int rotation: The rotation type provided by the user
  * A2Methods_mapfun *map: The mapping function that is chosen by the user to 
- * copy pixels from the source image
- * char *time_file_name: the name of the output file if the user wants to 
- * record time information; null, otherwise.
- * char *inputFile: the name of the input file, if the file was provided by the
- * user in a file; null, otherwise.
+ * copy pixels from the source image, or NULL to use the tiled kernels
+ * struct operationOptions *options: the timing log, input file name, thread
+ * pool, and modes chosen by the user; with options->stream, operations that
+ * keep rows as rows are streamed by stream.c instead, and with
+ * options->memLimit, the others are done out of core by external.c; with
+ * options->pipeline, the image is read, rotated, and written by three
+ * threads at once by pipeline.c instead; with options->tiledOutput, the
+ * result is written as a container (see tiled.h)
  * Return: none
+ * Note: When the tiled kernels are used and the input is a P6 file named on
+ * the command line, the file is mapped and rotated from its own bytes; fp is
+ * then not read. Input from fp (the standard input) is read whole into
+ * memory and used the same way when it is a P6 image, and decoded from
+ * memory by Pnm_ppmread otherwise. With options->inPlace, an operation
+ * rotate() does in place is still done in place: the mapped pixels are
+ * copied into the one array first. The same goes for a container named on
+ * the command line, whatever the suite.
  * Expects
- * - File pointer, methods, and map to be nonnull; throws CRE if any of them 
- * are null.
+ * - File pointer, methods, and options to be nonnull; throws CRE if any of
+ * them are null.
 ************************/
 void operationHandler(FILE *fp, A2Methods_T methods, int rotation, 
-                    A2Methods_mapfun *map, char *time_file_name, 
-                    char *inputFile) 
+                    A2Methods_mapfun *map, struct operationOptions *options) 
 {
 
-        assert(fp != NULL && methods != NULL && map != NULL);
-                        
-        /* copy pixels from source file in the given way */
-        Pnm_ppm image = Pnm_ppmread(fp, methods);
-
-        /* keep track of width and height and initialize timer instance */
-        int width = image->width;
-        int height = image->height;
-        CPUTime_T timer = CPUTime_New();
-        assert(timer != NULL);
-
-        /* call rotate func. with proper arguments given the rotation type */
-        if (rotation == rotation0) {
-                timerStarter(timer, time_file_name);
-                timerStopper(timer, time_file_name, "0 degree rotation", 
-                             width * height, inputFile, width, height);
-        }
-        else if (rotation == rotation90) {
-                rotate(methods, image, map, height, width, rotation90, timer, 
-                       time_file_name, inputFile);
-        }
-        else if (rotation == rotation180) {
-                rotate(methods, image, map, width, height, rotation180, timer, 
-                       time_file_name, inputFile);
+        assert(fp != NULL && methods != NULL && options != NULL);
+
+        /* time the phases of this image if the user asked for it */
+        struct phaseTimes phases;
+        if (options->timeLog != NULL) {
+                phasesInit(&phases, options->timeLog);
+                options->phases = &phases;
         }
-        else if (rotation == rotation270) {
-                rotate(methods, image, map, height, width, rotation270, timer, 
-                       time_file_name, inputFile);
+
+        /* a container is used as a blocked array where it is mapped; the
+         * stages of the pipeline overlap; row-local operations can go from
+         * the file to the output row by row; with a memory limit the image
+         * goes through a file of tiles; a P6 file can be rotated straight
+         * from the page cache, without decoding it into an array first.
+         * The pipelined, streamed, and out-of-core modes only write P6, and
+         * the pipeline holds the whole result unless rows stay rows. */
+        struct tiledImage tiled;
+        struct mappedImage mapped;
+        mapped.map = NULL;
+        int threads = options->pool == NULL ? 1 :
+                      ThreadPool_size(options->pool);
+        if (options->inputFile != NULL && tiledStart(&tiled, options)) {
+                tiledOperation(methods, &tiled, rotation, map, options);
+        } else if (options->pipeline && !options->tiledOutput &&
+                   (options->memLimit == 0 || streamSupports(rotation)) &&
+                   pipelineSupports(fp, rotation)) {
+                pipelineOperation(fp, rotation, options);
+                threads = pipelineThreads(rotation, options);
+        } else if (options->stream && !options->tiledOutput &&
+                   streamSupports(rotation)) {
+                streamOperation(fp, rotation, options);
+        } else if (options->memLimit > 0 && !options->tiledOutput) {
+                externalOperation(fp, rotation, options);
+        } else if (map == NULL && kernelSupports(methods) && 
+                   mappedStart(fp, &mapped, options)) {
+                mappedOperation(methods, &mapped, rotation, options);
+        } else {
+                /* a stream that was not a P6 image is decoded from the
+                 * bytes mappedStart read */
+                decodedOperation(fp, methods, rotation, map,
+                                 mapped.map != NULL ? &mapped : NULL,
+                                 options);
         }
-        else if (rotation == flipHorizontal) {
-                rotate(methods, image, map, width, height, flipHorizontal, 
-                       timer, time_file_name, inputFile);
+
+        if (options->timeLog != NULL) {
+                char operation[20];
+                operationName(rotation, operation);
+                TimeLog_record(options->timeLog, &phases, options->inputFile,
+                               operation, threads);
+                phasesFree(&phases);
+                options->phases = NULL;
         }
-        else if (rotation == flipVertical) {
-                rotate(methods, image, map, width, height, flipVertical, timer,
-                       time_file_name, inputFile);
+}
+
+/**********decodedOperation********
+ * About: This function reads the image with Pnm_ppmread, does the operation
+ *        with rotate(), and prints the result (0 degree rotation leaves the
+ *        image as it was read). With the io_uring backend, a file named on
+ *        the command line is first read whole through the ring, and
+ *        Pnm_ppmread reads it from memory.
+ * Inputs: same as operationHandler, and
+ * struct mappedImage *read: the input already read whole by mappedRead, to
+ * decode instead of fp and to close; NULL if fp has not been read
+ * Return: none
+************************/
+static void decodedOperation(FILE *fp, A2Methods_T methods, int rotation,
+                             A2Methods_mapfun *map,
+                             struct mappedImage *read,
+                             struct operationOptions *options)
+{
+        /* copy pixels from source file in the given way */
+        phaseStart(options->phases);
+        void *contents = NULL;
+        FILE *source = NULL;
+        if (read != NULL)
+                source = fmemopen(read->map, read->length, "r");
+        else if (options->inputFile != NULL)
+                source = uringStream(fp, &contents);
+        assert(read == NULL || source != NULL);
+        Pnm_ppm image = Pnm_ppmread(source != NULL ? source : fp, methods);
+        if (source != NULL) {
+                fclose(source);
+                FREE(contents);
         }
-        else if (rotation == transpose) {
-                rotate(methods, image, map, height, width, transpose, timer, 
-                       time_file_name, inputFile);
+        if (read != NULL)
+                mappedClose(read);
+        phaseStop(options->phases, phaseRead, 
+                  ppmBytes(image->width, image->height, image->denominator));
+
+        /* call rotate func. with the dimensions of the rotated image */
+        if (rotation != rotation0) {
+                bool sidesSwap = rotationSwapsSides(rotation);
+                rotate(methods, image, map, 
+                       sidesSwap ? image->height : image->width, 
+                       sidesSwap ? image->width : image->height, rotation, 
+                       options);
         }
-        
-        /* free the timer instance */
-        CPUTime_Free(&timer);
+        phaseSize(options->phases, image->width, image->height);
 
         /* print out the resulting image and free the Pnm_ppm instance */
-        Pnm_ppmwrite(stdout, image);
+        outputImage(image, options);
+
+        double arrayBytes = (double)image->width * image->height * 
+                            methods->size(image->pixels);
+        phaseStart(options->phases);
         Pnm_ppmfree(&image);
+        phaseStop(options->phases, phaseFree, arrayBytes);
 }
 
-/**********timerStarter********
- * About: This function starts the timer if the time_file_name is nonnull,
- *        meaning that an output file for the time information is given, so
- *        the time infromation is requested from the program
+/**********ppmBytes********
+ * About: This function returns the size of the pixels of a P6 image
  * Inputs:
- * CPUTime_T timer: CPUTime_T instance to keep track of the time for the 
- *                  chosen operations
- * char *time_file_name: the name of the output file if the user wants to 
- * record time information; null, otherwise.
- * Return: none
- * Expects
- * - timer to be nonnull; throws CRE otherwise
+ * int width, int height: dimensions of the image
+ * unsigned maxval: the largest value of a sample
+ * Return: the number of bytes
 ************************/
-void timerStarter(CPUTime_T timer, char *time_file_name) 
+static double ppmBytes(int width, int height, unsigned maxval)
 {
-        assert(timer != NULL);
-        if (time_file_name != NULL) {
-                CPUTime_Start(timer);
-        } 
+        return (double)width * height * (maxval > 255 ? 6 : 3);
 }
 
-/**********timerStopper********
- * About: This function stops the time recording given the user asked for time
- *        information. Then, it calls timePrinter with needed information to 
- *        output timing information to the output file.
+/**********rotate********
+ * About: This function implements the desired type of rotation, timing the
+ *        allocation of the new array, the copy, and the freeing of the old
+ *        one as phases if the user asked for timing. Without a
+ *        mapping function, the pixels are copied by the tiled kernels in
+ *        kernels.c (180 degree rotation and flips are done in place, without
+ *        a second array, and so are 90, 270 degree rotations and the
+ *        transposes of plain arrays if options->inPlace is set); methods
+ *        the kernels do not know fall back to map_default. A mapping
+ *        function walks the source and scatters the pixels with
+ *        rotateApply, or walks the new array and gathers them with
+ *        gatherApply, as options->traversal says.
  * Inputs:
- * CPUTime_T timer: CPUTime_T instance to keep track of the time for the 
- * chosen operations
- * char *time_file_name: the name of the output file if the user wants to 
- * record time information; null, otherwise.
- * char *operation: holds information about the type of the operation
- * int pixelNum: holds the number of pixels in the inputted file
- * char *inputFile: the name of the input file, if the file was provided by the
- * user in a file; null, otherwise.
- * int width: holds the width information about the resulting image
- * int height: holds the height information about the resulting image
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * Pnm_ppm image: the struct holding the pixel information from the input image
+ * A2Methods_mapfun *map: The mapping function that is chosen by the user to 
+ * copy pixels from the source image, or NULL to use the tiled kernels
+ * int newWidth: width value of the rotated image
+ * int newHeigh: heigth value of the rotated image
+ * int rotationType: value keeping track of the type of rotation to be 
+ * implemented
+ * struct operationOptions *options: the phases to time (NULL for none),
+ * thread pool, spare array, traversal, and in-place choice of the user; the
+ * pool is only used by the kernels
  * Return: none
  * Expects
- * - timer and operation to be nonnull; throws CRE if any of them 
- * are null.
+ * - methods, image, and options to be nonnull; throws CRE if any of them are
+ * null.
 ************************/
-void timerStopper(CPUTime_T timer, char *time_file_name, char *operation, 
-                  int pixelNum, char *inputFile, int width, int height) 
+void rotate(A2Methods_T methods, Pnm_ppm image, A2Methods_mapfun *map, 
+            int newWidth, int newHeight, int rotationType, 
+            struct operationOptions *options) 
 {
-        assert(timer != NULL && operation != NULL);
-        if (time_file_name != NULL) {
-                /* record the time used and call the printer function */
-                double time_used = CPUTime_Stop(timer);
-                timePrinter(time_used, pixelNum, time_file_name, operation, 
-                            inputFile, width, height); 
+        assert(methods != NULL && image != NULL && options != NULL);
+
+        int size = methods->size(image->pixels);
+        double arrayBytes = (double)newWidth * newHeight * size;
+        bool kernels = map == NULL && kernelSupports(methods);
+        bool inPlace = kernels && rotatesInPlace(methods, rotationType,
+                                                 options);
+        if (inPlace && kernelInPlace(rotationType)) {
+                /* swap the pixels inside the image; no second array */
+                struct phaseTimes *workers = poolStart(options);
+                kernelRotateInPlace(methods, image->pixels, rotationType,
+                                    options->pool);
+                poolStop(options, workers, phaseTransform, arrayBytes);
+        } else if (inPlace) {
+                /* move the pixels along the cycles of the rotation inside
+                 * the image buffer, then swap its width and height */
+                phaseStart(options->phases);
+                kernelRotateByCycles(methods, image->pixels, rotationType);
+                phaseStop(options->phases, phaseTransform, arrayBytes);
+                image->width = methods->width(image->pixels);
+                image->height = methods->height(image->pixels); 
+        } else {
+                /* initiate 2D array to hold rotated image info */
+                phaseStart(options->phases);
+                A2Methods_UArray2 rotated = newArray(methods, newWidth, 
+                                                     newHeight, size, 
+                                                     options);
+                phaseStop(options->phases, phaseAllocate, arrayBytes);
+
+                struct phaseTimes *workers = poolStart(options);
+                if (kernels) {
+                        /* copy the pixels tile by tile through raw pointers */
+                        kernelRotate(methods, image->pixels, rotated, 
+                                     rotationType, options->pool);
+                } else {
+                        if (map == NULL)
+                                map = methods->map_default;
+
+                        if (options->traversal == traversalGather) {
+                                /* walk the new array in map order and fetch
+                                 * every pixel from its source */
+                                struct rotateParameters prm = {methods, 
+                                                               image->pixels,
+                                                               rotationType};
+                                map(rotated, gatherApply, &prm);
+                        } else {
+                                /* initiate rotateParameters to hold info for
+                                 * map */
+                                struct rotateParameters prm = {methods, 
+                                                               rotated, 
+                                                               rotationType};
+                                /* call map function with rotation apply 
+                                 * function */
+                                map(image->pixels, rotateApply, &prm);
+                        }
+                }
+                poolStop(options, workers, phaseTransform, arrayBytes);
+
+                /* free (or keep for the next image) the current pixels and
+                 * update to rotated version */
+                phaseStart(options->phases);
+                freeArray(methods, &image->pixels, options);
+                phaseStop(options->phases, phaseFree, arrayBytes);
+                image->pixels = rotated;
+                image->width = methods->width(rotated);
+                image->height = methods->height(rotated); 
         }
 }
 
-/**********timePrinter********
- * About: This function opens the given output file for the time information
- *        and prints the detailed information, which includes file name (if
- *        the input file is NOT taken from the standard input), pixels in the
- *        image, width/height, operation type, total time, and time per pixel
+/**********mappedStart********
+ * About: This function maps the input file, or reads fp whole into memory
+ *        when no file is named, timed as the read phase
  * Inputs:
- * double time_used: the amount of time (in nanoseconds) from the moment that
- *                   the timer is started until the timer is stopped
- * int pixelNum: holds the number of pixels in the inputted file
- * char *time_file_name: the name of the output file if the user wants to 
- * record time information; null, otherwise.
- * char *operation: holds information about the type of the operation
- * char *inputFile: the name of the input file, if the file was provided by the
- * user in a file; null, otherwise.
- * int width: holds the width information about the resulting image
- * int height: holds the height information about the resulting image
+ * FILE *fp: the input when options names no file
+ * struct mappedImage *mapped: the struct to fill; its map is left NULL
+ * unless fp was read
+ * struct operationOptions *options: the input file name and the phases
+ * Return: true if the input is a P6 image; false if it has to be read by
+ *         Pnm_ppmread (from the bytes in mapped->map, if fp was read)
+************************/
+static bool mappedStart(FILE *fp, struct mappedImage *mapped,
+                        struct operationOptions *options)
+{
+        phaseStart(options->phases);
+        bool ok = options->inputFile != NULL ?
+                  mappedOpen(options->inputFile, mapped) :
+                  mappedRead(fp, mapped);
+        if (!ok) {
+                if (mapped->map != NULL)
+                        phaseStop(options->phases, phaseRead, 0);
+                return false;
+        }
+        phaseStop(options->phases, phaseRead, 
+                  ppmBytes(mapped->width, mapped->height, mapped->maxval));
+        return true;
+}
+
+/**********mappedOperation********
+ * About: This function does the given operation on a mapped P6 file with
+ *        kernelRotateMapped, prints the resulting image to options->output,
+ *        and unmaps the file. Only the rotated image is allocated, with the
+ *        pixel format of options->pixels. If the user asked for timing, the
+ *        phases are timed as in rotate(). With options->inPlace, the
+ *        operations rotate() does inside the array are left to
+ *        mappedInPlace. (Without it, 180 degree rotation and the flips are
+ *        copied too: the file is not an array, so copying it still makes
+ *        only one, and in one pass instead of two.)
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * struct mappedImage *mapped: the file, mapped by mappedOpen
+ * int rotation: The rotation type provided by the user
+ * struct operationOptions *options: the phases to time, thread pool, output
+ * stream, and spare array
  * Return: none
- * Expects
- * - operation and time_file_name to be nonnull; throws CRE otherwise
 ************************/
-void timePrinter(double time_used, int pixelNum, char *time_file_name, 
-                 char *operation, char *inputFile, int width, int height) 
+static void mappedOperation(A2Methods_T methods, struct mappedImage *mapped,
+                            int rotation, struct operationOptions *options)
 {
-        assert(operation != NULL && time_file_name != NULL);
+        if (options->inPlace && rotatesInPlace(methods, rotation, options)) {
+                mappedInPlace(methods, mapped, rotation, options);
+                return;
+        }
 
-        /* opening the output file for that time infromation */
-        FILE *fp = fopen(time_file_name, "a");
-        assert(fp != NULL);
-        
-        /* printing the image time information obtained by the timer */
-        fprintf(fp, "NEW IMAGE TIME INFORMATION:\n");
-        /* checksif the inputFile is null, if it is not, meaning that the
-         * input is taken as a file, it prints out the file name
-         */
-        if (inputFile != NULL)
-                fprintf(fp, "File name: %s\n", inputFile);
-        fprintf(fp, "Number of pixels in the image: %d\n", pixelNum);
-        fprintf(fp, "Width the image: %d\n", width);
-        fprintf(fp, "Height the image: %d\n", height);
-        fprintf(fp, "Operation implemented: %s\n", operation);
-        fprintf(fp, "Total time for the operation: %f nanoseconds\n", 
-                time_used);
-        fprintf(fp, "Time per pixel for the operation: %f nanoseconds\n", 
-                time_used / (float)pixelNum);
-        fprintf(fp, "----------------------------------------------------\n");
-        
-        /* closing the output file for that time infromation */
-        fclose(fp);
+        int width = mapped->width;
+        int height = mapped->height;
+        bool sidesSwap = rotationSwapsSides(rotation);
+        int newWidth = sidesSwap ? height : width;
+        int newHeight = sidesSwap ? width : height;
+        int size = pixelSize(mapped, options->pixels);
+        double arrayBytes = (double)width * height * size;
+        double fileBytes = ppmBytes(width, height, mapped->maxval);
+        phaseSize(options->phases, newWidth, newHeight);
+
+        phaseStart(options->phases);
+        A2Methods_UArray2 rotated = newArray(methods, newWidth, newHeight, 
+                                             size, options);
+        phaseStop(options->phases, phaseAllocate, arrayBytes);
+
+        struct phaseTimes *workers = poolStart(options);
+        kernelRotateMapped(methods, mapped, rotated, rotation, options->pool);
+        poolStop(options, workers, phaseTransform, arrayBytes);
+
+        /* the file is no longer needed once it has been copied */
+        struct Pnm_ppm image;
+        image.width = newWidth;
+        image.height = newHeight;
+        image.denominator = mapped->maxval;
+        image.pixels = rotated;
+        image.methods = methods;
+        phaseStart(options->phases);
+        mappedClose(mapped);
+        phaseStop(options->phases, phaseFree, fileBytes);
+
+        outputImage(&image, options);
+
+        phaseStart(options->phases);
+        freeArray(methods, &rotated, options);
+        phaseStop(options->phases, phaseFree, arrayBytes);
 }
 
-/**********rotate********
- * About: This function implements the desired type of rotation, and starts and
- *        stops the timer information if the user asked for timing.
+/**********mappedInPlace********
+ * About: This function does an operation that rotate() does inside the
+ *        array of the image on a mapped P6 file. The pixels are copied as
+ *        they are into an array with the pixel format of options->pixels
+ *        (timed with the read phase), the file is unmapped, and rotate()
+ *        turns the array in place, so there is never a second array.
+ * Inputs: same as mappedOperation
+ * Return: none
+************************/
+static void mappedInPlace(A2Methods_T methods, struct mappedImage *mapped,
+                          int rotation, struct operationOptions *options)
+{
+        int width = mapped->width;
+        int height = mapped->height;
+        int size = pixelSize(mapped, options->pixels);
+        double arrayBytes = (double)width * height * size;
+
+        phaseStart(options->phases);
+        A2Methods_UArray2 pixels = newArray(methods, width, height, size,
+                                            options);
+        phaseStop(options->phases, phaseAllocate, arrayBytes);
+
+        struct phaseTimes *workers = poolStart(options);
+        kernelRotateMapped(methods, mapped, pixels, rotation0, options->pool);
+        poolStop(options, workers, phaseRead, 0);
+
+        struct Pnm_ppm image;
+        image.width = width;
+        image.height = height;
+        image.denominator = mapped->maxval;
+        image.pixels = pixels;
+        image.methods = methods;
+        phaseStart(options->phases);
+        mappedClose(mapped);
+        phaseStop(options->phases, phaseFree,
+                  ppmBytes(width, height, image.denominator));
+
+        bool sidesSwap = rotationSwapsSides(rotation);
+        rotate(methods, &image, NULL, sidesSwap ? height : width,
+               sidesSwap ? width : height, rotation, options);
+        phaseSize(options->phases, image.width, image.height);
+
+        outputImage(&image, options);
+
+        phaseStart(options->phases);
+        freeArray(methods, &image.pixels, options);
+        phaseStop(options->phases, phaseFree, arrayBytes);
+}
+
+/**********rotatesInPlace********
+ * About: This function tells whether rotate() does an operation with the
+ *        kernels inside the array of the image, without a second array
  * Inputs:
  * A2Methods_T methods: The method suite for A2Methods_UArray2
- * Pnm_ppm image: the struct holding the pixel information from the input image
- * A2Methods_mapfun *map: The mapping function that is chosen by the user to 
- * copy pixels from the source image
- * int newWidth: width value of the rotated image
- * int newHeigh: heigth value of the rotated image
- * int rotationType: value keeping track of the type of rotation to be 
- * implemented
- * CPUTime_T timer: CPUTime_T instance to keep track of the time for the 
- * chosen operations
- * char *time_file_name: the name of the output file if the user wants to 
- * record time information; null, otherwise.
- * char *inputFile: the name of the input file, if the file was provided by the
- * user in a file; null, otherwise.
+ * int rotation: The rotation type provided by the user
+ * struct operationOptions *options: the in-place choice of the user
+ * Return: true for 180 degree rotation and the flips, and for 90, 270
+ *         degree rotations and the transposes of plain arrays if
+ *         options->inPlace is set; false otherwise
+************************/
+static bool rotatesInPlace(A2Methods_T methods, int rotation,
+                           struct operationOptions *options)
+{
+        return kernelSupports(methods) && (kernelInPlace(rotation) ||
+               (options->inPlace && kernelCycles(methods, rotation)));
+}
+
+/**********tiledStart********
+ * About: This function maps the input file if it is a container, timed as
+ *        the read phase
+ * Inputs:
+ * struct tiledImage *tiled: the struct to fill
+ * struct operationOptions *options: the input file name and the phases
+ * Return: true if the file is a container; false otherwise
+************************/
+static bool tiledStart(struct tiledImage *tiled,
+                       struct operationOptions *options)
+{
+        phaseStart(options->phases);
+        if (!tiledOpen(options->inputFile, tiled))
+                return false;
+        phaseStop(options->phases, phaseRead,
+                  ppmBytes(tiled->width, tiled->height, tiled->maxval));
+        return true;
+}
+
+/**********tiledOperation********
+ * About: This function does the given operation on a mapped container. The
+ *        tiles become the blocks of an array of the blocked suite (its
+ *        parallel version if the chosen suite is parallel) whatever suite
+ *        was chosen, since that is how they are laid out; the chosen map
+ *        is swapped for the same map of that suite. The result is printed
+ *        to options->output and the container is unmapped.
+ * Inputs:
+ * A2Methods_T methods: The method suite chosen by the user
+ * struct tiledImage *tiled: the container, mapped by tiledOpen
+ * int rotation: The rotation type provided by the user
+ * A2Methods_mapfun *map: The mapping function chosen by the user, or NULL
+ * to use the tiled kernels
+ * struct operationOptions *options: the phases to time, thread pool, and
+ * output stream
  * Return: none
  * Expects
- * - methods, map, and image to be nonnull; throws CRE if any of them 
- * are null.
+ * - a map to be used only on containers of Pnm_rgb pixels; prints an
+ *   error and exits otherwise
 ************************/
-void rotate(A2Methods_T methods, Pnm_ppm image, A2Methods_mapfun *map, 
-            int newWidth, int newHeight, int rotationType, CPUTime_T timer, 
-            char *time_file_name, char *inputFile) 
+static void tiledOperation(A2Methods_T methods, struct tiledImage *tiled,
+                           int rotation, A2Methods_mapfun *map,
+                           struct operationOptions *options)
+{
+        A2Methods_T blocked = methods == uarray2_methods_plain_parallel ||
+                              methods == uarray2_methods_blocked_parallel ||
+                              methods == uarray2_methods_morton_parallel ?
+                              uarray2_methods_blocked_parallel :
+                              uarray2_methods_blocked;
+        if (map != NULL) {
+                if (tiled->size != sizeof(struct Pnm_rgb)) {
+                        fprintf(stderr, "%s holds compact pixels, which "
+                                "cannot be copied pixel by pixel\n",
+                                options->inputFile);
+                        exit(EXIT_FAILURE);
+                }
+                if (map == methods->map_row_major)
+                        map = blocked->map_row_major;
+                else if (map == methods->map_col_major)
+                        map = blocked->map_col_major;
+                else if (map == methods->map_block_major)
+                        map = blocked->map_block_major;
+                else
+                        map = blocked->map_default;
+        }
+
+        /* the mapped array is never kept as a spare one, since the mapping
+         * goes away below */
+        struct operationOptions local = *options;
+        local.spare = NULL;
+
+        struct Pnm_ppm image;
+        image.width = tiled->width;
+        image.height = tiled->height;
+        image.denominator = tiled->maxval;
+        image.pixels = tiledArray(tiled);
+        image.methods = blocked;
+        if (rotation != rotation0) {
+                bool sidesSwap = rotationSwapsSides(rotation);
+                rotate(blocked, &image, map,
+                       sidesSwap ? image.height : image.width,
+                       sidesSwap ? image.width : image.height, rotation,
+                       &local);
+        }
+        phaseSize(options->phases, image.width, image.height);
+
+        outputImage(&image, options);
+
+        double arrayBytes = (double)image.width * image.height * tiled->size;
+        phaseStart(options->phases);
+        blocked->free(&image.pixels);
+        tiledClose(tiled);
+        phaseStop(options->phases, phaseFree, arrayBytes);
+}
+
+/**********pixelSize********
+ * About: This function finds the element size of the array a mapped file is
+ *        rotated into. Compact pixels are only widened to 16 bit samples
+ *        when the maxval needs them, and then kept as the file's own 6
+ *        bytes.
+ * Inputs:
+ * const struct mappedImage *mapped: the file, mapped by mappedOpen
+ * int pixels: pixelsPacked, pixelsPadded, or pixelsWide
+ * Return: the element size in bytes
+************************/
+static int pixelSize(const struct mappedImage *mapped, int pixels)
+{
+        if (pixels == pixelsWide)
+                return sizeof(struct Pnm_rgb);
+        if (mapped->pixelBytes == pixelRgb16)
+                return pixelRgb16;
+        return pixels == pixelsPadded ? pixelRgbx8 : pixelRgb8;
+}
+
+/**********outputImage********
+ * About: This function prints an image to options->output, as a container
+ *        if options->tiledOutput is set and as a P6 ppm otherwise, timed as
+ *        the write phase
+ * Inputs:
+ * Pnm_ppm image: the image to print
+ * struct operationOptions *options: the output stream, format, and phases
+ * Return: none
+************************/
+static void outputImage(Pnm_ppm image, struct operationOptions *options)
+{
+        phaseStart(options->phases);
+        if (options->tiledOutput)
+                tiledWrite(options->output, image);
+        else
+                writeImage(options->output, image);
+        phaseStop(options->phases, phaseWrite,
+                  ppmBytes(image->width, image->height, image->denominator));
+}
+
+/**********operationName********
+ * About: This function writes the name of a rotation type as it is recorded
+ *        in the timing file
+ * Inputs:
+ * int rotationType: value keeping track of the type of rotation
+ * char operation[20]: where to write the name
+ * Return: none
+************************/
+static void operationName(int rotationType, char operation[20])
 {
-        assert(methods != NULL && map != NULL && image != NULL);
-
-        /* call timerStarter to start timer if user asked for it */
-        timerStarter(timer, time_file_name);
-    
-        /* initiate 2D array to hold rotated image info */
-        A2Methods_UArray2 rotated = methods->new(newWidth, newHeight, 
-                                                 methods->size(image->pixels));
-                
-        /* initiate rotateParameters to hold info needed for map function */
-        struct rotateParameters prm = {methods, rotated, rotationType};                                   
-        /* call map function with rotation apply function */
-        map(image->pixels, rotateApply, &prm);
-        
-        /* free the current pixels in image and update it to rotated version */
-        methods->free(&image->pixels);
-        image->pixels = rotated;
-        image->width = methods->width(rotated);
-        image->height = methods->height(rotated); 
-
-        /* record type of operation for timing information output */
-        char operation[20];  
         if (rotationType == rotation0 ||rotationType == rotation90 || 
             rotationType == rotation180 || rotationType == rotation270) 
                 sprintf(operation, "%d degree rotation", rotationType);
@@ -284,10 +741,143 @@ void rotate(A2Methods_T methods, Pnm_ppm image, A2Methods_mapfun *map,
                 strcpy(operation, "vertical flip");
         else if (rotationType == transpose)
                 strcpy(operation, "transpose");
-        
-        /* stop the timer if the user asked for time information */
-        timerStopper(timer, time_file_name, operation, newWidth * newHeight, 
-                     inputFile, newWidth, newHeight);
+        else if (rotationType == antiTranspose)
+                strcpy(operation, "anti-transpose");
+}
+
+/**********newArray********
+ * About: This function returns an array for an image of the given size. The
+ *        spare array of options is used if it has the same dimensions, or for
+ *        a plain array the same number of elements (it is then reshaped);
+ *        otherwise a new array is made.
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * int width, int height, int size: dimensions and element size of the array
+ * struct operationOptions *options: holds the spare array, if any
+ * Return: the array; its contents are not cleared
+************************/
+static A2Methods_UArray2 newArray(A2Methods_T methods, int width, int height,
+                                  int size, struct operationOptions *options)
+{
+        if (options->spare != NULL && *options->spare != NULL) {
+                A2Methods_UArray2 spare = *options->spare;
+                bool same = methods->width(spare) == width &&
+                            methods->height(spare) == height;
+                bool reshape = !same && 
+                               (methods == uarray2_methods_plain || 
+                                methods == uarray2_methods_plain_parallel) &&
+                               (long)methods->width(spare) * 
+                               methods->height(spare) == (long)width * height;
+                if (methods->size(spare) == size && (same || reshape)) {
+                        if (reshape)
+                                UArray2_reshape(spare, width, height);
+                        *options->spare = NULL;
+                        return spare;
+                }
+        }
+        return methods->new(width, height, size);
+}
+
+/**********freeArray********
+ * About: This function is done with an array. If options keeps a spare
+ *        array, the array becomes the spare one (the old spare array is
+ *        freed); otherwise the array is freed.
+ * Inputs:
+ * A2Methods_T methods: The method suite for A2Methods_UArray2
+ * A2Methods_UArray2 *array: the array; set to NULL
+ * struct operationOptions *options: holds the spare array, if any
+ * Return: none
+************************/
+static void freeArray(A2Methods_T methods, A2Methods_UArray2 *array,
+                      struct operationOptions *options)
+{
+        if (options->spare == NULL) {
+                methods->free(array);
+                return;
+        }
+        if (*options->spare != NULL)
+                methods->free(options->spare);
+        *options->spare = *array;
+        *array = NULL;
+}
+
+/**********poolStart********
+ * About: This function starts measuring a phase that the thread pool works
+ *        on. The hardware counters only count the thread that opens them,
+ *        so with counters every worker opens its own and starts measuring
+ *        too.
+ * Inputs:
+ * struct operationOptions *options: the phases and the thread pool
+ * Return: the phases of the workers, to give to poolStop; NULL if they are
+ *         not measured (no pool, no timing, or no counters)
+************************/
+static struct phaseTimes *poolStart(struct operationOptions *options)
+{
+        struct workerPhases pool = { options->timeLog, NULL, 0 };
+        if (options->pool != NULL && options->phases != NULL &&
+            options->phases->counterMask != 0) {
+                pool.workers = ALLOC(ThreadPool_size(options->pool) *
+                                     sizeof(struct phaseTimes));
+                ThreadPool_run(options->pool, workerStart, &pool);
+        }
+        phaseStart(options->phases);
+        return pool.workers;
+}
+
+/**********poolStop********
+ * About: This function adds the times since poolStart to the given phase,
+ *        like phaseStop, and the hardware counts of the workers if they were
+ *        measured. Only the counts are added: the clocks of the calling
+ *        thread already cover the workers' time.
+ * Inputs:
+ * struct operationOptions *options: the phases and the thread pool
+ * struct phaseTimes *workers: what poolStart returned; freed
+ * int phase: the phase, from phaseRead to phaseFree
+ * double bytes: bytes the phase handled
+ * Return: none
+************************/
+static void poolStop(struct operationOptions *options,
+                     struct phaseTimes *workers, int phase, double bytes)
+{
+        phaseStop(options->phases, phase, bytes);
+        if (workers == NULL)
+                return;
+
+        struct workerPhases pool = { options->timeLog, workers, phase };
+        ThreadPool_run(options->pool, workerStop, &pool);
+        for (int i = 0; i < ThreadPool_size(options->pool); i++)
+                phasesAddCounts(options->phases, &workers[i]);
+        FREE(workers);
+}
+
+/**********workerStart********
+ * About: This function is run by every worker for poolStart: it opens the
+ *        counters of the worker and starts measuring
+ * Inputs:
+ * int worker: index of the calling worker
+ * void *workerStruct: the struct workerPhases
+ * Return: none
+************************/
+static void workerStart(int worker, void *workerStruct)
+{
+        struct workerPhases *pool = workerStruct;
+        phasesInit(&pool->workers[worker], pool->log);
+        phaseStart(&pool->workers[worker]);
+}
+
+/**********workerStop********
+ * About: This function is run by every worker for poolStop: it stops
+ *        measuring the phase and closes the counters of the worker
+ * Inputs:
+ * int worker: index of the calling worker
+ * void *workerStruct: the struct workerPhases
+ * Return: none
+************************/
+static void workerStop(int worker, void *workerStruct)
+{
+        struct workerPhases *pool = workerStruct;
+        phaseStop(&pool->workers[worker], pool->phase, 0);
+        phasesFree(&pool->workers[worker]);
 }
 
 /**********rotateApply********
@@ -346,7 +936,75 @@ void rotateApply(int col, int row, A2Methods_UArray2 array, void *elem,
         else if (prm->rotationType == transpose) {
                 num_new = methods->at(rotated, row, col);
         }
+        else if (prm->rotationType == antiTranspose) {
+                num_new = methods->at(rotated, 
+                                      methods->height(array) - row - 1,
+                                      methods->width(array) - col - 1);
+        }
+        else {
+                /* 0 degree rotation copies the pixel to the same place */
+                num_new = methods->at(rotated, col, row);
+        }
 
         /* assign current value to new location */
         *num_new = *num;
 }
+
+/**********gatherApply********
+ * About: This function fills the element being visited of the new 2D array
+ * with the pixel of the source array that the rotation moves there, the
+ * opposite of rotateApply. Walking the new array this way makes its writes
+ * follow the map order and leaves the jumps to the reads of the source,
+ * which pays on machines where a missed write (which has to fetch the line
+ * before changing it) costs more than a missed read.
+ * Inputs:
+ * int col: column index of the element being filled in the new array
+ * int row: row index of the element being filled in the new array
+ * A2Methods_UArray2 array: the new array
+ * void *elem: the element being filled
+ * void *rotateStruct: holds a rotateParameters struct which stores the method
+ * suite for A2Methods_UArray2, the source array, and type of rotation
+ * Return: none
+ * Expects
+ * - array and rotateStruct to be nonnull; throws CRE if any of them are null.
+************************/
+void gatherApply(int col, int row, A2Methods_UArray2 array, void *elem, 
+                 void *rotateStruct) 
+{
+        assert(array != NULL && rotateStruct != NULL);
+        struct Pnm_rgb *num_new = elem;
+        struct rotateParameters *prm = rotateStruct;
+        A2Methods_T methods = prm->methods;
+        A2Methods_UArray2 source = prm->cl;
+        int width = methods->width(source);
+        int height = methods->height(source);
+        struct Pnm_rgb *num;
+
+        /* inverse of every case of rotateApply */
+        if (prm->rotationType == rotation90) {
+                num = methods->at(source, row, height - col - 1);
+        }
+        else if (prm->rotationType == rotation180) {
+                num = methods->at(source, width - col - 1, height - row - 1);
+        }
+        else if (prm->rotationType == rotation270) {
+                num = methods->at(source, width - row - 1, col);
+        }
+        else if (prm->rotationType == flipHorizontal) {
+                num = methods->at(source, width - col - 1, row);
+        }
+        else if (prm->rotationType == flipVertical) {
+                num = methods->at(source, col, height - row - 1);
+        }
+        else if (prm->rotationType == transpose) {
+                num = methods->at(source, row, col);
+        }
+        else if (prm->rotationType == antiTranspose) {
+                num = methods->at(source, width - row - 1, height - col - 1);
+        }
+        else {
+                num = methods->at(source, col, row);
+        }
+
+        *num_new = *num;
+}
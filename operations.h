@@ -15,26 +15,86 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdbool.h>
 #include "assert.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
 #include "pnm.h"
 #include "cputiming.h"
+#include "threadpool.h"
+#include "timing.h"
 
+/***********************
+ * rotation operation without an explicit degree were assigned an integer value
+ * for easier calculation and operation. rotation operations with an explicit
+ * degree were assigned to their angle values for easier operation
+************************/
+#define rotation0 0
+#define rotation90 90
+#define rotation180 180
+#define rotation270 270
+
+#define flipHorizontal 1
+#define flipVertical 2
+#define transpose 3
+
+/* the mirror image across the other diagonal (top right to bottom left);
+ * there is no option for it, but chains such as "-rotate 90 -flip vertical"
+ * come to it */
+#define antiTranspose 4
+
+/* how a mapping function copies the pixels: walking the source and
+ * scattering them, or walking the new array and gathering them */
+#define traversalScatter 0
+#define traversalGather 1
+
+/* what the pixels of a mapped P6 file are kept as once rotated: their own
+ * bytes (RGB8, or RGB16 when the maxval is over 255), RGB8 with a padding
+ * byte (RGBX8), or a Pnm_rgb each. Only RGBX8 and Pnm_rgb have micro-tile
+ * kernels (see microtile.h); RGB8 is copied pixel by pixel, but it writes
+ * a quarter fewer bytes than RGBX8, which wins where the copy waits on
+ * memory, so it is the default */
+#define pixelsPacked 0
+#define pixelsPadded 1
+#define pixelsWide 2
+
+/**********struct operationOptions********
+ * About: This struct holds the command line choices that change how the
+ *        operations are run and reported, but not the resulting image.
+************************/
+struct operationOptions {
+        TimeLog_T timeLog; /* where -time records go; NULL for no timing */
+        char *inputFile; /* name of the input file; NULL for stdin */
+        ThreadPool_T pool; /* workers for rotate(); NULL for one thread */
+        bool inPlace; /* rotate 90, 270, the transposes, and a mapped file
+                         without a second array */
+        bool stream; /* stream row-local operations on P6 input */
+        FILE *output; /* where the resulting image is written */
+        A2Methods_UArray2 *spare; /* an array kept between images for reuse;
+                                     NULL to free every array */
+        struct phaseTimes *phases; /* phases of the image being done; set
+                                      by operationHandler when timing */
+        int traversal; /* scatter or gather for mapping functions */
+        int pixels; /* packed, padded, or wide pixels for mapped files */
+        size_t memLimit; /* bytes of pixels the out-of-core mode may hold;
+                            0 to keep the image in memory */
+        bool tiledOutput; /* write a container (see tiled.h), not a P6 */
+        bool pipeline; /* read, transform, and write P6 input at once */
+};
+
+int composeRotation(int first, int second);
+bool rotationSwapsSides(int rotationType);
 void operationHandler(FILE *fp, A2Methods_T methods, int rotation, 
-                     A2Methods_mapfun *map, char *time_file_name, 
-                     char *inputFile);
-void timerStarter(CPUTime_T timer, char *time_file_name);
-void timerStopper(CPUTime_T timer, char *time_file_name, char *operation,
-                  int pixelNum, char *inputFile, int width, int height);
-void timePrinter(double time_used, int pixelNum, char *time_file_name, 
-                 char *operation, char *inputFile, int width, int height);
+                     A2Methods_mapfun *map, 
+                     struct operationOptions *options);
 void rotateApply(int col, int row, A2Methods_UArray2 array, void *elem, 
                  void *rotateStruct);
+void gatherApply(int col, int row, A2Methods_UArray2 array, void *elem, 
+                 void *rotateStruct);
 void rotate(A2Methods_T methods, Pnm_ppm image, A2Methods_mapfun *map, 
-            int newWidth, int newHeight, int angle, CPUTime_T timer, 
-            char *time_file_name, char *inputFile);
+            int newWidth, int newHeight, int angle, 
+            struct operationOptions *options);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,636 @@
+/*
+ *     pipeline.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the pipelined mode. The P6 header is read
+ *            by the calling thread, and the rows of pixels are handled as raw
+ *            bytes in bands of about bandBytes, like in stream.c. The three
+ *            stages are the workers of a thread pool of their own: worker 0
+ *            reads, worker 1 transforms, worker 2 writes. Band k always goes
+ *            through slot k % slotCount of a ring of band buffers, whose
+ *            state says which stage may use it next (empty: the reader, read:
+ *            the transformer, done: the writer), so every stage can run up
+ *            to slotCount - 1 bands ahead of the next one and waits when the
+ *            ring is full or empty. There are no other queues and no
+ *            allocation once the stages start.
+ *
+ *            For the operations that keep rows as rows, band k of the output
+ *            is band k of the input, or, for vertical flip and 180 degree
+ *            rotation, the band at the same distance from the bottom, read
+ *            with pread at its place in the file; the transformer reverses
+ *            its rows and pixels in the slot. For 90 and 270 degree rotations
+ *            and the transposes, every row of the result holds a pixel of every
+ *            input row, so the transformer scatters each input band into the
+ *            whole rotated image as it arrives (with the workers of
+ *            options->pool, if any, taking a share of the columns each), and
+ *            the writer prints the image once the last band is in.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <mem.h>
+#include <except.h>
+
+#include "assert.h"
+#include "pipeline.h"
+#include "stream.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "timing.h"
+#include "pnm.h"
+
+/* bytes of pixels in a band; bands in the ring */
+#define bandBytes (1 << 20)
+#define slotCount 4
+
+/* the stages, by worker index */
+#define stageRead 0
+#define stageTransform 1
+#define stageWrite 2
+#define stageCount 3
+
+/* states of a slot of the ring */
+#define slotEmpty 0
+#define slotRead 1
+#define slotDone 2
+
+/* bytes of two rows swapped at a time */
+#define swapBytes 4096
+
+/* columns scattered together, so the rows of the result they land in stay
+ * in the cache from one input row to the next */
+#define scatterColumns 64
+
+/**********struct pipeline********
+ * About: This struct holds the image being piped, how its bands are read
+ *        and transformed, and the ring of slots the stages share. start is
+ *        the file offset of the pixels when the bands are read from the
+ *        bottom up, and -1 when they are read in order from input. done
+ *        counts the bands the transformer is done with. failed is set when
+ *        the input ends early, and stops every stage.
+************************/
+struct pipeline {
+        int rotation;
+        unsigned width;
+        unsigned height;
+        unsigned newWidth;
+        int pixelBytes;
+        size_t rowBytes;
+        unsigned bandRows;
+        unsigned bands;
+        bool byRows; /* the result is made of the bands, one by one */
+        bool reverseRows;
+        bool reversePixels;
+        FILE *input;
+        off_t start;
+        FILE *output;
+        unsigned char *result; /* the rotated image when not byRows */
+        ThreadPool_T pool;
+        TimeLog_T log;
+        struct phaseTimes *phases;
+
+        unsigned char *slots[slotCount];
+        int state[slotCount];
+        unsigned done;
+        bool failed;
+        pthread_mutex_t lock;
+        pthread_cond_t changed;
+};
+
+/**********struct scatterJob********
+ * About: This struct holds a band being scattered into the result by the
+ *        workers of a pool
+************************/
+struct scatterJob {
+        struct pipeline *pipe;
+        const unsigned char *band;
+        unsigned firstRow;
+        unsigned rows;
+        int workers;
+};
+
+static void runStage(int worker, void *pipeStruct);
+static void readStage(struct pipeline *pipe, struct phaseTimes *phases);
+static void transformStage(struct pipeline *pipe,
+                           struct phaseTimes *phases);
+static void writeStage(struct pipeline *pipe, struct phaseTimes *phases);
+static bool waitFor(struct pipeline *pipe, int slot, int state);
+static void setState(struct pipeline *pipe, int slot, int state);
+static unsigned bandRowsOf(struct pipeline *pipe, unsigned band);
+static void reverseBand(struct pipeline *pipe, unsigned char *band,
+                        unsigned rows);
+static void reversePixels(unsigned char *pixels, size_t count, int px);
+static void scatterWorker(int worker, void *jobStruct);
+static void scatterBand(struct pipeline *pipe, const unsigned char *band,
+                        unsigned firstRow, unsigned rows, unsigned firstCol,
+                        unsigned lastCol);
+static double elapsedSince(const struct timespec *begin);
+
+/**********pipelineSupports********
+ * About: This function tells whether an operation can be pipelined on the
+ *        given input
+ * Inputs:
+ * FILE *fp: the input, not read yet
+ * int rotation: The rotation type provided by the user
+ * Return: true if the operation reads the input in order, or reads it from
+ *         the bottom up and the input can seek; false otherwise
+************************/
+bool pipelineSupports(FILE *fp, int rotation)
+{
+        assert(fp != NULL);
+        if (rotation != flipVertical && rotation != rotation180)
+                return true;
+        return ftello(fp) >= 0 && fseeko(fp, 0, SEEK_CUR) == 0;
+}
+
+/**********pipelineThreads********
+ * About: This function tells how many threads pipelineOperation runs for an
+ *        operation: the three stages, and the workers of options->pool for
+ *        the operations that scatter their bands into the whole result
+ * Inputs:
+ * int rotation: The rotation type provided by the user
+ * struct operationOptions *options: the thread pool, if any
+ * Return: the number of threads
+ * Expects
+ * - options to be nonnull; throws CRE otherwise
+************************/
+int pipelineThreads(int rotation, struct operationOptions *options)
+{
+        assert(options != NULL);
+        if (streamSupports(rotation) || options->pool == NULL)
+                return stageCount;
+        return stageCount + ThreadPool_size(options->pool);
+}
+
+/**********pipelineOperation********
+ * About: This function reads a P6 image from fp and prints the result of the
+ *        given operation to options->output, with the reading, transforming,
+ *        and writing of its bands running at the same time. If the user
+ *        asked for timing, every stage adds the time it was busy to its
+ *        phase, and the wall time of the whole image is recorded as its
+ *        total.
+ * Inputs:
+ * FILE *fp: Pointer to the ppm file provided by the user
+ * int rotation: The rotation type provided by the user
+ * struct operationOptions *options: the phases to time (NULL for none),
+ * thread pool for 90 and 270 degree rotations and the transposes, and output
+ * stream
+ * Return: none
+ * Expects
+ * - fp and options to be nonnull and the operation to be allowed by
+ *   pipelineSupports; throws CRE otherwise
+ * - the image to be a binary (P6) ppm; raises Pnm_Badformat otherwise
+************************/
+void pipelineOperation(FILE *fp, int rotation,
+                       struct operationOptions *options)
+{
+        assert(fp != NULL && options != NULL &&
+               pipelineSupports(fp, rotation));
+        struct phaseTimes *phases = options->phases;
+        struct timespec begin;
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+
+        struct pipeline pipe;
+        memset(&pipe, 0, sizeof(pipe));
+        unsigned maxval;
+        phaseStart(phases);
+        streamReadHeader(fp, &pipe.width, &pipe.height, &maxval);
+        phaseStop(phases, phaseRead, 0);
+
+        pipe.rotation = rotation;
+        pipe.byRows = streamSupports(rotation);
+        pipe.newWidth = pipe.byRows ? pipe.width : pipe.height;
+        unsigned newHeight = pipe.byRows ? pipe.height : pipe.width;
+        phaseSize(phases, pipe.newWidth, newHeight);
+        pipe.pixelBytes = maxval > 255 ? 6 : 3;
+        pipe.rowBytes = (size_t)pipe.width * pipe.pixelBytes;
+        pipe.bandRows = pipe.rowBytes == 0 || pipe.rowBytes > bandBytes ?
+                        1 : bandBytes / pipe.rowBytes;
+        pipe.bands = (pipe.height + pipe.bandRows - 1) / pipe.bandRows;
+        pipe.reverseRows = rotation == rotation180 ||
+                           rotation == flipVertical;
+        pipe.reversePixels = rotation == rotation180 ||
+                             rotation == flipHorizontal;
+        pipe.input = fp;
+        pipe.start = pipe.reverseRows ? ftello(fp) : -1;
+        pipe.output = options->output;
+        pipe.pool = options->pool;
+        pipe.log = options->timeLog;
+        pipe.phases = phases;
+        pthread_mutex_init(&pipe.lock, NULL);
+        pthread_cond_init(&pipe.changed, NULL);
+
+        size_t slotBytes = (size_t)pipe.bandRows * pipe.rowBytes;
+        size_t imageBytes = (size_t)pipe.height * pipe.rowBytes;
+        phaseStart(phases);
+        for (int s = 0; s < slotCount; s++)
+                pipe.slots[s] = ALLOC(slotBytes + 1);
+        if (!pipe.byRows)
+                pipe.result = ALLOC(imageBytes + 1);
+        phaseStop(phases, phaseAllocate, slotCount * slotBytes +
+                  (pipe.byRows ? 0 : imageBytes));
+
+        phaseStart(phases);
+        fprintf(pipe.output, "P6\n%u %u\n%u\n", pipe.newWidth, newHeight,
+                maxval);
+        phaseStop(phases, phaseWrite, 0);
+
+        ThreadPool_T stages = ThreadPool_new(stageCount);
+        ThreadPool_run(stages, runStage, &pipe);
+        ThreadPool_free(&stages);
+        fflush(pipe.output);
+
+        phaseStart(phases);
+        for (int s = 0; s < slotCount; s++)
+                FREE(pipe.slots[s]);
+        if (pipe.result != NULL)
+                FREE(pipe.result);
+        pthread_cond_destroy(&pipe.changed);
+        pthread_mutex_destroy(&pipe.lock);
+        phaseStop(phases, phaseFree, 0);
+
+        if (phases != NULL)
+                phases->elapsed = elapsedSince(&begin);
+        if (pipe.failed)
+                RAISE(Pnm_Badformat);
+}
+
+/**********runStage********
+ * About: This function runs the stage of a worker of the stage pool, timed
+ *        with phases of its own, which are added to the phases of the image
+ *        at the end
+ * Inputs:
+ * int worker: stageRead, stageTransform, or stageWrite
+ * void *pipeStruct: the struct pipeline
+ * Return: none
+************************/
+static void runStage(int worker, void *pipeStruct)
+{
+        struct pipeline *pipe = pipeStruct;
+
+        /* the counters follow the thread that opens them */
+        struct phaseTimes own;
+        struct phaseTimes *phases = NULL;
+        if (pipe->log != NULL) {
+                phasesInit(&own, pipe->log);
+                phases = &own;
+        }
+
+        if (worker == stageRead)
+                readStage(pipe, phases);
+        else if (worker == stageTransform)
+                transformStage(pipe, phases);
+        else
+                writeStage(pipe, phases);
+
+        if (phases != NULL) {
+                pthread_mutex_lock(&pipe->lock);
+                phasesAdd(pipe->phases, phases);
+                pthread_mutex_unlock(&pipe->lock);
+                phasesFree(phases);
+        }
+}
+
+/**********readStage********
+ * About: This function reads the input bands into the empty slots, in the
+ *        order the transformer takes them. If the input ends early, it marks
+ *        the pipeline failed and stops.
+ * Inputs:
+ * struct pipeline *pipe: the pipeline
+ * struct phaseTimes *phases: where to time the reads; NULL for none
+ * Return: none
+************************/
+static void readStage(struct pipeline *pipe, struct phaseTimes *phases)
+{
+        int fd = fileno(pipe->input);
+        for (unsigned k = 0; k < pipe->bands; k++) {
+                int slot = k % slotCount;
+                if (!waitFor(pipe, slot, slotEmpty))
+                        return;
+                unsigned rows = bandRowsOf(pipe, k);
+                size_t bytes = rows * pipe->rowBytes;
+
+                phaseStart(phases);
+                bool whole;
+                if (pipe->start >= 0) {
+                        /* band k of the output is band k from the bottom */
+                        unsigned firstRow = pipe->height - k * pipe->bandRows -
+                                            rows;
+                        off_t at = pipe->start +
+                                   (off_t)firstRow * pipe->rowBytes;
+                        size_t got = 0;
+                        ssize_t n = 1;
+                        while (got < bytes && n > 0) {
+                                n = pread(fd, pipe->slots[slot] + got,
+                                          bytes - got, at + got);
+                                got += n > 0 ? n : 0;
+                        }
+                        whole = got == bytes;
+                } else {
+                        whole = fread(pipe->slots[slot], 1, bytes,
+                                      pipe->input) == bytes;
+                }
+                phaseStop(phases, phaseRead, bytes);
+
+                if (!whole) {
+                        pthread_mutex_lock(&pipe->lock);
+                        pipe->failed = true;
+                        pthread_cond_broadcast(&pipe->changed);
+                        pthread_mutex_unlock(&pipe->lock);
+                        return;
+                }
+                setState(pipe, slot, slotRead);
+        }
+}
+
+/**********transformStage********
+ * About: This function transforms the bands that were read: in their slot
+ *        for operations that keep rows as rows, which then go to the writer,
+ *        or into the result for the others, whose slots are then empty again
+ * Inputs:
+ * struct pipeline *pipe: the pipeline
+ * struct phaseTimes *phases: where to time the transforms; NULL for none
+ * Return: none
+************************/
+static void transformStage(struct pipeline *pipe, struct phaseTimes *phases)
+{
+        for (unsigned k = 0; k < pipe->bands; k++) {
+                int slot = k % slotCount;
+                if (!waitFor(pipe, slot, slotRead))
+                        return;
+                unsigned rows = bandRowsOf(pipe, k);
+
+                phaseStart(phases);
+                if (pipe->byRows) {
+                        reverseBand(pipe, pipe->slots[slot], rows);
+                } else if (pipe->pool != NULL) {
+                        struct scatterJob job = { pipe, pipe->slots[slot],
+                                                  k * pipe->bandRows, rows,
+                                                  ThreadPool_size(pipe->pool)
+                                                };
+                        ThreadPool_run(pipe->pool, scatterWorker, &job);
+                } else {
+                        scatterBand(pipe, pipe->slots[slot],
+                                    k * pipe->bandRows, rows, 0,
+                                    pipe->width);
+                }
+                phaseStop(phases, phaseTransform, rows * pipe->rowBytes);
+
+                pthread_mutex_lock(&pipe->lock);
+                pipe->done++;
+                pthread_mutex_unlock(&pipe->lock);
+                setState(pipe, slot, pipe->byRows ? slotDone : slotEmpty);
+        }
+}
+
+/**********writeStage********
+ * About: This function prints the transformed bands in order, emptying
+ *        their slots, or the whole result once every band is scattered into
+ *        it. Like Pnm_ppmwrite, it goes on quietly if the output cannot be
+ *        written.
+ * Inputs:
+ * struct pipeline *pipe: the pipeline
+ * struct phaseTimes *phases: where to time the writes; NULL for none
+ * Return: none
+************************/
+static void writeStage(struct pipeline *pipe, struct phaseTimes *phases)
+{
+        if (!pipe->byRows) {
+                pthread_mutex_lock(&pipe->lock);
+                while (pipe->done < pipe->bands && !pipe->failed)
+                        pthread_cond_wait(&pipe->changed, &pipe->lock);
+                bool failed = pipe->failed;
+                pthread_mutex_unlock(&pipe->lock);
+                if (failed)
+                        return;
+                size_t bytes = (size_t)pipe->height * pipe->rowBytes;
+                phaseStart(phases);
+                fwrite(pipe->result, 1, bytes, pipe->output);
+                phaseStop(phases, phaseWrite, bytes);
+                return;
+        }
+
+        for (unsigned k = 0; k < pipe->bands; k++) {
+                int slot = k % slotCount;
+                if (!waitFor(pipe, slot, slotDone))
+                        return;
+                size_t bytes = bandRowsOf(pipe, k) * pipe->rowBytes;
+                phaseStart(phases);
+                fwrite(pipe->slots[slot], 1, bytes, pipe->output);
+                phaseStop(phases, phaseWrite, bytes);
+                setState(pipe, slot, slotEmpty);
+        }
+}
+
+/**********waitFor********
+ * About: This function waits until a slot is in the given state
+ * Inputs:
+ * struct pipeline *pipe: the pipeline
+ * int slot: the slot
+ * int state: slotEmpty, slotRead, or slotDone
+ * Return: true once the slot is in the state; false if the pipeline failed
+************************/
+static bool waitFor(struct pipeline *pipe, int slot, int state)
+{
+        pthread_mutex_lock(&pipe->lock);
+        while (pipe->state[slot] != state && !pipe->failed)
+                pthread_cond_wait(&pipe->changed, &pipe->lock);
+        bool ready = !pipe->failed;
+        pthread_mutex_unlock(&pipe->lock);
+        return ready;
+}
+
+/**********setState********
+ * About: This function hands a slot to the next stage
+ * Inputs:
+ * struct pipeline *pipe: the pipeline
+ * int slot: the slot
+ * int state: slotEmpty, slotRead, or slotDone
+ * Return: none
+************************/
+static void setState(struct pipeline *pipe, int slot, int state)
+{
+        pthread_mutex_lock(&pipe->lock);
+        pipe->state[slot] = state;
+        pthread_cond_broadcast(&pipe->changed);
+        pthread_mutex_unlock(&pipe->lock);
+}
+
+/**********bandRowsOf********
+ * About: This function returns the number of rows of a band; the last band
+ *        may be shorter than the others
+ * Inputs:
+ * struct pipeline *pipe: the pipeline
+ * unsigned band: the band
+ * Return: the number of rows
+************************/
+static unsigned bandRowsOf(struct pipeline *pipe, unsigned band)
+{
+        unsigned left = pipe->height - band * pipe->bandRows;
+        return left < pipe->bandRows ? left : pipe->bandRows;
+}
+
+/**********reverseBand********
+ * About: This function reverses the order of the rows of a band, and the
+ *        order of the pixels of every row, as the operation needs. Doing
+ *        both is reversing the pixels of the whole band at once.
+ * Inputs:
+ * struct pipeline *pipe: the pipeline
+ * unsigned char *band: the rows of the band, one after another
+ * unsigned rows: the number of rows
+ * Return: none
+************************/
+static void reverseBand(struct pipeline *pipe, unsigned char *band,
+                        unsigned rows)
+{
+        size_t rowBytes = pipe->rowBytes;
+        int px = pipe->pixelBytes;
+        if (pipe->reverseRows && pipe->reversePixels) {
+                reversePixels(band, (size_t)rows * pipe->width, px);
+        } else if (pipe->reverseRows) {
+                unsigned char saved[swapBytes];
+                for (unsigned top = 0, bottom = rows - 1; top < bottom;
+                     top++, bottom--) {
+                        unsigned char *a = band + top * rowBytes;
+                        unsigned char *b = band + bottom * rowBytes;
+                        for (size_t i = 0; i < rowBytes; i += swapBytes) {
+                                size_t n = rowBytes - i < swapBytes ?
+                                           rowBytes - i : swapBytes;
+                                memcpy(saved, a + i, n);
+                                memcpy(a + i, b + i, n);
+                                memcpy(b + i, saved, n);
+                        }
+                }
+        } else if (pipe->reversePixels) {
+                for (unsigned r = 0; r < rows; r++)
+                        reversePixels(band + r * rowBytes, pipe->width, px);
+        }
+}
+
+/**********reversePixels********
+ * About: This function reverses the order of some pixels, keeping the bytes
+ *        of each pixel in order
+ * Inputs:
+ * unsigned char *pixels: the first pixel
+ * size_t count: the number of pixels
+ * int px: bytes of a pixel, 3 or 6
+ * Return: none
+************************/
+static void reversePixels(unsigned char *pixels, size_t count, int px)
+{
+        if (count < 2)
+                return;
+        unsigned char *left = pixels;
+        unsigned char *right = pixels + (count - 1) * px;
+        unsigned char saved[6];
+        if (px == 3) {
+                for (; left < right; left += 3, right -= 3) {
+                        memcpy(saved, left, 3);
+                        memcpy(left, right, 3);
+                        memcpy(right, saved, 3);
+                }
+        } else {
+                for (; left < right; left += 6, right -= 6) {
+                        memcpy(saved, left, 6);
+                        memcpy(left, right, 6);
+                        memcpy(right, saved, 6);
+                }
+        }
+}
+
+/**********scatterWorker********
+ * About: This function scatters the share of the columns of a band that
+ *        belongs to a worker of options->pool
+ * Inputs:
+ * int worker: index of the worker
+ * void *jobStruct: the struct scatterJob
+ * Return: none
+************************/
+static void scatterWorker(int worker, void *jobStruct)
+{
+        struct scatterJob *job = jobStruct;
+        unsigned width = job->pipe->width;
+        unsigned firstCol = (unsigned long)width * worker / job->workers;
+        unsigned lastCol = (unsigned long)width * (worker + 1) / job->workers;
+        scatterBand(job->pipe, job->band, job->firstRow, job->rows, firstCol,
+                    lastCol);
+}
+
+/**********scatterBand********
+ * About: This function copies some columns of a band of input rows to their
+ *        rotated places in the result. Moving one column to the right or
+ *        one row down moves the rotated place by a fixed number of pixels,
+ *        so the places are found by adding, not by mapping every pixel.
+ * Inputs:
+ * struct pipeline *pipe: the pipeline
+ * const unsigned char *band: the input rows of the band, one after another
+ * unsigned firstRow: the input row of the first row of the band
+ * unsigned rows: the number of rows in the band
+ * unsigned firstCol, unsigned lastCol: the columns to copy, lastCol not
+ * included
+ * Return: none
+************************/
+static void scatterBand(struct pipeline *pipe, const unsigned char *band,
+                        unsigned firstRow, unsigned rows, unsigned firstCol,
+                        unsigned lastCol)
+{
+        int px = pipe->pixelBytes;
+        int col0, row0, col1, row1, col2, row2;
+        kernelMapPoint(pipe->rotation, pipe->width, pipe->height, 0,
+                       firstRow, &col0, &row0);
+        kernelMapPoint(pipe->rotation, pipe->width, pipe->height, 1,
+                       firstRow, &col1, &row1);
+        kernelMapPoint(pipe->rotation, pipe->width, pipe->height, 0,
+                       firstRow + 1, &col2, &row2);
+        long base = (long)row0 * pipe->newWidth + col0;
+        long colStep = (long)row1 * pipe->newWidth + col1 - base;
+        long rowStep = (long)row2 * pipe->newWidth + col2 - base;
+
+        for (unsigned c0 = firstCol; c0 < lastCol; c0 += scatterColumns) {
+                unsigned c1 = c0 + scatterColumns < lastCol ?
+                              c0 + scatterColumns : lastCol;
+                for (unsigned r = 0; r < rows; r++) {
+                        const unsigned char *from = band +
+                                                    r * pipe->rowBytes +
+                                                    (size_t)c0 * px;
+                        long at = base + r * rowStep + c0 * colStep;
+                        if (px == 3) {
+                                for (unsigned c = c0; c < c1; c++) {
+                                        memcpy(pipe->result + at * 3, from,
+                                               3);
+                                        from += 3;
+                                        at += colStep;
+                                }
+                        } else {
+                                for (unsigned c = c0; c < c1; c++) {
+                                        memcpy(pipe->result + at * 6, from,
+                                               6);
+                                        from += 6;
+                                        at += colStep;
+                                }
+                        }
+                }
+        }
+}
+
+/**********elapsedSince********
+ * About: This function returns the wall time since a moment
+ * Inputs:
+ * const struct timespec *begin: the moment, from CLOCK_MONOTONIC
+ * Return: the time in nanoseconds
+************************/
+static double elapsedSince(const struct timespec *begin)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (now.tv_sec - begin->tv_sec) * 1e9 +
+               (now.tv_nsec - begin->tv_nsec);
+}
@@ -0,0 +1,29 @@
+/*
+ *     pipeline.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the pipelined mode. A binary (P6) image is read,
+ *            transformed, and written by three threads at once, handing
+ *            bands of rows to each other, so the disk does not wait for the
+ *            CPU or the CPU for the disk: the time of an image comes close
+ *            to the longest of the three stages instead of their sum.
+ *            Operations that keep rows as rows (0 and 180 degree rotations,
+ *            the flips) overlap all three stages; 90 and 270 degree rotations
+ *            and transpose overlap reading with transforming, since no row of
+ *            their result is done before the last row is read.
+ */
+
+#ifndef PIPELINE_INCLUDED
+#define PIPELINE_INCLUDED
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "operations.h"
+
+extern bool pipelineSupports(FILE *fp, int rotation);
+extern int pipelineThreads(int rotation, struct operationOptions *options);
+extern void pipelineOperation(FILE *fp, int rotation,
+                              struct operationOptions *options);
+
+#endif
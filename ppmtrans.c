@@ -8,9 +8,12 @@
  *     performs a 0, 90, 180, 270 degree rotation, horizontal/vertical flip, or
  *     transpose depending on what the user asks for (or defaults to 0 degree)
  *     rotation. The program prints the resulting image to the standard output
- *     in binary ppm format. If the user desires, they can also time the 
- *     rotation operation with "-time" command followed by the name of the file
- *     to output the timing information.
+ *     in binary ppm format. Several operations are combined into one first,
+ *     so the image is only rotated once. The other options, listed by
+ *     usage(), pick how the image is held, copied, read, and written; the
+ *     modes behind them are described in their own modules (stream.h,
+ *     pipeline.h, external.h, tiled.h, batch.h, timing.h, slab.h, numa.h,
+ *     uring.h, cacheblock.h).
  *              
  */
 
@@ -19,21 +22,25 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
 
 #include "assert.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2morton.h"
 #include "pnm.h"
 #include "operations.h"
-
-/******************
- * rotation operation without an explicit degree were assigned an integer value
- * for easier calculation and operation
- ************************/
-#define flipHorizontal 1
-#define flipVertical 2
-#define transpose 3
+#include "threadpool.h"
+#include "a2parallel.h"
+#include "batch.h"
+#include "timing.h"
+#include "cacheblock.h"
+#include "kernels.h"
+#include "slab.h"
+#include "numa.h"
+#include "uring.h"
 
 #define SET_METHODS(METHODS, MAP, WHAT) do {                    \
         methods = (METHODS);                                    \
@@ -51,11 +58,150 @@ static void
 usage(const char *progname)
 {
         fprintf(stderr, "Usage: %s [-rotate <angle>] "
-                        "[-{row,col,block}-major] [filename]\n",
-                        progname);
+                        "[-flip {horizontal,vertical}] [-transpose] "
+                        "[-{row,col,block,morton}-major] "
+                        "[-per-pixel [-gather]] "
+                        "[-threads <n>] [-in-place] [-stream] [-pipeline] "
+                        "[-pixels {rgb8,rgbx8,pnm}] "
+                        "[-pages {small,thp,hugetlb}] "
+                        "[-numa {off,interleave,first-touch}] "
+                        "[-io {stdio,uring}] [-io-depth <n>] "
+                        "[-mem-limit <size>[K|M|G]] [-tiled] "
+                        "[-time <file> [-counters]] "
+                        "[filename | -batch <list> [-out-dir <dir>]]\n"
+                        "       %s -calibrate\n"
+                        "  -rotate, -flip, -transpose\n"
+                        "                      done in the given order, "
+                        "combined into one\n"
+                        "  -{row,col,block,morton}-major\n"
+                        "                      how the image is held and "
+                        "walked\n"
+                        "  -per-pixel          copy with the map, not the "
+                        "tiled kernels\n"
+                        "  -gather             with -per-pixel, walk the "
+                        "new image and fetch\n"
+                        "  -threads <n>        copy on n threads; with "
+                        "-batch, n images at once\n"
+                        "  -in-place           90, 270, and transpose "
+                        "(180 and flips of a P6\n"
+                        "                      file too) without a second "
+                        "image\n"
+                        "  -stream             0, 180, and flips of a P6 "
+                        "image row by row\n"
+                        "  -pipeline           read, transform, and write "
+                        "a P6 image on 3 threads\n"
+                        "  -pixels <format>    P6 pixels: rgb8 (the file's "
+                        "own, the default),\n"
+                        "                      rgbx8 (padded to 4 bytes), "
+                        "or pnm (a Pnm_rgb);\n"
+                        "                      P3 input, -per-pixel, and "
+                        "-morton-major use pnm\n"
+                        "  -pages <mode>       huge pages for large images "
+                        "(default UARRAY2_PAGES)\n"
+                        "  -numa <mode>        page and worker placement "
+                        "(default UARRAY2_NUMA)\n"
+                        "  -io <backend>       read and write files with "
+                        "io_uring (default UARRAY2_IO)\n"
+                        "  -io-depth <n>       1 MB chunks in flight with "
+                        "-io uring (default 8)\n"
+                        "  -mem-limit <size>   rotate a P6 image out of "
+                        "core in that much memory\n"
+                        "  -tiled              write a tiled container; "
+                        "one named as input is mapped\n"
+                        "  -time <file>        append the phase times (CSV "
+                        "if the name ends in .csv)\n"
+                        "  -counters           add the hardware counters "
+                        "per pixel to -time\n"
+                        "  -batch <list>       a manifest or directory of "
+                        "images, outputs in -out-dir\n"
+                        "  -calibrate          time block sizes on this "
+                        "machine, save and print them\n",
+                        progname, progname);
         exit(1);
 }
 
+/**********parseBytes********
+ * About: This function reads a size in bytes, with an optional K, M, or G
+ *        suffix for kibibytes, mebibytes, or gibibytes
+ * Inputs:
+ * const char *text: the size, such as "2G"
+ * Return: the number of bytes; 0 if text is not a size
+ ************************/
+static size_t parseBytes(const char *text)
+{
+        if (!isdigit((unsigned char)*text))
+                return 0;
+        char *end;
+        unsigned long long number = strtoull(text, &end, 10);
+        int shift = 0;
+        if (*end == 'K' || *end == 'k')
+                shift = 10;
+        else if (*end == 'M' || *end == 'm')
+                shift = 20;
+        else if (*end == 'G' || *end == 'g')
+                shift = 30;
+        if (shift > 0)
+                end++;
+        if (*end != '\0' || number > (SIZE_MAX >> shift))
+                return 0;
+        return (size_t)number << shift;
+}
+
+/**********parallelMethods********
+ * About: This function replaces the plain, blocked, or Morton suite with its
+ *        parallel version, and the chosen map with the same map of that
+ *        version
+ * Inputs:
+ * A2Methods_T *methods: address of the chosen method suite
+ * A2Methods_mapfun **map: address of the chosen map function (may hold NULL)
+ * Return: none
+ ************************/
+static void parallelMethods(A2Methods_T *methods, A2Methods_mapfun **map)
+{
+        A2Methods_T parallel = uarray2_methods_plain_parallel;
+        if (*methods == uarray2_methods_blocked) {
+                parallel = uarray2_methods_blocked_parallel;
+        } else if (*methods == uarray2_methods_morton) {
+                parallel = uarray2_methods_morton_parallel;
+        }
+
+        if (*map == NULL) {
+                /* nothing to swap; the kernels are used */
+        } else if (*map == (*methods)->map_row_major) {
+                *map = parallel->map_row_major;
+        } else if (*map == (*methods)->map_col_major) {
+                *map = parallel->map_col_major;
+        } else if (*map == (*methods)->map_block_major) {
+                *map = parallel->map_block_major;
+        } else {
+                *map = parallel->map_default;
+        }
+        *methods = parallel;
+}
+
+/**********calibrate********
+ * About: This function calibrates the block size of every element size a
+ *        blocked array of ppmtrans can hold (the compact pixel formats of a
+ *        mapped P6 file, and Pnm_rgb), since each size has its own
+ *        calibration, and prints them
+ * Inputs: none
+ * Return: none
+ ************************/
+static void calibrate(void)
+{
+        static const struct {
+                const char *name;
+                int size;
+        } formats[] = { { "rgb8", pixelRgb8 }, { "rgbx8", pixelRgbx8 },
+                        { "rgb16", pixelRgb16 },
+                        { "pnm", sizeof(struct Pnm_rgb) } };
+
+        for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+                printf("block size %d for %s pixels\n",
+                       cacheCalibrate(formats[i].size, kernelTimeBlocks),
+                       formats[i].name);
+}
+
 /**********main********
  * About: Expects command line argument for rotation, method for copying image
  * pixels, timing operations, and/or either an input file name or input from 
@@ -70,6 +216,18 @@ int main(int argc, char *argv[])
 {
         char *time_file_name = NULL;
         int   rotation       = 0;
+        bool  perPixel       = false;
+        int   traversal      = traversalScatter;
+        int   pixels         = pixelsPacked;
+        size_t memLimit      = 0;
+        bool  tiledOutput    = false;
+        int   threads        = 1;
+        bool  inPlace        = false;
+        bool  stream         = false;
+        bool  pipeline       = false;
+        bool  counters       = false;
+        char *batchList      = NULL;
+        char *outDir         = NULL;
         int   i;
         FILE *fp = NULL; 
 
@@ -94,14 +252,18 @@ int main(int argc, char *argv[])
                 } else if (strcmp(argv[i], "-block-major") == 0) {
                         SET_METHODS(uarray2_methods_blocked, map_block_major,
                                     "block-major");
+                } else if (strcmp(argv[i], "-morton-major") == 0) {
+                        /* Z-order storage, walked in storage order */
+                        SET_METHODS(uarray2_methods_morton, map_default,
+                                    "morton-major");
                 } else if (strcmp(argv[i], "-rotate") == 0) {
                         if (!(i + 1 < argc)) {      /* no rotate value */
                                 usage(argv[0]);
                         }
                         char *endptr;
-                        rotation = strtol(argv[++i], &endptr, 10);
-                        if (!(rotation == 0 || rotation == 90 ||
-                            rotation == 180 || rotation == 270)) {
+                        int angle = strtol(argv[++i], &endptr, 10);
+                        if (!(angle == 0 || angle == 90 ||
+                            angle == 180 || angle == 270)) {
                                 fprintf(stderr, 
                                         "Rotation must be 0, 90 180 or 270\n");
                                 usage(argv[0]);
@@ -109,6 +271,7 @@ int main(int argc, char *argv[])
                         if (!(*endptr == '\0')) {    /* Not a number */
                                 usage(argv[0]);
                         }
+                        rotation = composeRotation(rotation, angle);
                 } else if (strcmp(argv[i], "-flip") == 0) { 
                         char *flip = argv[++i]; /* check for flip type */
                         if (strcmp(flip, "horizontal") != 0 &&
@@ -116,16 +279,136 @@ int main(int argc, char *argv[])
                                 fprintf(stderr, 
                                       "Flip must be horizontal or vertical\n");
                                 usage(argv[0]);
-                        } /* assign flip type to rotation */
+                        } /* add flip type to rotation */
                         if (strcmp(flip, "horizontal") == 0)
-                                rotation = flipHorizontal;
+                                rotation = composeRotation(rotation, 
+                                                           flipHorizontal);
                         else
-                                rotation = flipVertical;
+                                rotation = composeRotation(rotation, 
+                                                           flipVertical);
                 } else if (strcmp(argv[i], "-transpose") == 0) {
-                        /* assign transpose command to rotation */
-                        rotation = transpose; 
+                        /* add transpose command to rotation */
+                        rotation = composeRotation(rotation, transpose); 
+                } else if (strcmp(argv[i], "-per-pixel") == 0) {
+                        /* copy with map and rotateApply, not the kernels */
+                        perPixel = true;
+                } else if (strcmp(argv[i], "-gather") == 0) {
+                        /* the map walks the new image and fetches pixels */
+                        traversal = traversalGather;
+                } else if (strcmp(argv[i], "-threads") == 0) {
+                        if (!(i + 1 < argc)) {      /* no thread count */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        threads = strtol(argv[++i], &endptr, 10);
+                        if (!(*endptr == '\0') || threads < 1) {
+                                fprintf(stderr, 
+                                        "Threads must be a positive number\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-in-place") == 0) {
+                        /* rotate 90/270/transposes, and 180/flips of a
+                         * mapped file, without a second image */
+                        inPlace = true;
+                } else if (strcmp(argv[i], "-stream") == 0) {
+                        /* 0, 180, flips: row by row, without the image */
+                        stream = true;
+                } else if (strcmp(argv[i], "-pipeline") == 0) {
+                        /* read, transform, and write on three threads */
+                        pipeline = true;
+                } else if (strcmp(argv[i], "-pixels") == 0) {
+                        if (!(i + 1 < argc)) {      /* no pixel format */
+                                usage(argv[0]);
+                        }
+                        char *format = argv[++i];
+                        if (strcmp(format, "rgb8") == 0) {
+                                pixels = pixelsPacked;
+                        } else if (strcmp(format, "rgbx8") == 0) {
+                                pixels = pixelsPadded;
+                        } else if (strcmp(format, "pnm") == 0) {
+                                pixels = pixelsWide;
+                        } else {
+                                fprintf(stderr, 
+                                   "Pixels must be rgb8, rgbx8, or pnm\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-pages") == 0) {
+                        if (!(i + 1 < argc)) {      /* no page mode */
+                                usage(argv[0]);
+                        }
+                        int pages = slabParseMode(argv[++i]);
+                        if (pages < 0) {
+                                fprintf(stderr, 
+                                   "Pages must be small, thp, or hugetlb\n");
+                                usage(argv[0]);
+                        }
+                        slabSetMode(pages);
+                } else if (strcmp(argv[i], "-numa") == 0) {
+                        if (!(i + 1 < argc)) {      /* no NUMA mode */
+                                usage(argv[0]);
+                        }
+                        int numa = numaParseMode(argv[++i]);
+                        if (numa < 0) {
+                                fprintf(stderr, "NUMA mode must be off, "
+                                        "interleave, or first-touch\n");
+                                usage(argv[0]);
+                        }
+                        numaSetMode(numa);
+                } else if (strcmp(argv[i], "-io") == 0) {
+                        if (!(i + 1 < argc)) {      /* no backend */
+                                usage(argv[0]);
+                        }
+                        int io = uringParseMode(argv[++i]);
+                        if (io < 0) {
+                                fprintf(stderr, 
+                                        "I/O must be stdio or uring\n");
+                                usage(argv[0]);
+                        }
+                        uringSetMode(io);
+                } else if (strcmp(argv[i], "-io-depth") == 0) {
+                        if (!(i + 1 < argc)) {      /* no depth */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        int depth = strtol(argv[++i], &endptr, 10);
+                        if (!(*endptr == '\0') || depth < 1 || depth > 64) {
+                                fprintf(stderr, 
+                                      "I/O depth must be from 1 to 64\n");
+                                usage(argv[0]);
+                        }
+                        uringSetDepth(depth);
+                } else if (strcmp(argv[i], "-mem-limit") == 0) {
+                        if (!(i + 1 < argc)) {      /* no size */
+                                usage(argv[0]);
+                        }
+                        memLimit = parseBytes(argv[++i]);
+                        if (memLimit == 0) {
+                                fprintf(stderr, "Memory limit must be a "
+                                        "positive size, such as 512M\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-tiled") == 0) {
+                        /* write a container instead of a P6 file */
+                        tiledOutput = true;
+                } else if (strcmp(argv[i], "-batch") == 0) {
+                        if (!(i + 1 < argc)) {      /* no manifest */
+                                usage(argv[0]);
+                        }
+                        batchList = argv[++i];
+                } else if (strcmp(argv[i], "-out-dir") == 0) {
+                        if (!(i + 1 < argc)) {      /* no directory */
+                                usage(argv[0]);
+                        }
+                        outDir = argv[++i];
                 } else if (strcmp(argv[i], "-time") == 0) {
                         time_file_name = argv[++i];
+                } else if (strcmp(argv[i], "-calibrate") == 0) {
+                        /* measure the block sizes for this machine */
+                        calibrate();
+                        return EXIT_SUCCESS;
+                } else if (strcmp(argv[i], "-counters") == 0) {
+                        /* hardware counters in the -time records */
+                        counters = true;
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n", argv[0],
                                 argv[i]);
@@ -146,17 +429,86 @@ int main(int argc, char *argv[])
                 }
         }
 
+        if (batchList != NULL && fp != NULL) {
+                fprintf(stderr, "-batch does not take an input file\n");
+                usage(argv[0]);
+        }
+
+        if (traversal == traversalGather && !perPixel) {
+                fprintf(stderr, "-gather needs -per-pixel\n");
+                usage(argv[0]);
+        }
+
+        if (counters && time_file_name == NULL) {
+                fprintf(stderr, "-counters needs -time\n");
+                usage(argv[0]);
+        }
+
+        if (tiledOutput && memLimit > 0) {
+                fprintf(stderr, "-tiled cannot be used with -mem-limit\n");
+                usage(argv[0]);
+        }
+
         /* if no input file is provided, expect input from stdin */
         if (fp == NULL) {
                 fp = stdin;
         }
 
-        /* call operation handler with the given rotation type */
-        operationHandler(fp, methods, rotation, map, time_file_name, 
-                         inputFile);
+        /* the chosen map only drives the copy with -per-pixel; otherwise the
+         * tiled kernels copy the pixels and the map just picks the storage */
+        if (!perPixel) {
+                map = NULL;
+        }
+
+        /* the timing log stays open for the whole run */
+        TimeLog_T timeLog = NULL;
+        if (time_file_name != NULL) {
+                timeLog = TimeLog_new(time_file_name, counters);
+                if (timeLog == NULL) {
+                        fprintf(stderr, "Timing file cannot be opened for "
+                                        "writing, or is a CSV file with "
+                                        "other columns\n");
+                        return EXIT_FAILURE;
+                }
+        }
+
+        struct operationOptions options = { timeLog, inputFile, NULL,
+                                            inPlace, stream, stdout, NULL,
+                                            NULL, traversal, pixels,
+                                            memLimit, tiledOutput, pipeline };
+
+        /* one thread works alone; more share the tiles through a pool, and
+         * -per-pixel maps switch to the parallel suites on the same pool */
+        if (threads > 1) {
+                options.pool = ThreadPool_new(threads);
+                /* a batch gives whole images to the workers, so the suites
+                 * and kernels inside an image stay sequential */
+                if (batchList == NULL) {
+                        A2Parallel_setPool(options.pool);
+                        parallelMethods(&methods, &map);
+                }
+        }
+
+        int status = EXIT_SUCCESS;
+        if (batchList != NULL) {
+                if (batchRun(batchList, outDir, methods, rotation, map,
+                             &options) > 0) {
+                        status = EXIT_FAILURE;
+                }
+        } else {
+                /* call operation handler with the given rotation type */
+                operationHandler(fp, methods, rotation, map, &options);
+        }
 
+        if (options.pool != NULL) {
+                A2Parallel_setPool(NULL);
+                ThreadPool_free(&options.pool);
+        }
+        if (timeLog != NULL) {
+                TimeLog_free(&timeLog);
+        }
         fclose(fp);
-        return EXIT_SUCCESS;
+        return status;
 }
 
 
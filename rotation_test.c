@@ -0,0 +1,112 @@
+/*
+ *     rotation_test.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file is the table test of composeRotation run by "make
+ *            check". For every two rotation types in a row, the single type
+ *            composeRotation returns has to move every pixel of a
+ *            non-square image to where the two moves put it, and swap the
+ *            sides of the image exactly when the two together do. It prints
+ *            every pair that does not, and exits with a failure if there is
+ *            one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "operations.h"
+#include "kernels.h"
+
+#define testWidth 5
+#define testHeight 3
+
+static const int rotations[] = { rotation0, rotation90, rotation180,
+                                 rotation270, flipHorizontal, flipVertical,
+                                 transpose, antiTranspose };
+
+#define rotationCount ((int)(sizeof(rotations) / sizeof(rotations[0])))
+
+static bool checkPair(int first, int second);
+static bool inside(int col, int row, int width, int height);
+
+int main(void)
+{
+        int failures = 0;
+        for (int i = 0; i < rotationCount; i++) {
+                for (int j = 0; j < rotationCount; j++) {
+                        if (!checkPair(rotations[i], rotations[j]))
+                                failures++;
+                }
+        }
+
+        if (failures > 0) {
+                fprintf(stderr, "%d of %d pairs composed wrongly\n",
+                        failures, rotationCount * rotationCount);
+                return EXIT_FAILURE;
+        }
+        printf("composeRotation: all %d pairs passed\n",
+               rotationCount * rotationCount);
+        return EXIT_SUCCESS;
+}
+
+/**********checkPair********
+ * About: This function compares composeRotation(first, second) with doing
+ *        first and then second, pixel by pixel
+ * Inputs:
+ * int first: the rotation type done first
+ * int second: the rotation type done after it
+ * Return: true if they agree everywhere; false otherwise, after printing the
+ *         pair
+************************/
+static bool checkPair(int first, int second)
+{
+        int both = composeRotation(first, second);
+        bool swapsFirst = rotationSwapsSides(first);
+        int width = swapsFirst ? testHeight : testWidth;
+        int height = swapsFirst ? testWidth : testHeight;
+        int newWidth = rotationSwapsSides(both) ? testHeight : testWidth;
+        int newHeight = rotationSwapsSides(both) ? testWidth : testHeight;
+        if (rotationSwapsSides(both) !=
+            (swapsFirst != rotationSwapsSides(second))) {
+                fprintf(stderr, "%d then %d gives %d, which does not swap "
+                        "the sides the same way\n", first, second, both);
+                return false;
+        }
+
+        for (int row = 0; row < testHeight; row++) {
+                for (int col = 0; col < testWidth; col++) {
+                        int midCol, midRow, endCol, endRow, oneCol, oneRow;
+                        kernelMapPoint(first, testWidth, testHeight, col, row,
+                                       &midCol, &midRow);
+                        kernelMapPoint(second, width, height, midCol, midRow,
+                                       &endCol, &endRow);
+                        kernelMapPoint(both, testWidth, testHeight, col, row,
+                                       &oneCol, &oneRow);
+                        if (!inside(midCol, midRow, width, height) ||
+                            !inside(endCol, endRow, newWidth, newHeight) ||
+                            oneCol != endCol || oneRow != endRow) {
+                                fprintf(stderr, "%d then %d gives %d, which "
+                                        "moves (%d, %d) to (%d, %d), not "
+                                        "(%d, %d)\n", first, second, both,
+                                        col, row, oneCol, oneRow, endCol,
+                                        endRow);
+                                return false;
+                        }
+                }
+        }
+        return true;
+}
+
+/**********inside********
+ * About: This function tells whether a position lies in an image
+ * Inputs:
+ * int col, int row: the position
+ * int width, int height: dimensions of the image
+ * Return: true if the position is a pixel of the image; false otherwise
+************************/
+static bool inside(int col, int row, int width, int height)
+{
+        return col >= 0 && col < width && row >= 0 && row < height;
+}
@@ -0,0 +1,239 @@
+/*
+ *     slab.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the slab allocator of the 2D arrays. A
+ *            small slab comes from CALLOC with room to move its cells up to a
+ *            cache line. The huge page modes map the slab instead: the
+ *            mapping is made one huge page longer than needed, and the parts
+ *            before the first and after the last aligned huge page are
+ *            unmapped, so the kernel can back every part of it with huge
+ *            pages. Anonymous mappings start out zero, like CALLOC.
+ *
+ *            Large slabs are also mapped, with small pages, when a NUMA mode
+ *            is on (see numa.h): a fresh mapping has no page until it is
+ *            touched, and it can be interleaved over the nodes first, while
+ *            a heap block may reuse pages some other thread already touched.
+ *
+ *            Slabs smaller than a huge page always come from the heap, since
+ *            a huge page would mostly be wasted on them.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <mem.h>
+
+#include "assert.h"
+#include "slab.h"
+#include "numa.h"
+
+#define slabAlign 64
+#define hugePageBytes (2L << 20)   /* the huge page size of x86-64 */
+#define modeVariable "UARRAY2_PAGES"
+
+static pthread_once_t modeOnce = PTHREAD_ONCE_INIT;
+static pthread_once_t warnOnce = PTHREAD_ONCE_INIT;
+static int mode = -1;
+
+static void readMode(void);
+static void warnHugetlb(void);
+static bool mapSlab(struct slab *slab, size_t bytes, int pages);
+
+/**********slabParseMode********
+ * About: This function finds the mode with the given name
+ * Inputs:
+ * const char *name: "small", "thp", or "hugetlb"
+ * Return: slabSmall, slabThp, or slabHugetlb; -1 for any other name
+************************/
+int slabParseMode(const char *name)
+{
+        if (name == NULL)
+                return -1;
+        if (strcmp(name, "small") == 0)
+                return slabSmall;
+        if (strcmp(name, "thp") == 0)
+                return slabThp;
+        if (strcmp(name, "hugetlb") == 0)
+                return slabHugetlb;
+        return -1;
+}
+
+/**********slabSetMode********
+ * About: This function sets how the slabs allocated from now on are backed,
+ *        in place of the mode of the environment
+ * Inputs:
+ * int newMode: slabSmall, slabThp, or slabHugetlb
+ * Return: none
+ * Expects
+ * - newMode to be one of the modes; throws CRE otherwise
+ * Note: It should be called before any other thread allocates a slab.
+************************/
+void slabSetMode(int newMode)
+{
+        assert(newMode == slabSmall || newMode == slabThp ||
+               newMode == slabHugetlb);
+        mode = newMode;
+}
+
+/**********slabAlloc********
+ * About: This function allocates a slab of at least the given number of
+ *        bytes, every one of them zero, with the current mode
+ * Inputs:
+ * struct slab *slab: where to store the slab
+ * size_t bytes: the number of bytes of cells
+ * Return: none
+ * Expects
+ * - slab to be nonnull; throws CRE otherwise
+ * Note: The user should call slabFree when done. Raises Mem_Failed if even
+ * the heap has no room.
+************************/
+void slabAlloc(struct slab *slab, size_t bytes)
+{
+        assert(slab != NULL);
+        pthread_once(&modeOnce, readMode);
+
+        bool placed = numaMode() != numaOff;
+        if (bytes >= (size_t)hugePageBytes && (mode != slabSmall || placed)) {
+                if (mode == slabHugetlb && mapSlab(slab, bytes, slabHugetlb))
+                        return;
+                if (mode == slabHugetlb)
+                        pthread_once(&warnOnce, warnHugetlb);
+                if (mapSlab(slab, bytes, mode == slabSmall ? slabSmall :
+                                                             slabThp))
+                        return;
+        }
+
+        slab->base = CALLOC(1, bytes + slabAlign - 1);
+        slab->mapped = 0;
+        uintptr_t start = (uintptr_t)slab->base;
+        slab->cells = (char *)((start + slabAlign - 1) &
+                               ~(uintptr_t)(slabAlign - 1));
+}
+
+/**********slabWrap********
+ * About: This function makes a slab of cells the caller holds. The slab
+ *        does not own them, so slabFree leaves them alone.
+ * Inputs:
+ * struct slab *slab: where to store the slab
+ * void *cells: the first cell
+ * Return: none
+ * Expects
+ * - slab and cells to be nonnull; throws CRE otherwise
+************************/
+void slabWrap(struct slab *slab, void *cells)
+{
+        assert(slab != NULL && cells != NULL);
+        slab->cells = cells;
+        slab->base = NULL;
+        slab->mapped = 0;
+}
+
+/**********slabFree********
+ * About: This function gives back the memory of a slab
+ * Inputs:
+ * struct slab *slab: the slab, from slabAlloc; its cells are set to NULL
+ * Return: none
+ * Expects
+ * - slab to be nonnull; throws CRE otherwise
+************************/
+void slabFree(struct slab *slab)
+{
+        assert(slab != NULL);
+        if (slab->mapped > 0)
+                munmap(slab->base, slab->mapped);
+        else if (slab->base != NULL)
+                FREE(slab->base);
+        slab->base = NULL;
+        slab->cells = NULL;
+        slab->mapped = 0;
+}
+
+/**********readMode********
+ * About: This function reads the mode from the environment, unless
+ *        slabSetMode already chose one; an unknown name is the default
+ * Inputs: none
+ * Return: none
+************************/
+static void readMode(void)
+{
+        if (mode >= 0)
+                return;
+        const char *name = getenv(modeVariable);
+        mode = slabParseMode(name);
+        if (mode < 0 && name != NULL && *name != '\0')
+                fprintf(stderr, "%s: unknown mode '%s', using small pages\n",
+                        modeVariable, name);
+        if (mode < 0)
+                mode = slabSmall;
+}
+
+/**********warnHugetlb********
+ * About: This function tells the user, once, that no reserved huge pages
+ *        could be mapped
+ * Inputs: none
+ * Return: none
+************************/
+static void warnHugetlb(void)
+{
+        fprintf(stderr, "No reserved huge pages (see "
+                        "/proc/sys/vm/nr_hugepages); using transparent huge "
+                        "pages\n");
+}
+
+/**********mapSlab********
+ * About: This function maps a slab that starts on a huge page. A
+ *        MAP_HUGETLB mapping is aligned by the kernel; an ordinary one is
+ *        mapped a huge page longer and trimmed, then marked for transparent
+ *        huge pages if they are wanted. The NUMA policy is set on the
+ *        mapping before it is handed out.
+ * Inputs:
+ * struct slab *slab: where to store the slab
+ * size_t bytes: the number of bytes of cells
+ * int pages: slabSmall, slabThp, or slabHugetlb
+ * Return: true if the slab was mapped; false if the kernel refused
+************************/
+static bool mapSlab(struct slab *slab, size_t bytes, int pages)
+{
+        size_t length = (bytes + hugePageBytes - 1) &
+                        ~(size_t)(hugePageBytes - 1);
+        if (pages == slabHugetlb) {
+                void *map = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                                 -1, 0);
+                if (map == MAP_FAILED)
+                        return false;
+                slab->base = map;
+                slab->mapped = length;
+                slab->cells = map;
+                numaPlace(map, length);
+                return true;
+        }
+
+        char *map = mmap(NULL, length + hugePageBytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED)
+                return false;
+        uintptr_t start = ((uintptr_t)map + hugePageBytes - 1) &
+                          ~(uintptr_t)(hugePageBytes - 1);
+        char *aligned = (char *)start;
+        size_t head = aligned - map;
+        if (head > 0)
+                munmap(map, head);
+        munmap(aligned + length, hugePageBytes - head);
+
+        /* only a hint: without THP the pages are just small ones */
+        if (pages == slabThp)
+                madvise(aligned, length, MADV_HUGEPAGE);
+        slab->base = aligned;
+        slab->mapped = length;
+        slab->cells = aligned;
+        numaPlace(aligned, length);
+        return true;
+}
@@ -0,0 +1,47 @@
+/*
+ *     slab.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file allocates the slabs that hold the cells of the 2D
+ *            arrays (UArray2, UArray2b, UArray2m). The cells of a slab always
+ *            start on a cache line. Large slabs can also be backed by huge
+ *            pages, so a rotation that walks the columns of a big image
+ *            misses the TLB far less often:
+ *              small    aligned memory from the heap (the default)
+ *              thp      an anonymous mapping aligned to a huge page and
+ *                       marked with madvise(MADV_HUGEPAGE), so transparent
+ *                       huge pages back it
+ *              hugetlb  a MAP_HUGETLB mapping from the reserved huge pages
+ *            A mode that cannot be had falls back to the next one down
+ *            (hugetlb to thp, thp to small). The mode is set by slabSetMode,
+ *            or else read from the UARRAY2_PAGES environment variable.
+ */
+
+#ifndef SLAB_INCLUDED
+#define SLAB_INCLUDED
+
+#include <stddef.h>
+
+#define slabSmall 0
+#define slabThp 1
+#define slabHugetlb 2
+
+/**********struct slab********
+ * About: This struct holds a slab: its cells, and what has to be given
+ *        back to free it (a heap block, a mapping of mapped bytes, or
+ *        nothing for cells the slab does not own)
+************************/
+struct slab {
+        char *cells; /* the first cell, aligned to a cache line */
+        void *base; /* the heap block or the mapping; NULL if not owned */
+        size_t mapped; /* bytes mapped at base; 0 for a heap block */
+};
+
+extern int slabParseMode(const char *name);
+extern void slabSetMode(int mode);
+extern void slabAlloc(struct slab *slab, size_t bytes);
+extern void slabWrap(struct slab *slab, void *cells);
+extern void slabFree(struct slab *slab);
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ *     stream.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the streaming mode. It reads the P6 header
+ *            itself and then handles the pixel rows as raw bytes: a pixel is
+ *            3 bytes (6 bytes when maxval is over 255), and a row is width
+ *            pixels. 0 degree rotation and horizontal flip need only the
+ *            current row. Vertical flip and 180 degree rotation need the rows
+ *            from the last to the first; since all rows have the same size,
+ *            row r of a seekable input starts at the end of the header plus
+ *            r times the row size, so the rows are read backwards with fseek.
+ *            Input that cannot seek (a pipe) is kept in memory for those two
+ *            operations instead.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <mem.h>
+#include <except.h>
+
+#include "assert.h"
+#include "stream.h"
+#include "operations.h"
+#include "pnm.h"
+#include "timing.h"
+
+static unsigned readHeaderNumber(FILE *fp);
+static void reverseRow(unsigned char *row, int width, int pixelBytes);
+static void readRow(FILE *fp, unsigned char *row, size_t rowBytes);
+
+/**********streamSupports********
+ * About: This function tells whether an operation can be streamed
+ * Inputs:
+ * int rotation: The rotation type provided by the user
+ * Return: true for 0, 180 degree rotations and the flips; false otherwise
+************************/
+bool streamSupports(int rotation)
+{
+        return rotation == rotation0 || rotation == rotation180 ||
+               rotation == flipHorizontal || rotation == flipVertical;
+}
+
+/**********streamOperation********
+ * About: This function reads a P6 image from fp and prints the result of the
+ *        given operation to options->output one row at a time. If the user
+ *        asked for timing, every row adds to the read, transform, and write
+ *        phases.
+ * Inputs:
+ * FILE *fp: Pointer to the ppm file provided by the user
+ * int rotation: The rotation type provided by the user
+ * struct operationOptions *options: the phases to time (NULL for none) and
+ * output stream
+ * Return: none
+ * Expects
+ * - fp and options to be nonnull and the operation to be allowed by
+ *   streamSupports; throws CRE otherwise
+ * - the image to be a binary (P6) ppm; raises Pnm_Badformat otherwise
+************************/
+void streamOperation(FILE *fp, int rotation, struct operationOptions *options)
+{
+        assert(fp != NULL && options != NULL && streamSupports(rotation));
+        struct phaseTimes *phases = options->phases;
+
+        /* read the header */
+        unsigned width, height, maxval;
+        phaseStart(phases);
+        streamReadHeader(fp, &width, &height, &maxval);
+        phaseStop(phases, phaseRead, 0);
+        phaseSize(phases, width, height);
+
+        int pixelBytes = maxval > 255 ? 6 : 3;
+        size_t rowBytes = (size_t)width * pixelBytes;
+        bool reverseRows = rotation == rotation180 ||
+                           rotation == flipVertical;
+        bool reversePixels = rotation == rotation180 ||
+                             rotation == flipHorizontal;
+
+        phaseStart(phases);
+        fprintf(options->output, "P6\n%u %u\n%u\n", width, height, maxval);
+        phaseStop(phases, phaseWrite, 0);
+
+        /* with rows in reverse order, find where the pixels start; -1 if
+         * the input cannot seek */
+        off_t start = reverseRows ? ftello(fp) : -1;
+        if (start >= 0 && fseeko(fp, 0, SEEK_CUR) != 0)
+                start = -1;
+
+        unsigned char *rows;
+        phaseStart(phases);
+        if (reverseRows && start < 0) {
+                /* a pipe: keep the whole image to read it backwards */
+                rows = ALLOC(rowBytes * height + 1);
+                phaseStop(phases, phaseAllocate, rowBytes * height);
+                phaseStart(phases);
+                for (unsigned r = 0; r < height; r++)
+                        readRow(fp, rows + r * rowBytes, rowBytes);
+                phaseStop(phases, phaseRead, rowBytes * height);
+        } else {
+                rows = ALLOC(rowBytes + 1);
+                phaseStop(phases, phaseAllocate, rowBytes);
+        }
+        assert(rows != NULL);
+
+        for (unsigned r = 0; r < height; r++) {
+                unsigned char *row = rows;
+                phaseStart(phases);
+                if (!reverseRows) {
+                        readRow(fp, row, rowBytes);
+                } else if (start >= 0) {
+                        off_t at = start + (off_t)(height - 1 - r) * rowBytes;
+                        if (fseeko(fp, at, SEEK_SET) != 0)
+                                RAISE(Pnm_Badformat);
+                        readRow(fp, row, rowBytes);
+                } else {
+                        row = rows + (height - 1 - r) * rowBytes;
+                }
+                phaseStop(phases, phaseRead, 
+                          reverseRows && start < 0 ? 0 : rowBytes);
+
+                phaseStart(phases);
+                if (reversePixels)
+                        reverseRow(row, width, pixelBytes);
+                phaseStop(phases, phaseTransform, rowBytes);
+
+                phaseStart(phases);
+                fwrite(row, 1, rowBytes, options->output);
+                phaseStop(phases, phaseWrite, rowBytes);
+        }
+
+        phaseStart(phases);
+        FREE(rows);
+        phaseStop(phases, phaseFree, 0);
+}
+
+/**********streamReadHeader********
+ * About: This function reads the header of a P6 image, up to and including
+ *        the single white space character before the pixels
+ * Inputs:
+ * FILE *fp: Pointer to the ppm file, at its start
+ * unsigned *width, unsigned *height, unsigned *maxval: where to store the
+ * header values
+ * Return: none
+ * Expects
+ * - the image to be a binary (P6) ppm; raises Pnm_Badformat otherwise
+************************/
+void streamReadHeader(FILE *fp, unsigned *width, unsigned *height,
+                      unsigned *maxval)
+{
+        if (getc(fp) != 'P' || getc(fp) != '6')
+                RAISE(Pnm_Badformat);
+        *width = readHeaderNumber(fp);
+        *height = readHeaderNumber(fp);
+        *maxval = readHeaderNumber(fp);
+        if (*maxval == 0 || *maxval > 65535 || !isspace(getc(fp)))
+                RAISE(Pnm_Badformat);
+}
+
+/**********readHeaderNumber********
+ * About: This function reads a number of the P6 header, skipping the white
+ *        space and the comments (from '#' to the end of the line) before it
+ * Inputs:
+ * FILE *fp: Pointer to the ppm file, just after the previous header field
+ * Return: the number
+ * Expects
+ * - a number to be next; raises Pnm_Badformat otherwise
+************************/
+static unsigned readHeaderNumber(FILE *fp)
+{
+        int c = getc(fp);
+        while (isspace(c) || c == '#') {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF)
+                                c = getc(fp);
+                }
+                c = getc(fp);
+        }
+        if (!isdigit(c))
+                RAISE(Pnm_Badformat);
+
+        unsigned number = 0;
+        while (isdigit(c)) {
+                number = number * 10 + (c - '0');
+                c = getc(fp);
+        }
+        ungetc(c, fp);
+        return number;
+}
+
+/**********reverseRow********
+ * About: This function reverses the order of the pixels of a row, keeping
+ *        the bytes of each pixel in order
+ * Inputs:
+ * unsigned char *row: the row
+ * int width: number of pixels in the row
+ * int pixelBytes: bytes in a pixel (3 or 6)
+ * Return: none
+************************/
+static void reverseRow(unsigned char *row, int width, int pixelBytes)
+{
+        unsigned char tmp[6];
+        unsigned char *left = row;
+        unsigned char *right = row + (size_t)(width - 1) * pixelBytes;
+        while (left < right) {
+                memcpy(tmp, left, pixelBytes);
+                memcpy(left, right, pixelBytes);
+                memcpy(right, tmp, pixelBytes);
+                left += pixelBytes;
+                right -= pixelBytes;
+        }
+}
+
+/**********readRow********
+ * About: This function reads one row of raw pixel bytes
+ * Inputs:
+ * FILE *fp: Pointer to the ppm file
+ * unsigned char *row: where to store the row
+ * size_t rowBytes: bytes in a row
+ * Return: none
+ * Expects
+ * - the row to be complete; raises Pnm_Badformat otherwise
+************************/
+static void readRow(FILE *fp, unsigned char *row, size_t rowBytes)
+{
+        if (fread(row, 1, rowBytes, fp) != rowBytes)
+                RAISE(Pnm_Badformat);
+}
@@ -0,0 +1,27 @@
+/*
+ *     stream.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the streaming mode. Operations that keep every
+ *            row of the image a row of the result (0 degree rotation,
+ *            horizontal and vertical flip, 180 degree rotation) are done on
+ *            a binary (P6) image one row at a time, straight from the input
+ *            file to the standard output, without building the image in
+ *            memory.
+ */
+
+#ifndef STREAM_INCLUDED
+#define STREAM_INCLUDED
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "operations.h"
+
+extern bool streamSupports(int rotation);
+extern void streamOperation(FILE *fp, int rotation,
+                            struct operationOptions *options);
+extern void streamReadHeader(FILE *fp, unsigned *width, unsigned *height,
+                             unsigned *maxval);
+
+#endif
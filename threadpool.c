@@ -0,0 +1,243 @@
+/*
+ *     threadpool.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the persistent worker pool. The mutex and
+ *     condition variables are only used to start a job and to wait for its
+ *     end; how the workers share the work inside a job is up to the job.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <mem.h>
+
+#include "assert.h"
+#include "threadpool.h"
+#include "numa.h"
+
+#define T ThreadPool_T
+
+/**********struct T********
+ * About: This struct holds the worker threads, the job being run, and the
+ *        state used to start and finish jobs. generation goes up by one for
+ *        every job, so a worker can tell a new job from the one it just ran.
+************************/
+struct T {
+        int size; /* number of worker threads, at least 1 */
+        pthread_t *threads;
+        pthread_mutex_t lock;
+        pthread_cond_t start; /* signalled when a job is posted */
+        pthread_cond_t done; /* signalled when the last worker finishes */
+        unsigned long generation;
+        int running; /* workers that have not finished the current job */
+        bool quit;
+        ThreadPool_job *job;
+        void *cl;
+};
+
+/**********struct workerParameters********
+ * About: This struct holds what a worker thread gets when it is created
+************************/
+struct workerParameters {
+        T pool;
+        int worker;
+};
+
+static void *workerLoop(void *workerStruct);
+static void pinWorker(pthread_t thread, int worker);
+
+/**********ThreadPool_new********
+ * About: This function creates a pool with the given number of workers and
+ *        pins worker i to the i-th CPU the process may run on (wrapping
+ *        around if there are more workers than CPUs), or, with a NUMA mode
+ *        on a machine with several nodes, to a CPU of its node (see numa.h)
+ * Inputs:
+ * int threads: number of worker threads
+ * Return: the new pool
+ * Expects
+ * - threads to be at least 1; throws CRE otherwise
+ * Note: The user should call ThreadPool_free to stop the workers
+************************/
+T ThreadPool_new(int threads)
+{
+        assert(threads >= 1);
+
+        T pool;
+        NEW(pool);
+        assert(pool != NULL);
+
+        pool->size = threads;
+        pool->generation = 0;
+        pool->running = 0;
+        pool->quit = false;
+        pool->job = NULL;
+        pool->cl = NULL;
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->start, NULL);
+        pthread_cond_init(&pool->done, NULL);
+
+        pool->threads = ALLOC(threads * sizeof(pthread_t));
+        assert(pool->threads != NULL);
+
+        for (int i = 0; i < threads; i++) {
+                struct workerParameters *prm;
+                NEW(prm);
+                assert(prm != NULL);
+                prm->pool = pool;
+                prm->worker = i;
+                int status = pthread_create(&pool->threads[i], NULL,
+                                            workerLoop, prm);
+                assert(status == 0);
+                if (!numaPinWorker(pool->threads[i], i, threads))
+                        pinWorker(pool->threads[i], i);
+        }
+
+        return pool;
+}
+
+/**********ThreadPool_size********
+ * About: This function returns the number of workers in the pool
+ * Inputs:
+ * T pool: the pool
+ * Return: number of workers
+ * Expects
+ * - pool to be nonnull; throws CRE otherwise
+************************/
+int ThreadPool_size(T pool)
+{
+        assert(pool != NULL);
+        return pool->size;
+}
+
+/**********ThreadPool_run********
+ * About: This function runs job(worker, cl) once on every worker and returns
+ *        when all of them have returned
+ * Inputs:
+ * T pool: the pool
+ * ThreadPool_job job: the function every worker calls
+ * void *cl: client pointer handed to job
+ * Return: none
+ * Expects
+ * - pool and job to be nonnull; throws CRE otherwise
+ * - not to be called from inside a job of the same pool
+************************/
+void ThreadPool_run(T pool, ThreadPool_job job, void *cl)
+{
+        assert(pool != NULL && job != NULL);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->job = job;
+        pool->cl = cl;
+        pool->running = pool->size;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->start);
+
+        while (pool->running > 0)
+                pthread_cond_wait(&pool->done, &pool->lock);
+        pthread_mutex_unlock(&pool->lock);
+}
+
+/**********ThreadPool_free********
+ * About: This function stops and joins the workers and frees the pool
+ * Inputs:
+ * T *pool: address of the pool
+ * Return: none
+ * Expects
+ * - pool and *pool to be nonnull; throws CRE otherwise
+************************/
+void ThreadPool_free(T *pool)
+{
+        assert(pool != NULL && *pool != NULL);
+        T p = *pool;
+
+        pthread_mutex_lock(&p->lock);
+        p->quit = true;
+        pthread_cond_broadcast(&p->start);
+        pthread_mutex_unlock(&p->lock);
+
+        for (int i = 0; i < p->size; i++)
+                pthread_join(p->threads[i], NULL);
+
+        pthread_cond_destroy(&p->start);
+        pthread_cond_destroy(&p->done);
+        pthread_mutex_destroy(&p->lock);
+        FREE(p->threads);
+        FREE(*pool);
+}
+
+/**********workerLoop********
+ * About: This function is the body of a worker thread. It sleeps until a new
+ *        generation is posted, runs the job, and reports that it is done.
+ * Inputs:
+ * void *workerStruct: a workerParameters instance, freed by the worker
+ * Return: NULL
+************************/
+static void *workerLoop(void *workerStruct)
+{
+        struct workerParameters *prm = workerStruct;
+        T pool = prm->pool;
+        int worker = prm->worker;
+        FREE(prm);
+
+        unsigned long seen = 0;
+        for (;;) {
+                pthread_mutex_lock(&pool->lock);
+                while (pool->generation == seen && !pool->quit)
+                        pthread_cond_wait(&pool->start, &pool->lock);
+                if (pool->quit) {
+                        pthread_mutex_unlock(&pool->lock);
+                        break;
+                }
+                seen = pool->generation;
+                ThreadPool_job *job = pool->job;
+                void *cl = pool->cl;
+                pthread_mutex_unlock(&pool->lock);
+
+                job(worker, cl);
+
+                pthread_mutex_lock(&pool->lock);
+                if (--pool->running == 0)
+                        pthread_cond_signal(&pool->done);
+                pthread_mutex_unlock(&pool->lock);
+        }
+        return NULL;
+}
+
+/**********pinWorker********
+ * About: This function pins a worker to one of the CPUs in the affinity mask
+ *        of the process. Pinning is only a hint, so failures are ignored.
+ * Inputs:
+ * pthread_t thread: the worker thread
+ * int worker: index of the worker
+ * Return: none
+************************/
+static void pinWorker(pthread_t thread, int worker)
+{
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+                return;
+        int cpus = CPU_COUNT(&allowed);
+        if (cpus == 0)
+                return;
+
+        /* find the (worker mod cpus)-th allowed CPU */
+        int wanted = worker % cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (!CPU_ISSET(cpu, &allowed))
+                        continue;
+                if (wanted-- == 0) {
+                        cpu_set_t one;
+                        CPU_ZERO(&one);
+                        CPU_SET(cpu, &one);
+                        pthread_setaffinity_np(thread, sizeof(one), &one);
+                        return;
+                }
+        }
+}
+
+#undef T
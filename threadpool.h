@@ -0,0 +1,27 @@
+/*
+ *     threadpool.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file can be used to create a persistent pool of worker
+ *     threads, each pinned to its own CPU. The client hands a job to the pool
+ *     and every worker runs it once with its own worker index; the call
+ *     returns when all of them are done. The workers are kept between jobs,
+ *     so a job only pays for two wake-ups, not for creating threads.
+ */
+
+#ifndef THREADPOOL_INCLUDED
+#define THREADPOOL_INCLUDED
+
+#define T ThreadPool_T
+typedef struct T *T;
+
+typedef void ThreadPool_job(int worker, void *cl);
+
+extern T ThreadPool_new(int threads);
+extern int ThreadPool_size(T pool);
+extern void ThreadPool_run(T pool, ThreadPool_job job, void *cl);
+extern void ThreadPool_free(T *pool);
+
+#undef T
+#endif
@@ -0,0 +1,319 @@
+/*
+ *     tiled.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the tiled container. A container is laid
+ *            out as:
+ *              header   struct tiledHeader, 64 bytes
+ *              index    one 64 bit file offset per tile, tiles in the
+ *                       row-major order of the grid of blocks
+ *              padding  up to the next multiple of the page size
+ *              tiles    blocksize * blocksize cells each, cells past the
+ *                       right and bottom edges of the image included
+ *            The tiles start on a page boundary, so a mapping of the file
+ *            holds them exactly where the slab of a UArray2b would, and the
+ *            mapped pages are handed to UArray2b_new_from as they are. The
+ *            file is mapped privately, so rotating the array in place
+ *            changes copies of the pages and never the file. This loader
+ *            wants the tiles one after the other, as tiledWrite leaves them;
+ *            the index is what lets a reader find any one tile, e.g. for a
+ *            crop, without reading the others.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mem.h>
+#include <except.h>
+
+#include "assert.h"
+#include "tiled.h"
+#include "uarray2b.h"
+#include "a2blocked.h"
+#include "a2parallel.h"
+#include "cacheblock.h"
+#include "kernels.h"
+
+#define tiledMagic "PPMTILE1"
+#define byteOrderMark 0x01020304
+#define pageBytes 4096
+
+/**********struct tiledHeader********
+ * About: This struct is the header at the start of a container. byteOrder
+ *        holds byteOrderMark as the writing machine stores it, so a reader
+ *        with the other byte order can tell the file is not for it.
+************************/
+struct tiledHeader {
+        char magic[8];
+        uint32_t byteOrder;
+        uint32_t width;
+        uint32_t height;
+        uint32_t maxval;
+        uint32_t size; /* bytes of an element */
+        uint32_t blocksize; /* cells on a side of a tile */
+        uint32_t blocksWide;
+        uint32_t blocksHigh;
+        uint32_t unused;
+        uint64_t indexOffset; /* file offset of the index */
+        uint64_t dataOffset; /* file offset of the first tile */
+};
+
+static void writeTile(Pnm_ppm image, int blocksize, int blockCol,
+                      int blockRow, char *tile);
+static void writeOrDie(const void *bytes, size_t count, FILE *fp);
+
+/**********tiledOpen********
+ * About: This function maps the given file if it is a container
+ * Inputs:
+ * const char *path: name of the file
+ * struct tiledImage *image: the struct to fill
+ * Return: true if the file is a container and was mapped; false if it is
+ *         not a container (nothing is left mapped then)
+ * Expects
+ * - path and image to be nonnull; throws CRE otherwise
+ * - a file that starts like a container to be a complete one written on a
+ *   machine with the same byte order; raises Pnm_Badformat otherwise
+ * Note: The user should call tiledClose after a successful call, once the
+ * arrays made by tiledArray are freed
+************************/
+bool tiledOpen(const char *path, struct tiledImage *image)
+{
+        assert(path != NULL && image != NULL);
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return false;
+        struct tiledHeader header;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+            pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+            memcmp(header.magic, tiledMagic, sizeof(header.magic)) != 0) {
+                close(fd);
+                return false;
+        }
+
+        /* the header has to describe the tiles of a UArray2b, and the index
+         * has to put them one after the other up to the end of the file */
+        uint64_t blocks = (uint64_t)header.blocksWide * header.blocksHigh;
+        uint64_t tileBytes = (uint64_t)header.blocksize * header.blocksize *
+                             header.size;
+        size_t length = info.st_size;
+        bool ok = header.byteOrder == byteOrderMark &&
+                  header.width <= INT32_MAX && header.height <= INT32_MAX &&
+                  header.maxval > 0 && header.maxval <= 65535 &&
+                  (header.size == pixelRgb8 || header.size == pixelRgbx8 ||
+                   header.size == pixelRgb16 ||
+                   header.size == sizeof(struct Pnm_rgb)) &&
+                  header.blocksize > 0 && header.blocksize <= UINT16_MAX &&
+                  header.blocksWide == (header.width + header.blocksize - 1) /
+                                       header.blocksize &&
+                  header.blocksHigh == (header.height + header.blocksize -
+                                        1) / header.blocksize &&
+                  header.dataOffset % pageBytes == 0 &&
+                  header.dataOffset <= length &&
+                  header.indexOffset >= sizeof(header) &&
+                  header.indexOffset <= header.dataOffset &&
+                  blocks <= (header.dataOffset - header.indexOffset) /
+                            sizeof(uint64_t) &&
+                  blocks <= (length - header.dataOffset) / tileBytes;
+        void *map = MAP_FAILED;
+        if (ok)
+                map = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+                RAISE(Pnm_Badformat);
+
+        const uint64_t *index = (const uint64_t *)((char *)map +
+                                                   header.indexOffset);
+        for (uint64_t i = 0; i < blocks && ok; i++)
+                ok = index[i] == header.dataOffset + i * tileBytes;
+        if (!ok) {
+                munmap(map, length);
+                RAISE(Pnm_Badformat);
+        }
+        madvise(map, length, MADV_WILLNEED);
+
+        image->map = map;
+        image->length = length;
+        image->width = header.width;
+        image->height = header.height;
+        image->maxval = header.maxval;
+        image->size = header.size;
+        image->blocksize = header.blocksize;
+        image->tiles = (char *)map + header.dataOffset;
+        return true;
+}
+
+/**********tiledArray********
+ * About: This function makes a blocked array whose blocks are the mapped
+ *        tiles of a container; no pixel is copied
+ * Inputs:
+ * struct tiledImage *image: the container, mapped by tiledOpen
+ * Return: an array for uarray2_methods_blocked (or its parallel version)
+ * Expects
+ * - image to be nonnull and mapped; throws CRE otherwise
+ * Note: The array must be freed before tiledClose is called
+************************/
+A2Methods_UArray2 tiledArray(struct tiledImage *image)
+{
+        assert(image != NULL && image->map != NULL);
+        return UArray2b_new_from(image->width, image->height, image->size,
+                                 image->blocksize, image->tiles);
+}
+
+/**********tiledClose********
+ * About: This function unmaps a container mapped by tiledOpen
+ * Inputs:
+ * struct tiledImage *image: the mapped container
+ * Return: none
+ * Expects
+ * - image to be nonnull and mapped; throws CRE otherwise
+************************/
+void tiledClose(struct tiledImage *image)
+{
+        assert(image != NULL && image->map != NULL);
+        munmap(image->map, image->length);
+        image->map = NULL;
+        image->tiles = NULL;
+}
+
+/**********tiledWrite********
+ * About: This function writes an image as a container. The elements are
+ *        written as the array holds them (a Pnm_rgb each, or one of the
+ *        compact formats of kernels.h). The tiles of a blocked array are
+ *        its own blocks, each written with one copy; the pixels of any other
+ *        array go into tiles of the block size chosen for the caches (see
+ *        cacheblock.h).
+ * Inputs:
+ * FILE *fp: the stream to write to
+ * Pnm_ppm image: the image to write
+ * Return: none
+ * Expects
+ * - fp and image to be nonnull; throws CRE otherwise
+ * - the whole container to be written; prints an error and exits otherwise
+************************/
+void tiledWrite(FILE *fp, Pnm_ppm image)
+{
+        assert(fp != NULL && image != NULL);
+        A2Methods_T methods = (A2Methods_T)image->methods;
+        int size = methods->size(image->pixels);
+        bool blocked = methods == uarray2_methods_blocked ||
+                       methods == uarray2_methods_blocked_parallel;
+        int blocksize = blocked ? methods->blocksize(image->pixels) :
+                                  cacheBlocksize(size);
+
+        struct tiledHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, tiledMagic, sizeof(header.magic));
+        header.byteOrder = byteOrderMark;
+        header.width = image->width;
+        header.height = image->height;
+        header.maxval = image->denominator;
+        header.size = size;
+        header.blocksize = blocksize;
+        header.blocksWide = (image->width + blocksize - 1) / blocksize;
+        header.blocksHigh = (image->height + blocksize - 1) / blocksize;
+        uint64_t blocks = (uint64_t)header.blocksWide * header.blocksHigh;
+        size_t tileBytes = (size_t)blocksize * blocksize * size;
+        header.indexOffset = sizeof(header);
+        header.dataOffset = (header.indexOffset + blocks * sizeof(uint64_t) +
+                             pageBytes - 1) / pageBytes * pageBytes;
+
+        writeOrDie(&header, sizeof(header), fp);
+        for (uint64_t i = 0; i < blocks; i++) {
+                uint64_t offset = header.dataOffset + i * tileBytes;
+                writeOrDie(&offset, sizeof(offset), fp);
+        }
+        static const char zeros[pageBytes];
+        writeOrDie(zeros, header.dataOffset - header.indexOffset -
+                          blocks * sizeof(uint64_t), fp);
+
+        char *tile = blocked ? NULL : ALLOC(tileBytes);
+        for (unsigned row = 0; row < header.blocksHigh; row++) {
+                for (unsigned col = 0; col < header.blocksWide; col++) {
+                        if (blocked) {
+                                /* a block is contiguous, starting with the
+                                 * cell at its top left corner */
+                                writeOrDie(methods->at(image->pixels,
+                                                       col * blocksize,
+                                                       row * blocksize),
+                                           tileBytes, fp);
+                                continue;
+                        }
+                        writeTile(image, blocksize, col, row, tile);
+                        writeOrDie(tile, tileBytes, fp);
+                }
+        }
+        if (tile != NULL)
+                FREE(tile);
+        if (fflush(fp) != 0) {
+                fprintf(stderr, "The container cannot be written\n");
+                exit(EXIT_FAILURE);
+        }
+}
+
+/**********writeTile********
+ * About: This function copies the pixels of one tile of an array that is
+ *        not blocked into a buffer, in runs that are contiguous in memory
+ *        (the part of a row of a plain array inside the tile, or a single
+ *        element for other suites). Cells past the edges are zero.
+ * Inputs:
+ * Pnm_ppm image: the image being written
+ * int blocksize: cells on a side of a tile
+ * int blockCol, int blockRow: place of the tile in the grid of blocks
+ * char *tile: where to copy the tile
+ * Return: none
+************************/
+static void writeTile(Pnm_ppm image, int blocksize, int blockCol,
+                      int blockRow, char *tile)
+{
+        A2Methods_T methods = (A2Methods_T)image->methods;
+        int size = methods->size(image->pixels);
+        bool plain = kernelSupports(methods);
+        int firstCol = blockCol * blocksize;
+        int firstRow = blockRow * blocksize;
+        int cols = (int)image->width - firstCol;
+        if (cols > blocksize)
+                cols = blocksize;
+
+        memset(tile, 0, (size_t)blocksize * blocksize * size);
+        for (int r = 0; r < blocksize && firstRow + r < (int)image->height;
+             r++) {
+                char *to = tile + (size_t)r * blocksize * size;
+                if (plain) {
+                        memcpy(to, methods->at(image->pixels, firstCol,
+                                               firstRow + r),
+                               (size_t)cols * size);
+                        continue;
+                }
+                for (int c = 0; c < cols; c++)
+                        memcpy(to + (size_t)c * size,
+                               methods->at(image->pixels, firstCol + c,
+                                           firstRow + r), size);
+        }
+}
+
+/**********writeOrDie********
+ * About: This function writes bytes to the container
+ * Inputs:
+ * const void *bytes, size_t count: the bytes to write
+ * FILE *fp: the stream to write to
+ * Return: none
+ * Expects
+ * - the bytes to be written; prints an error and exits otherwise
+************************/
+static void writeOrDie(const void *bytes, size_t count, FILE *fp)
+{
+        if (fwrite(bytes, 1, count, fp) != count) {
+                fprintf(stderr, "The container cannot be written\n");
+                exit(EXIT_FAILURE);
+        }
+}
@@ -0,0 +1,49 @@
+/*
+ *     tiled.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the tiled container, a binary image format laid
+ *            out like a UArray2b. A header records the width, height,
+ *            maxval, element size, and block size, an index gives the file
+ *            offset of every tile (block), and the tiles follow, each one the
+ *            bytes of a block of a UArray2b with that element size. A
+ *            container is loaded by mapping it into memory and using the
+ *            tiles in place as the blocks of an A2Methods_UArray2 of the
+ *            blocked suite, so nothing is decoded. The samples are stored
+ *            in the byte order of the machine that wrote them.
+ *            An image that is transformed many times can so be converted
+ *            once ("ppmtrans -rotate 0 -tiled") and loaded almost for free
+ *            afterwards.
+ */
+
+#ifndef TILED_INCLUDED
+#define TILED_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "a2methods.h"
+#include "pnm.h"
+
+/**********struct tiledImage********
+ * About: This struct holds a mapped container: the mapping, the header
+ *        values, and the first tile
+************************/
+struct tiledImage {
+        void *map;
+        size_t length;
+        unsigned width;
+        unsigned height;
+        unsigned maxval;
+        int size;
+        int blocksize;
+        char *tiles;
+};
+
+extern bool tiledOpen(const char *path, struct tiledImage *image);
+extern A2Methods_UArray2 tiledArray(struct tiledImage *image);
+extern void tiledClose(struct tiledImage *image);
+extern void tiledWrite(FILE *fp, Pnm_ppm image);
+
+#endif
@@ -0,0 +1,512 @@
+/*
+ *     timing.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the phase timing and the timing log. The
+ *            log file is opened once per run. A record is built in memory and
+ *            written with a single locked write, so the batch workers can
+ *            share the log without mixing their records.
+ *
+ *            Every record has the input file, the operation, the size of the
+ *            result, the number of threads, and for every phase the wall,
+ *            process CPU, and thread CPU nanoseconds, the pixels per second,
+ *            and the bytes per second (all from the wall time), followed by
+ *            the total wall time of the phases (or of the whole image, when
+ *            its phases overlapped). A log with counters adds, for every
+ *            phase, every hardware counter per pixel and the instructions per
+ *            cycle; a counter the machine does not have is null in JSON and
+ *            empty in CSV. A CSV log has the counter columns whether or not
+ *            it has counters (they are empty without them), so runs with and
+ *            without -counters can share one file; a CSV file whose header is
+ *            not the one this program writes is never appended to.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <mem.h>
+
+#include "assert.h"
+#include "timing.h"
+
+#define T TimeLog_T
+
+/**********struct T********
+ * About: This struct holds the open log file, its format, and whether the
+ *        records have hardware counters
+************************/
+struct T {
+        FILE *fp;
+        bool csv;
+        bool counters;
+};
+
+static const char *phaseNames[phaseCount] = { "read", "allocate",
+                                              "transform", "write", "free" };
+static const char *counterNames[CPUTime_counterCount] = {
+        "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses"
+};
+
+static void jsonString(FILE *fp, const char *string);
+static void csvString(FILE *fp, const char *string);
+static double perSecond(double amount, double nanoseconds);
+static void counterFields(FILE *fp, T log, struct phaseTimes *phases,
+                          int phase, double pixels);
+static void counterValue(FILE *fp, T log, bool known, double value);
+static char *csvHeader(void);
+static bool sameHeader(FILE *fp, const char *header);
+
+/**********TimeLog_new********
+ * About: This function opens a timing log for appending. A CSV log that is
+ *        still empty gets a header line first; one that is not empty has to
+ *        start with the same header.
+ * Inputs:
+ * const char *name: name of the log file; CSV if it ends in ".csv", JSON
+ * lines otherwise
+ * bool counters: whether to read the hardware counters too; if the machine
+ * has none, a warning is printed and the log goes on without them
+ * Return: the log, or NULL if the file cannot be opened or is a CSV file
+ *         with other columns
+ * Expects
+ * - name to be nonnull; throws CRE otherwise
+ * Note: The user should call TimeLog_free when done
+************************/
+T TimeLog_new(const char *name, bool counters)
+{
+        assert(name != NULL);
+        FILE *fp = fopen(name, "a+");
+        if (fp == NULL)
+                return NULL;
+        size_t length = strlen(name);
+        bool csv = length >= 4 && strcmp(name + length - 4, ".csv") == 0;
+
+        /* the records of a CSV log only make sense under their own header */
+        if (csv) {
+                char *header = csvHeader();
+                fseek(fp, 0, SEEK_END);
+                bool fits = ftell(fp) == 0 ? fputs(header, fp) != EOF :
+                                             sameHeader(fp, header);
+                free(header);
+                if (!fits || fflush(fp) != 0) {
+                        fclose(fp);
+                        return NULL;
+                }
+        }
+
+        T log;
+        NEW(log);
+        log->fp = fp;
+        log->csv = csv;
+
+        /* try the counters once, so every record has the same fields */
+        if (counters) {
+                CPUTime_T probe = CPUTime_New();
+                if (CPUTime_EnableCounters(probe) == 0) {
+                        fprintf(stderr, "Hardware counters are not "
+                                        "available; timing without them\n");
+                        counters = false;
+                }
+                CPUTime_Free(&probe);
+        }
+        log->counters = counters;
+        return log;
+}
+
+/**********TimeLog_free********
+ * About: This function closes a timing log
+ * Inputs:
+ * T *log: address of the log; set to NULL
+ * Return: none
+ * Expects
+ * - log and *log to be nonnull; throws CRE otherwise
+************************/
+void TimeLog_free(T *log)
+{
+        assert(log != NULL && *log != NULL);
+        fclose((*log)->fp);
+        FREE(*log);
+}
+
+/**********TimeLog_record********
+ * About: This function writes the record of one image to the log
+ * Inputs:
+ * T log: the log
+ * struct phaseTimes *phases: the phases of the image
+ * const char *inputFile: name of the input file; NULL for stdin
+ * const char *operation: name of the operation
+ * int threads: number of threads used
+ * Return: none
+ * Expects
+ * - log, phases, and operation to be nonnull; throws CRE otherwise
+************************/
+void TimeLog_record(T log, struct phaseTimes *phases, const char *inputFile,
+                    const char *operation, int threads)
+{
+        assert(log != NULL && phases != NULL && operation != NULL);
+        int width = phases->width;
+        int height = phases->height;
+        double pixels = (double)width * height;
+        double total = phases->elapsed;
+        for (int p = 0; p < phaseCount && phases->elapsed == 0; p++)
+                total += phases->wall[p];
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        double timestamp = now.tv_sec + now.tv_nsec / 1e9;
+
+        /* build the whole record first, then write it in one go */
+        char *record = NULL;
+        size_t length = 0;
+        FILE *fp = open_memstream(&record, &length);
+        assert(fp != NULL);
+
+        if (log->csv) {
+                fprintf(fp, "%.3f,", timestamp);
+                csvString(fp, inputFile == NULL ? "-" : inputFile);
+                fprintf(fp, ",");
+                csvString(fp, operation);
+                fprintf(fp, ",%d,%d,%.0f,%d", width, height, pixels, threads);
+                for (int p = 0; p < phaseCount; p++)
+                        fprintf(fp, ",%.0f,%.0f,%.0f,%.0f,%.0f",
+                                phases->wall[p], phases->cpu[p],
+                                phases->thread[p],
+                                perSecond(pixels, phases->wall[p]),
+                                perSecond(phases->bytes[p], phases->wall[p]));
+                for (int p = 0; p < phaseCount; p++)
+                        counterFields(fp, log, phases, p, pixels);
+                fprintf(fp, ",%.0f\n", total);
+        } else {
+                fprintf(fp, "{\"timestamp\": %.3f, \"file\": ", timestamp);
+                if (inputFile == NULL)
+                        fprintf(fp, "null");
+                else
+                        jsonString(fp, inputFile);
+                fprintf(fp, ", \"operation\": ");
+                jsonString(fp, operation);
+                fprintf(fp, ", \"width\": %d, \"height\": %d, "
+                            "\"pixels\": %.0f, \"threads\": %d, "
+                            "\"phases\": {", width, height, pixels, threads);
+                for (int p = 0; p < phaseCount; p++) {
+                        fprintf(fp, "%s\"%s\": {\"wall_ns\": %.0f, "
+                                    "\"cpu_ns\": %.0f, \"thread_ns\": %.0f, "
+                                    "\"pixels_per_s\": %.0f, "
+                                    "\"bytes_per_s\": %.0f",
+                                p == 0 ? "" : ", ", phaseNames[p],
+                                phases->wall[p], phases->cpu[p],
+                                phases->thread[p],
+                                perSecond(pixels, phases->wall[p]),
+                                perSecond(phases->bytes[p], phases->wall[p]));
+                        if (log->counters)
+                                counterFields(fp, log, phases, p, pixels);
+                        fprintf(fp, "}");
+                }
+                fprintf(fp, "}, \"total_wall_ns\": %.0f}\n", total);
+        }
+        fclose(fp);
+
+        flockfile(log->fp);
+        fwrite(record, 1, length, log->fp);
+        fflush(log->fp);
+        funlockfile(log->fp);
+        free(record);
+}
+
+/**********phasesInit********
+ * About: This function sets every phase of an image to zero and makes the
+ *        timer of the phases, with the hardware counters if the log has them
+ * Inputs:
+ * struct phaseTimes *phases: the phases to set up
+ * T log: the log the phases will be recorded to
+ * Return: none
+ * Expects
+ * - phases to be nonnull; throws CRE otherwise
+ * Note: The user should call phasesFree when done
+************************/
+void phasesInit(struct phaseTimes *phases, T log)
+{
+        assert(phases != NULL && log != NULL);
+        memset(phases, 0, sizeof(*phases));
+        phases->timer = CPUTime_New();
+        assert(phases->timer != NULL);
+
+        /* the counters follow the thread that opens them; work done by
+         * other threads is counted by phases of their own (see phasesAdd
+         * and phasesAddCounts) */
+        if (log->counters)
+                phases->counterMask = CPUTime_EnableCounters(phases->timer);
+}
+
+/**********phasesFree********
+ * About: This function frees the timer of the phases
+ * Inputs:
+ * struct phaseTimes *phases: the phases, set up by phasesInit
+ * Return: none
+************************/
+void phasesFree(struct phaseTimes *phases)
+{
+        assert(phases != NULL);
+        CPUTime_Free(&phases->timer);
+}
+
+/**********phaseStart********
+ * About: This function starts measuring a phase
+ * Inputs:
+ * struct phaseTimes *phases: the phases of the image; NULL if the user did
+ * not ask for timing, which makes this function do nothing
+ * Return: none
+************************/
+void phaseStart(struct phaseTimes *phases)
+{
+        if (phases != NULL)
+                CPUTime_Start(phases->timer);
+}
+
+/**********phaseStop********
+ * About: This function adds the times since phaseStart, and the bytes the
+ *        phase handled, to the given phase
+ * Inputs:
+ * struct phaseTimes *phases: the phases of the image; may be NULL like for
+ * phaseStart
+ * int phase: the phase, from phaseRead to phaseFree
+ * double bytes: bytes read, allocated, copied, written, or freed
+ * Return: none
+ * Expects
+ * - phase to be a phase; throws CRE otherwise
+************************/
+void phaseStop(struct phaseTimes *phases, int phase, double bytes)
+{
+        assert(phase >= 0 && phase < phaseCount);
+        if (phases == NULL)
+                return;
+        if (phases->counterMask != 0) {
+                double counts[CPUTime_counterCount];
+                CPUTime_StopCounters(phases->timer, counts);
+                for (int c = 0; c < CPUTime_counterCount; c++)
+                        phases->counts[phase][c] += counts[c];
+        }
+        phases->cpu[phase] += CPUTime_Stop(phases->timer);
+        phases->thread[phase] += CPUTime_StopThread(phases->timer);
+        phases->wall[phase] += CPUTime_StopWall(phases->timer);
+        phases->bytes[phase] += bytes;
+}
+
+/**********phaseSize********
+ * About: This function records the dimensions of the resulting image
+ * Inputs:
+ * struct phaseTimes *phases: the phases of the image; may be NULL like for
+ * phaseStart
+ * int width, int height: dimensions of the resulting image
+ * Return: none
+************************/
+void phaseSize(struct phaseTimes *phases, int width, int height)
+{
+        if (phases != NULL) {
+                phases->width = width;
+                phases->height = height;
+        }
+}
+
+/**********phasesAdd********
+ * About: This function adds the sums of some phases to the ones of an image,
+ *        e.g. those a thread measured for its part of the image
+ * Inputs:
+ * struct phaseTimes *phases: the phases of the image; may be NULL like for
+ * phaseStart
+ * const struct phaseTimes *more: the phases to add
+ * Return: none
+ * Expects
+ * - more to be nonnull; throws CRE otherwise
+************************/
+void phasesAdd(struct phaseTimes *phases, const struct phaseTimes *more)
+{
+        assert(more != NULL);
+        if (phases == NULL)
+                return;
+        for (int p = 0; p < phaseCount; p++) {
+                phases->wall[p] += more->wall[p];
+                phases->cpu[p] += more->cpu[p];
+                phases->thread[p] += more->thread[p];
+                phases->bytes[p] += more->bytes[p];
+                for (int c = 0; c < CPUTime_counterCount; c++)
+                        phases->counts[p][c] += more->counts[p][c];
+        }
+}
+
+/**********phasesAddCounts********
+ * About: This function adds the hardware counts of some phases to the ones
+ *        of an image, but not their times; e.g. those of a worker that helped
+ *        with a phase the calling thread timed on the clock
+ * Inputs:
+ * struct phaseTimes *phases: the phases of the image; may be NULL like for
+ * phaseStart
+ * const struct phaseTimes *more: the phases whose counts to add
+ * Return: none
+ * Expects
+ * - more to be nonnull; throws CRE otherwise
+************************/
+void phasesAddCounts(struct phaseTimes *phases, const struct phaseTimes *more)
+{
+        assert(more != NULL);
+        if (phases == NULL)
+                return;
+        for (int p = 0; p < phaseCount; p++)
+                for (int c = 0; c < CPUTime_counterCount; c++)
+                        phases->counts[p][c] += more->counts[p][c];
+}
+
+/**********jsonString********
+ * About: This function writes a string as a JSON string
+ * Inputs:
+ * FILE *fp: where to write
+ * const char *string: the string
+ * Return: none
+************************/
+static void jsonString(FILE *fp, const char *string)
+{
+        putc('"', fp);
+        for (const unsigned char *c = (const unsigned char *)string; *c;
+             c++) {
+                if (*c == '"' || *c == '\\')
+                        fprintf(fp, "\\%c", *c);
+                else if (*c < 0x20)
+                        fprintf(fp, "\\u%04x", *c);
+                else
+                        putc(*c, fp);
+        }
+        putc('"', fp);
+}
+
+/**********csvString********
+ * About: This function writes a string as a quoted CSV field
+ * Inputs:
+ * FILE *fp: where to write
+ * const char *string: the string
+ * Return: none
+************************/
+static void csvString(FILE *fp, const char *string)
+{
+        putc('"', fp);
+        for (const char *c = string; *c; c++) {
+                if (*c == '"')
+                        putc('"', fp);
+                putc(*c, fp);
+        }
+        putc('"', fp);
+}
+
+/**********csvHeader********
+ * About: This function makes the header line of a CSV log
+ * Inputs: none
+ * Return: the line, with its newline
+ * Note: The user should free the line when done
+************************/
+static char *csvHeader(void)
+{
+        char *header = NULL;
+        size_t length = 0;
+        FILE *fp = open_memstream(&header, &length);
+        assert(fp != NULL);
+
+        fprintf(fp, "timestamp,file,operation,width,height,pixels,threads");
+        for (int p = 0; p < phaseCount; p++)
+                fprintf(fp, ",%s_wall_ns,%s_cpu_ns,%s_thread_ns,"
+                            "%s_pixels_per_s,%s_bytes_per_s",
+                        phaseNames[p], phaseNames[p], phaseNames[p],
+                        phaseNames[p], phaseNames[p]);
+        for (int p = 0; p < phaseCount; p++) {
+                for (int c = 0; c < CPUTime_counterCount; c++)
+                        fprintf(fp, ",%s_%s_per_pixel", phaseNames[p],
+                                counterNames[c]);
+                fprintf(fp, ",%s_ipc", phaseNames[p]);
+        }
+        fprintf(fp, ",total_wall_ns\n");
+        fclose(fp);
+        return header;
+}
+
+/**********sameHeader********
+ * About: This function tells whether a CSV log starts with a header line
+ * Inputs:
+ * FILE *fp: the log, opened for reading and appending
+ * const char *header: the line, with its newline
+ * Return: true if the first line of the log is the header; false otherwise
+************************/
+static bool sameHeader(FILE *fp, const char *header)
+{
+        char *line = NULL;
+        size_t size = 0;
+        rewind(fp);
+        ssize_t length = getline(&line, &size, fp);
+        bool same = length >= 0 && strcmp(line, header) == 0;
+        free(line);
+        return same;
+}
+
+/**********counterFields********
+ * About: This function writes the counters of a phase per pixel, and the
+ *        instructions per cycle, as CSV fields or JSON members; every field
+ *        is empty when the image was timed without counters
+ * Inputs:
+ * FILE *fp: where to write
+ * T log: the log, for its format
+ * struct phaseTimes *phases: the phases of the image
+ * int phase: the phase to write
+ * double pixels: the number of pixels of the image
+ * Return: none
+************************/
+static void counterFields(FILE *fp, T log, struct phaseTimes *phases,
+                          int phase, double pixels)
+{
+        double *counts = phases->counts[phase];
+        for (int c = 0; c < CPUTime_counterCount; c++) {
+                if (!log->csv)
+                        fprintf(fp, ", \"%s_per_pixel\": ", counterNames[c]);
+                counterValue(fp, log, phases->counterMask & (1 << c),
+                             pixels > 0 ? counts[c] / pixels : 0);
+        }
+
+        int both = (1 << CPUTime_cycles) | (1 << CPUTime_instructions);
+        if (!log->csv)
+                fprintf(fp, ", \"ipc\": ");
+        counterValue(fp, log, (phases->counterMask & both) == both,
+                     counts[CPUTime_cycles] > 0 ? 
+                     counts[CPUTime_instructions] / counts[CPUTime_cycles] :
+                     0);
+}
+
+/**********counterValue********
+ * About: This function writes one counter value: a CSV field, or the value
+ *        of a JSON member. A counter the machine does not have is written
+ *        as an empty field or null.
+ * Inputs:
+ * FILE *fp: where to write
+ * T log: the log, for its format
+ * bool known: whether the counter was read
+ * double value: the value
+ * Return: none
+************************/
+static void counterValue(FILE *fp, T log, bool known, double value)
+{
+        if (log->csv)
+                putc(',', fp);
+        if (known)
+                fprintf(fp, "%.4f", value);
+        else if (!log->csv)
+                fprintf(fp, "null");
+}
+
+/**********perSecond********
+ * About: This function turns an amount done in some nanoseconds into a
+ *        rate
+ * Inputs:
+ * double amount: pixels or bytes
+ * double nanoseconds: the time taken
+ * Return: the amount per second; 0 if no time was taken
+************************/
+static double perSecond(double amount, double nanoseconds)
+{
+        return nanoseconds > 0 ? amount / nanoseconds * 1e9 : 0;
+}
@@ -0,0 +1,76 @@
+/*
+ *     timing.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the phase timing asked for with -time. Every
+ *            image is split into phases (read, allocate, transform, write,
+ *            free), and each phase adds up its wall-clock, process CPU, and
+ *            calling-thread CPU time and the bytes it handled. When the image
+ *            is done, the phases are written to a TimeLog_T as one record: a
+ *            JSON object on one line, or a CSV row if the file name ends in
+ *            ".csv".
+ *
+ *            A log made with counters also reads the hardware counters of
+ *            cputiming.h around every phase and adds them to the record per
+ *            pixel, with the instructions per cycle, so the record shows why
+ *            a way of copying was fast or slow, not only that it was. The
+ *            counters of every thread that works on a phase are added up.
+ */
+
+#ifndef TIMING_INCLUDED
+#define TIMING_INCLUDED
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "cputiming.h"
+
+/* the phases of an image, in the order of the records */
+#define phaseRead 0
+#define phaseAllocate 1
+#define phaseTransform 2
+#define phaseWrite 3
+#define phaseFree 4
+#define phaseCount 5
+
+/**********struct phaseTimes********
+ * About: This struct holds the sums of the phases of one image, in
+ *        nanoseconds and bytes, the timer of the phase being measured, and
+ *        the dimensions of the resulting image. counterMask has a bit for
+ *        every hardware counter being read (0 for none), and counts their
+ *        sums per phase. elapsed is the wall time of the whole image when
+ *        its phases ran at the same time on different threads, and is then
+ *        recorded as the total instead of the sum of the phases.
+************************/
+struct phaseTimes {
+        CPUTime_T timer;
+        int width;
+        int height;
+        double elapsed; /* 0 when the phases ran one after the other */
+        double wall[phaseCount];
+        double cpu[phaseCount];
+        double thread[phaseCount];
+        double bytes[phaseCount];
+        int counterMask;
+        double counts[phaseCount][CPUTime_counterCount];
+};
+
+typedef struct TimeLog_T *TimeLog_T;
+
+extern TimeLog_T TimeLog_new(const char *name, bool counters);
+extern void TimeLog_free(TimeLog_T *log);
+extern void TimeLog_record(TimeLog_T log, struct phaseTimes *phases,
+                           const char *inputFile, const char *operation,
+                           int threads);
+
+extern void phasesInit(struct phaseTimes *phases, TimeLog_T log);
+extern void phasesFree(struct phaseTimes *phases);
+extern void phaseStart(struct phaseTimes *phases);
+extern void phaseStop(struct phaseTimes *phases, int phase, double bytes);
+extern void phaseSize(struct phaseTimes *phases, int width, int height);
+extern void phasesAdd(struct phaseTimes *phases,
+                      const struct phaseTimes *more);
+extern void phasesAddCounts(struct phaseTimes *phases,
+                            const struct phaseTimes *more);
+
+#endif
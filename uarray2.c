@@ -14,21 +14,22 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <mem.h>
-#include <uarray2.h>
-#include <uarray.h>
+#include "uarray2.h"
+#include "slab.h"
 #include <except.h>
 
 #define T2 UArray2_T
 
 /**********struct T2********
- * About: This struct holds a UArray instance that represents a 2D array and
- *        the row, column, and element size information for that array.
+ * About: This struct holds the slab that stores the 2D array in row major
+ *        order and the row, column, and element size information for that
+ *        array.
 ************************/
 struct T2 {
         int rows; /* number of rows in in the 2D array, at least 1 */
         int cols; /* number of cols in in the 2D array, at least 1 */
         int elmSize; /* number of elements in the 2D array */
-        UArray_T data; /* UArray_T representing the 2D array*/
+        struct slab data; /* the elements, starting on a cache line */
 };
 
 
@@ -66,9 +67,8 @@ T2 UArray2_new(int col, int row, int elementSize)
         array2D->cols = col;
         array2D->elmSize = elementSize;
 
-        /* creating the array */
-        array2D->data = UArray_new(row * col, elementSize);
-        assert(array2D->data != NULL);
+        /* creating the array; every element starts out zero */
+        slabAlloc(&array2D->data, (size_t)row * col * elementSize);
 
         return array2D;
 }
@@ -140,7 +140,8 @@ void *UArray2_at(T2 array, int col, int row)
 
         assert(col >= 0 && col < UArray2_width(array));
         assert(row >= 0 && row < UArray2_height(array));
-        return UArray_at(array->data, row * array->cols + col);
+        return array->data.cells + ((long)row * array->cols + col) * 
+                                   array->elmSize;
 }
 
 /**********UArray2_map_row_major********
@@ -194,6 +195,31 @@ void UArray2_map_col_major(T2 array,
         }
 }
 
+/**********UArray2_reshape********
+ * About: This function gives the 2D UArray new dimensions without moving any
+ *        element. The elements are stored in row major order, so the element
+ *        at (col, row) before the call is the one at index row * cols + col
+ *        of the row major order after it.
+ * Inputs:
+ * T2 array: struct to store the content of the given data in 2D UArray
+ * int col: the new number of columns
+ * int row: the new number of rows
+ * Return: none
+ * Expects
+ * - that array is non-null, throws a CRE otherwise
+ * - that col and row are at least 0 and col * row equals the number of
+ *   elements of the array, throws a CRE otherwise
+************************/
+void UArray2_reshape(T2 array, int col, int row)
+{
+        assert(array != NULL);
+        assert(col >= 0 && row >= 0);
+        assert((long)col * row == (long)array->cols * array->rows);
+
+        array->cols = col;
+        array->rows = row;
+}
+
 /**********UArray2_free********
  * About: This function frees the memory allocated to the 2D UArray and the T2
  *        struct
@@ -207,9 +233,8 @@ void UArray2_free(T2 *array)
 {
         assert(array != NULL);
 
-        /* freeing the UArray held by the struct */
-        UArray_T arrayToFree = (*array)->data;
-        UArray_free(&arrayToFree);
+        /* freeing the slab held by the struct */
+        slabFree(&(*array)->data);
 
         /* freeing the struct */
         FREE(*array);
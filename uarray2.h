@@ -7,7 +7,8 @@
  *     store the data. It also has functions that helps the client to get the 
  *     width, height, and element size information about the array, traverse 
  *     the array in row major and column major order and access to an element 
- *     at a certain location.
+ *     at a certain location. An array can also be given new dimensions with
+ *     the same number of elements, which in-place rotations need.
  *     
  */
 
@@ -28,6 +29,7 @@ extern void UArray2_map_row_major(T2 array, void apply(int col,
 extern void UArray2_map_col_major(T2 array, void apply(int col, 
                                   int row, T2 array, void *p1, 
                                   void *p2), void *cl);
+extern void UArray2_reshape(T2 array, int col, int row);
 extern void UArray2_free(T2 *array);
 
 #undef T2
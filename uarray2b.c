@@ -6,17 +6,21 @@
  *     About: This file can be used to create a 2D UArray2b where a client can
  *     store data in a 2D array divided into blocks. It also has functions that
  *     helps the client initialize each block size to 64KB (given element size
- *     is under 64KB), to get the width, height, element size, and block size 
+ *     is under 64KB) or to fit the caches of the machine (see cacheblock.h),
+ *     to get the width, height, element size, and block size 
  *     information about the array, traverse the array in block major order, 
  *     access to an element at a certain location, and free the UArray2b.
+ *     All the blocks are stored in one cache-line aligned slab: block b of
+ *     the grid (counted in row major order) starts at cell b * blockSize^2,
+ *     and its cells are in row major order, so finding a cell is arithmetic.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
-#include <uarray2b.h>
-#include <uarray2.h>
-#include <uarray.h>
+#include "uarray2b.h"
+#include "cacheblock.h"
+#include "slab.h"
 #include <mem.h>
 #include <math.h>
 
@@ -26,34 +30,25 @@
 #define minBlockSize 1
 
 /**********struct T********
- * About: This struct holds a UArray2_T instance that holds UArray_Ts, and
- *        row, col, blockSize, and elmSize information of the UArray2_T.
+ * About: This struct holds the slab with all the blocks, the layout of the
+ *        grid of blocks, and row, col, blockSize, and elmSize information.
 ************************/
 struct T {
         int rows; /* number of rows in in the 2D array */
         int cols; /* number of cols in in the 2D array */
         int blockSize; /* sqrt of the number of cells in a block */
         int elmSize; /* number of elements in the 2D array */
-        UArray2_T data; /* UArray2_T holding UArray_Ts */
-};
-
-/**********struct mapParameters********
- * About: This struct hold the parameters, which are UArray2b_T, apply 
- *        function, cl pointer, that needs to be passed to the insideBlockMap 
- *        function
-************************/
-struct mapParameters {
-        T array2b;
-        void (*apply)(int col, int row, T array2b, void *elem, void *cl);
-        void *cl;
+        int blocksWide; /* number of blocks in a row of the grid */
+        int blocksHigh; /* number of blocks in a column of the grid */
+        struct slab slab; /* the cells, block 0 first */
 };
 
 /* function declarations */
-void blockCreator(int col, int row, UArray2_T array, void *elem, 
-                  void *structT);
-void blockFree(int col, int row, UArray2_T array, void *elem, void *p2);
-void insideBlockMap(int col, int row, UArray2_T array, void *elem,
-                    void *mapStruct);
+static T newBlocked(int width, int height, int size, int blocksize,
+                    void *cells);
+static void mapOneBlock(T array2b, int blockCol, int blockRow, 
+                 void apply(int col, int row, T array2b, void *elem, void *cl),
+                 void *cl);
 
 
 /**********UArray2b_new********
@@ -84,6 +79,48 @@ T UArray2b_new(int width, int height, int size, int blocksize)
         assert(width >= 0 && height >= 0 && size >= 0 && 
                blocksize >= minBlockSize);
 
+        return newBlocked(width, height, size, blocksize, NULL);
+}
+
+/**********UArray2b_new_from********
+ * About: This function makes a UArray2b whose blocks are memory the caller
+ *        already holds, laid out as the blocks of a UArray2b: the blocks
+ *        of the grid in row-major order, each block as blocksize rows of
+ *        blocksize cells, the cells past the right and bottom edges
+ *        included. The memory is neither copied nor cleared.
+ * Inputs:
+ * int width, int height, int size, int blocksize: same as UArray2b_new
+ * void *cells: the first cell of block 0
+ * Return: a struct holding a 2D array with blocks
+ * Expects
+ * - the same as UArray2b_new, and cells to be nonnull; throws cre
+ *   otherwise
+ * Note: UArray2b_free frees the struct but not the cells, which must stay
+ * valid until then.
+************************/
+T UArray2b_new_from(int width, int height, int size, int blocksize,
+                    void *cells)
+{
+        assert(width >= 0 && height >= 0 && size >= 0 && 
+               blocksize >= minBlockSize && cells != NULL);
+
+        return newBlocked(width, height, size, blocksize, cells);
+}
+
+/**********newBlocked********
+ * About: This function creates the T struct and the slab for all the blocks.
+ *        The slab comes from slabAlloc, so every cell starts out zero like
+ *        the cells of a UArray, and large slabs are zero pages the kernel
+ *        only maps when they are first touched.
+ * Inputs: same as UArray2b_new, and
+ * void *cells: the blocks, held by the caller; NULL to allocate them
+ * Return: a struct holding a 2D array with blocks
+ * Expects
+ * - the arguments to be checked by the caller
+************************/
+static T newBlocked(int width, int height, int size, int blocksize,
+                    void *cells)
+{
         /* creating an instance of the struct T in malloc */
         T array2D;
         NEW(array2D);
@@ -94,56 +131,20 @@ T UArray2b_new(int width, int height, int size, int blocksize)
         array2D->cols = width;
         array2D->elmSize = size;
         array2D->blockSize = blocksize;
-
-        /* creating the UArray2_T */
-        array2D->data = UArray2_new(ceil((float)width / (float)blocksize), 
-                        ceil((float)height / (float)blocksize), 
-                        sizeof(UArray_T));
-        assert(array2D->data != NULL);
-
-        /* filling the UArray2_T with UArray_Ts */
-        UArray2_map_row_major(array2D->data, blockCreator, array2D);
+        array2D->blocksWide = (width + blocksize - 1) / blocksize;
+        array2D->blocksHigh = (height + blocksize - 1) / blocksize;
+
+        /* allocating one slab for all the blocks */
+        size_t bytes = (size_t)array2D->blocksWide * array2D->blocksHigh * 
+                       blocksize * blocksize * size;
+        if (cells != NULL)
+                slabWrap(&array2D->slab, cells);
+        else
+                slabAlloc(&array2D->slab, bytes);
 
         return array2D;
 }
 
-/**********blockCreator********
- * About: This function is used to initialize and assign a UArray structure to
- *        each cell of a given UArray2
- * Inputs:
- * int col: integer value that represents number of columns in the 2D array  
- *          that the T struct holds
- * int row: integer value that represents number of rows in the 2D array 
- *          that the T struct holds
- * UArray2_T array: a 2D array
- * void *elem: pointer to the current element in the cell being visited in the 
- *             2D array
- * void *p2: pointer to a UArray2b struct
- * Return: none
- * Expects
- * - array and p2 to be non-null, throws cre otherwise
- * Note: If this function is called by the user, it's user's responsibility to
- * free the UArray_T created in this function.
-************************/
-void blockCreator(int col, int row, UArray2_T array, void *elem, void *structT)
-{
-        (void) col;
-        (void) row;
-
-        /* asserting the expectations */
-        assert(array != NULL && structT != NULL);
-
-        /* initializing UArray with blockSize * blockSize as the size */
-        T array2D = structT;
-        int newBlockSize = array2D->blockSize * array2D->blockSize;
-        UArray_T newBlock = UArray_new(newBlockSize, array2D->elmSize);
-        assert(newBlock != NULL);
-
-        /* placing the new UArray to the current cell */
-        UArray_T *currentBlock = elem;
-        *currentBlock = newBlock;
-}
-
 /**********UArray2b_new_64K_block********
  * About: This function initializes a T struct such that a block will fit into 
  *        64KB of RAM, and assigns the given values such as width, height, 
@@ -170,88 +171,51 @@ T UArray2b_new_64K_block(int width, int height, int size)
         /* asserts the expectation for col, row, and elementSize to be > 0 */
         assert(width >= 0 && height >= 0 && size >= 0);
 
-        /* creating an instance of the struct T in malloc */
-        T array2D;
-        NEW(array2D);
-        assert(array2D != NULL);
-
-        /* initializing the attributes of array2D */
-        array2D->rows = height;
-        array2D->cols = width;
-        array2D->elmSize = size;
-
         /* if the block doesn't fit into 64KB, the size is assigned to 1 */
+        int blocksize;
         if (size > blockMem * KB)
-                array2D->blockSize = minBlockSize;
+                blocksize = minBlockSize;
         else
-                array2D->blockSize = sqrt(blockMem * KB / size);
-        
-        /* creating the UArray2_T */
-        array2D->data = UArray2_new(
-                        ceil((float)width / (float)array2D->blockSize), 
-                        ceil((float)height / (float)array2D->blockSize), 
-                        sizeof(UArray_T));
-        
-        assert(array2D->data != NULL);
+                blocksize = sqrt(blockMem * KB / size);
 
-        /* filling the UArray2_T with UArray_Ts */
-        UArray2_map_row_major(array2D->data, blockCreator, array2D);
-
-        return array2D;
+        return newBlocked(width, height, size, blocksize, NULL);
 }
 
-/**********UArray2b_free********
- * About: This function frees the memory allocated to the UArray2_T and
- *        UArray_T instances located in UArray2_T
- * Inputs: 
- * T *array2b: address of the UArray2_T instance to store the content of data
- * Return: none
+/**********UArray2b_new_cache_block********
+ * About: This function initializes a T struct whose block size is chosen
+ *        for the caches of this machine, so that a block of this array and
+ *        a block of another one fit in the L2 cache together
+ * Inputs:
+ * int width, int height, int size: same as UArray2b_new_64K_block
+ * Return: a struct holding a 2D array with blocks, and information related
+ *         to the structure
  * Expects
- * - that array2b is non-null, throws cre otherwise
+ * - width, height, size to be greater than or equal to 0, throws cre
+ *   otherwise
+ * Note: The user should call UArray2b_free to avoid valgrind after calling 
+ * this function
 ************************/
-void UArray2b_free(T *array2b) 
+T UArray2b_new_cache_block(int width, int height, int size) 
 {
-       
-        assert(*array2b != NULL && array2b != NULL);
-
-        UArray2_T arrayToFree = (*array2b)->data;
-
-        /* traverse the UArray2 held by the struct and free blocks */
-        UArray2_map_row_major(arrayToFree, blockFree, NULL);
-
-        /* freeing the UArray2 held by the struct */
-        UArray2_free(&arrayToFree);
-
-        /* freeing the struct */
-        FREE(*array2b);
+        assert(width >= 0 && height >= 0 && size >= 0);
+        return newBlocked(width, height, size, cacheBlocksize(size), NULL);
 }
 
-/**********blockFree********
- * About: This function frees the memory allocated to the UArray_T instances 
- *        located in UArray2_T
+/**********UArray2b_free********
+ * About: This function frees the slab holding the blocks and the T struct
  * Inputs: 
- * int col: integer value that represents number of columns in the 2D array  
- *          that the T struct holds
- * int row: integer value that represents number of rows in the 2D array 
- *          that the T struct holds
- * UArray2_T array: a 2D array
- * void *elem: pointer to an current element visited  
- * void *p2: unused pointer
+ * T *array2b: address of the UArray2b instance to store the content of data
  * Return: none
  * Expects
- * - that array is non-null, throws CRE otherwise
+ * - that array2b is non-null, throws cre otherwise
 ************************/
-void blockFree(int col, int row, UArray2_T array, void *elem, void *p2) 
+void UArray2b_free(T *array2b) 
 {
-        assert(array != NULL);
-
-        (void) col;
-        (void) row;
-        (void) p2;
+        assert(array2b != NULL && *array2b != NULL);
 
-        /* freeing the UArray_Ts that are located in UArray_2T */
-        UArray_T *currentBlock = elem;
-        UArray_free(currentBlock);
+        /* freeing the slab, then the struct */
+        slabFree(&(*array2b)->slab);
+        FREE(*array2b);
 }
 
 /**********UArray2b_width********
@@ -339,13 +303,14 @@ void *UArray2b_at(T array2b, int column, int row)
 
         int blockSize = array2b->blockSize;
 
-        /* stores the block that the desired value is stored at */
-        UArray_T *block = UArray2_at(array2b->data, column / blockSize, 
-                                     row / blockSize);
+        /* finds the block that the desired value is stored at */
+        size_t block = (size_t)(row / blockSize) * array2b->blocksWide + 
+                       column / blockSize;
         
         /* returns the desired value within that block */
-        return UArray_at(*block, blockSize * (row % blockSize) + 
-                         column % blockSize);
+        size_t cell = block * blockSize * blockSize + 
+                      blockSize * (row % blockSize) + column % blockSize;
+        return array2b->slab.cells + cell * array2b->elmSize;
 }
 
 /**********UArray2b_map********
@@ -366,55 +331,81 @@ void UArray2b_map(T array2b,
 {
         assert(array2b != NULL);
 
-        /* initializing a struct to hold info to be used in mapping */
-        struct mapParameters prm = {array2b, apply, cl};
-
-        /* visiting each block held by the UArray2 */
-        UArray2_map_row_major(array2b->data, insideBlockMap, &prm);
-
+        /* visiting each block of the grid in row major order */
+        for (int blockRow = 0; blockRow < array2b->blocksHigh; blockRow++) {
+                for (int blockCol = 0; blockCol < array2b->blocksWide; 
+                     blockCol++) {
+                        mapOneBlock(array2b, blockCol, blockRow, apply, cl);
+                }
+        }
 }
 
-/**********insideBlockMap********
- * About: This function traverses the blocks (UArrayTs) such that every cell
- *        in one block are visited and apply function is implemented on each 
- *        element before moving to another block 
+/**********UArray2b_map_block********
+ * About: This function visits every used cell of a single block and applies
+ *        the apply function to it, in the same order as UArray2b_map does
+ *        inside a block. Different blocks hold different cells, so they can be
+ *        visited at the same time by different threads.
  * Inputs:
- * int col: integer value that represents number of columns in the 2D array  
- *          that the T struct holds
- * int row: integer value that represents number of rows in the 2D array 
- *          that the T struct holds
- * UArray2_T array: a 2D array
- * void *elem: pointer to an current element visited  
- * void *p2: mapParameters instance which holds the values T array2b, the
- *           apply function and the *cl pointer
+ * T array2b: struct to store the content of the given data in 2D
+ * int blockCol: column of the block in the grid of blocks
+ * int blockRow: row of the block in the grid of blocks
+ * apply function: the function to be applied on the elements of the block
+ * cl pointer: client specific pointer input
  * Return: none
  * Expects
  * - non-null T array2b, throws cre otherwise
+ * - blockCol and blockRow to be inside the grid of blocks, throws cre
+ *   otherwise
 ************************/
-void insideBlockMap(int col, int row, UArray2_T array, void *elem, 
-                    void *mapStruct) 
+void UArray2b_map_block(T array2b, int blockCol, int blockRow,
+                 void apply(int col, int row, T array2b, void *elem, void *cl),
+                 void *cl)
 {
-        assert(array != NULL && mapStruct != NULL);
-        
-        /* casting void parameters to be dereferenced */
-        UArray_T *currentBlock = elem;
-        struct mapParameters *prm = mapStruct;
-
-        /* recording block size, number of rows, and number of cols in total */
-        int blockSize = (prm->array2b)->blockSize;
-        int colSize = (prm->array2b)->cols;
-        int rowSize = (prm->array2b)->rows;
-        
-        /* visiting all cells in the block */
-        for (int elt = 0; elt < UArray_length(*currentBlock); elt++) {
-                /* calculating col,row indices in 2D array for current elt */
-                int col2b = col * blockSize + elt % blockSize;
-                int row2b = row * blockSize + elt / blockSize;
-
-                /* apply given function if the cell is not unused */
-                if (col2b < colSize && row2b < rowSize) {
-                        prm->apply(col2b, row2b, prm->array2b, 
-                           UArray_at(*currentBlock, elt), prm->cl);
+        assert(array2b != NULL);
+        assert(blockCol >= 0 && blockCol < array2b->blocksWide);
+        assert(blockRow >= 0 && blockRow < array2b->blocksHigh);
+
+        mapOneBlock(array2b, blockCol, blockRow, apply, cl);
+}
+
+/**********mapOneBlock********
+ * About: This function traverses one block such that every cell in it is
+ *        visited in row major order and apply function is implemented on 
+ *        each element, skipping the unused cells past the right and bottom
+ *        edges of the array
+ * Inputs:
+ * T array2b: struct to store the content of the given data in 2D
+ * int blockCol: column of the block in the grid of blocks
+ * int blockRow: row of the block in the grid of blocks
+ * apply function: the function to be applied on the elements of the block
+ * cl pointer: client specific pointer input
+ * Return: none
+************************/
+static void mapOneBlock(T array2b, int blockCol, int blockRow, 
+                 void apply(int col, int row, T array2b, void *elem, void *cl),
+                 void *cl)
+{
+        /* recording block size, and the used part of the block */
+        int blockSize = array2b->blockSize;
+        int col0 = blockCol * blockSize;
+        int row0 = blockRow * blockSize;
+        int cols = array2b->cols - col0 < blockSize ? 
+                   array2b->cols - col0 : blockSize;
+        int rows = array2b->rows - row0 < blockSize ? 
+                   array2b->rows - row0 : blockSize;
+
+        /* first cell of the block in the slab */
+        size_t block = (size_t)blockRow * array2b->blocksWide + blockCol;
+        char *cells = array2b->slab.cells + 
+                      block * blockSize * blockSize * array2b->elmSize;
+
+        /* visiting all used cells in the block */
+        for (int row = 0; row < rows; row++) {
+                char *elem = cells + (size_t)row * blockSize * 
+                             array2b->elmSize;
+                for (int col = 0; col < cols; col++) {
+                        apply(col0 + col, row0 + row, array2b, elem, cl);
+                        elem += array2b->elmSize;
                 }
         }
 }
@@ -0,0 +1,37 @@
+/*
+ *     uarray2b.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file can be used to create a 2D UArray2b where a client can
+ *     store data in a 2D array divided into blocks. Besides the functions to
+ *     create, free, and describe the array, access an element, and traverse
+ *     the array in block major order, it can traverse a single block so that
+ *     different blocks can be visited by different threads.
+ */
+
+#ifndef UARRAY2B_INCLUDED
+#define UARRAY2B_INCLUDED
+
+#define T UArray2b_T
+typedef struct T *T;
+
+extern T UArray2b_new(int width, int height, int size, int blocksize);
+extern T UArray2b_new_64K_block(int width, int height, int size);
+extern T UArray2b_new_cache_block(int width, int height, int size);
+extern T UArray2b_new_from(int width, int height, int size, int blocksize,
+                           void *cells);
+extern void UArray2b_free(T *array2b);
+extern int UArray2b_width(T array2b);
+extern int UArray2b_height(T array2b);
+extern int UArray2b_size(T array2b);
+extern int UArray2b_blocksize(T array2b);
+extern void *UArray2b_at(T array2b, int column, int row);
+extern void UArray2b_map(T array2b, void apply(int col, int row, T array2b, 
+                         void *elem, void *cl), void *cl);
+extern void UArray2b_map_block(T array2b, int blockCol, int blockRow, 
+                               void apply(int col, int row, T array2b, 
+                               void *elem, void *cl), void *cl);
+
+#undef T
+#endif
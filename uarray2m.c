@@ -0,0 +1,364 @@
+/*
+ *     uarray2m.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the UArray2m, a 2D array stored in Morton
+ *     (Z) order. The array is cut into square tiles of 64 x 64 cells (or the
+ *     longer side rounded up to a power of two, for smaller arrays), stored
+ *     one after the other in row-major order. Inside a tile, the cell of
+ *     (col, row) is found by interleaving the bits of col and row, col in the
+ *     even bits and row in the odd ones, so that the four quadrants of every
+ *     aligned square of the tile are stored one after the other. Only the
+ *     tiles of the last column and row hold padding, less than a tile edge
+ *     on each side.
+ *
+ *     The bits are interleaved with the BMI2 pdep and pext instructions when
+ *     the CPU has them, which is checked once at run time, and with shifts
+ *     and masks otherwise.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <assert.h>
+#include <mem.h>
+#include "uarray2m.h"
+#include "slab.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_BMI2 1
+#include <immintrin.h>
+#endif
+
+#define T UArray2m_T
+#define maxTileBits 6     /* tiles are at most 64 x 64 cells */
+#define evenBits 0x5555555555555555ULL
+
+/**********struct T********
+ * About: This struct holds the slab of cells, the width, height, and
+ *        element size, and the layout: the tiles are 1 << tileBits cells a
+ *        side, tilesAcross of them make a row of tiles, and there are tiles
+ *        of them in all. A tile is also a piece for UArray2m_map_piece.
+************************/
+struct T {
+        int width;
+        int height;
+        int elmSize;
+        int tileBits;
+        int tilesAcross;
+        int tiles;
+        struct slab slab; /* the cells, cell 0 first */
+};
+
+static inline size_t cellIndex(T array2m, int column, int row);
+static void selectBits(void);
+static uint64_t spreadShifts(uint32_t value);
+static uint32_t compactShifts(uint64_t value);
+
+/* the bit interleaving picked by selectBits */
+static pthread_once_t selectOnce = PTHREAD_ONCE_INIT;
+static uint64_t (*spreadBits)(uint32_t value) = spreadShifts;
+static uint32_t (*compactBits)(uint64_t value) = compactShifts;
+
+/**********UArray2m_new********
+ * About: This function creates a UArray2m of the given dimensions, with
+ *        every cell set to zero
+ * Inputs:
+ * int width: number of columns
+ * int height: number of rows
+ * int size: size of an element in bytes
+ * Return: the new array
+ * Expects
+ * - width, height, and size to be at least 0; throws CRE otherwise
+ * Note: The user should call UArray2m_free when done
+************************/
+T UArray2m_new(int width, int height, int size)
+{
+        assert(width >= 0 && height >= 0 && size >= 0);
+        pthread_once(&selectOnce, selectBits);
+        T array2m;
+        NEW(array2m);
+        array2m->width = width;
+        array2m->height = height;
+        array2m->elmSize = size;
+
+        /* a small array is one tile, its longer side rounded up to a power
+         * of two */
+        int longer = width > height ? width : height;
+        int bits = 0;
+        while (bits < maxTileBits && (1 << bits) < longer)
+                bits++;
+        array2m->tileBits = bits;
+
+        int edge = 1 << bits;
+        array2m->tilesAcross = (width + edge - 1) / edge;
+        array2m->tiles = array2m->tilesAcross * ((height + edge - 1) / edge);
+
+        size_t cells = (size_t)array2m->tiles << (2 * bits);
+        slabAlloc(&array2m->slab, cells * size);
+        return array2m;
+}
+
+/**********UArray2m_free********
+ * About: This function frees the slab and the T struct
+ * Inputs:
+ * T *array2m: address of the array; set to NULL
+ * Return: none
+ * Expects
+ * - array2m and *array2m to be nonnull; throws CRE otherwise
+************************/
+void UArray2m_free(T *array2m)
+{
+        assert(array2m != NULL && *array2m != NULL);
+        slabFree(&(*array2m)->slab);
+        FREE(*array2m);
+}
+
+/**********UArray2m_width********
+ * About: This function returns the number of columns of the array
+ * Inputs:
+ * T array2m: the array
+ * Return: the width
+ * Expects
+ * - array2m to be nonnull; throws CRE otherwise
+************************/
+int UArray2m_width(T array2m)
+{
+        assert(array2m != NULL);
+        return array2m->width;
+}
+
+/**********UArray2m_height********
+ * About: This function returns the number of rows of the array
+ * Inputs:
+ * T array2m: the array
+ * Return: the height
+ * Expects
+ * - array2m to be nonnull; throws CRE otherwise
+************************/
+int UArray2m_height(T array2m)
+{
+        assert(array2m != NULL);
+        return array2m->height;
+}
+
+/**********UArray2m_size********
+ * About: This function returns the size of an element of the array
+ * Inputs:
+ * T array2m: the array
+ * Return: the element size in bytes
+ * Expects
+ * - array2m to be nonnull; throws CRE otherwise
+************************/
+int UArray2m_size(T array2m)
+{
+        assert(array2m != NULL);
+        return array2m->elmSize;
+}
+
+/**********UArray2m_pieceEdge********
+ * About: This function returns the side of a piece, the tile that
+ *        UArray2m_map_piece visits
+ * Inputs:
+ * T array2m: the array
+ * Return: the number of cells on a side of a piece
+ * Expects
+ * - array2m to be nonnull; throws CRE otherwise
+************************/
+int UArray2m_pieceEdge(T array2m)
+{
+        assert(array2m != NULL);
+        return 1 << array2m->tileBits;
+}
+
+/**********UArray2m_pieces********
+ * About: This function returns the number of pieces (tiles) of the array
+ * Inputs:
+ * T array2m: the array
+ * Return: the number of pieces
+ * Expects
+ * - array2m to be nonnull; throws CRE otherwise
+************************/
+int UArray2m_pieces(T array2m)
+{
+        assert(array2m != NULL);
+        return array2m->tiles;
+}
+
+/**********UArray2m_at********
+ * About: This function returns a pointer to the element at the given column
+ *        and row
+ * Inputs:
+ * T array2m: the array
+ * int column, int row: the place of the element
+ * Return: a pointer to the element
+ * Expects
+ * - array2m to be nonnull and column and row to be inside the array; throws
+ *   CRE otherwise
+************************/
+void *UArray2m_at(T array2m, int column, int row)
+{
+        assert(array2m != NULL);
+        assert(column >= 0 && column < array2m->width);
+        assert(row >= 0 && row < array2m->height);
+        return array2m->slab.cells + cellIndex(array2m, column, row) *
+                                array2m->elmSize;
+}
+
+/**********UArray2m_map********
+ * About: This function visits every element of the array in the order they
+ *        are stored (Morton order) and calls apply on it
+ * Inputs:
+ * T array2m: the array
+ * apply function: the function to call on every element
+ * void *cl: client pointer handed to apply
+ * Return: none
+ * Expects
+ * - array2m to be nonnull; throws CRE otherwise
+************************/
+void UArray2m_map(T array2m, void apply(int col, int row, T array2m,
+                  void *elem, void *cl), void *cl)
+{
+        assert(array2m != NULL);
+        for (int piece = 0; piece < array2m->tiles; piece++)
+                UArray2m_map_piece(array2m, piece, apply, cl);
+}
+
+/**********UArray2m_map_piece********
+ * About: This function visits the elements of one piece in the order they
+ *        are stored and calls apply on them. A piece is a tile, so the cells
+ *        of piece p are the cells p * edge^2 to (p + 1) * edge^2 - 1; the
+ *        padding of the last tiles is skipped. Different pieces hold
+ *        different cells, so they can be visited at the same time by
+ *        different threads.
+ * Inputs:
+ * T array2m: the array
+ * int piece: the piece, from 0 to UArray2m_pieces - 1
+ * apply function: the function to call on every element of the piece
+ * void *cl: client pointer handed to apply
+ * Return: none
+ * Expects
+ * - array2m to be nonnull and piece to be a piece of it; throws CRE
+ *   otherwise
+************************/
+void UArray2m_map_piece(T array2m, int piece, void apply(int col, int row,
+                        T array2m, void *elem, void *cl), void *cl)
+{
+        assert(array2m != NULL);
+        assert(piece >= 0 && piece < array2m->tiles);
+        int bits = array2m->tileBits;
+        size_t pieceCells = (size_t)1 << (2 * bits);
+        size_t first = (size_t)piece * pieceCells;
+
+        /* the tiles are in row-major order */
+        int col0 = (piece % array2m->tilesAcross) << bits;
+        int row0 = (piece / array2m->tilesAcross) << bits;
+
+        int size = array2m->elmSize;
+        char *elem = array2m->slab.cells + first * size;
+        for (size_t cell = 0; cell < pieceCells; cell++, elem += size) {
+                int col = col0 + compactBits(cell);
+                int row = row0 + compactBits(cell >> 1);
+                if (col < array2m->width && row < array2m->height)
+                        apply(col, row, array2m, elem, cl);
+        }
+}
+
+/**********cellIndex********
+ * About: This function finds the cell of a column and row: the tile, then
+ *        the interleaved bits inside it
+ * Inputs:
+ * T array2m: the array
+ * int column, int row: the place, inside the array
+ * Return: the index of the cell in the slab
+************************/
+static inline size_t cellIndex(T array2m, int column, int row)
+{
+        int bits = array2m->tileBits;
+        uint32_t mask = ((uint32_t)1 << bits) - 1;
+        size_t tile = (size_t)(row >> bits) * array2m->tilesAcross +
+                      (column >> bits);
+        return (tile << (2 * bits)) | spreadBits(column & mask) |
+               (spreadBits(row & mask) << 1);
+}
+
+#ifdef HAVE_X86_BMI2
+/**********spreadPdep********
+ * About: This function moves bit i of a value to bit 2i with pdep
+ * Inputs:
+ * uint32_t value: the value
+ * Return: the spread bits
+************************/
+__attribute__((target("bmi2")))
+static uint64_t spreadPdep(uint32_t value)
+{
+        return _pdep_u64(value, evenBits);
+}
+
+/**********compactPext********
+ * About: This function moves bit 2i of a value to bit i with pext
+ * Inputs:
+ * uint64_t value: the value
+ * Return: the compacted bits
+************************/
+__attribute__((target("bmi2")))
+static uint32_t compactPext(uint64_t value)
+{
+        return _pext_u64(value, evenBits);
+}
+#endif
+
+/**********selectBits********
+ * About: This function picks pdep and pext for the bit interleaving if the
+ *        CPU has BMI2, and keeps the shifts and masks otherwise
+ * Inputs: none
+ * Return: none
+************************/
+static void selectBits(void)
+{
+#ifdef HAVE_X86_BMI2
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("bmi2")) {
+                spreadBits = spreadPdep;
+                compactBits = compactPext;
+        }
+#endif
+}
+
+/**********spreadShifts********
+ * About: This function moves bit i of a value to bit 2i
+ * Inputs:
+ * uint32_t value: the value
+ * Return: the spread bits
+************************/
+static uint64_t spreadShifts(uint32_t value)
+{
+        uint64_t x = value;
+        x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+        x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+        x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        x = (x | (x << 2)) & 0x3333333333333333ULL;
+        x = (x | (x << 1)) & evenBits;
+        return x;
+}
+
+/**********compactShifts********
+ * About: This function moves bit 2i of a value to bit i, the opposite of
+ *        spreadShifts; the odd bits are dropped
+ * Inputs:
+ * uint64_t value: the value
+ * Return: the compacted bits
+************************/
+static uint32_t compactShifts(uint64_t value)
+{
+        uint64_t x = value & evenBits;
+        x = (x | (x >> 1)) & 0x3333333333333333ULL;
+        x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0FULL;
+        x = (x | (x >> 4)) & 0x00FF00FF00FF00FFULL;
+        x = (x | (x >> 8)) & 0x0000FFFF0000FFFFULL;
+        x = (x | (x >> 16)) & 0x00000000FFFFFFFFULL;
+        return x;
+}
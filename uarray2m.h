@@ -0,0 +1,39 @@
+/*
+ *     uarray2m.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file can be used to create a 2D UArray2m where a client can
+ *     store data in Morton (Z) order: the array is cut into tiles of up to
+ *     64 x 64 cells, stored in row-major order, and inside a tile the bits
+ *     of the column and the row are interleaved to find a cell, so every
+ *     aligned square of 2^k x 2^k cells of a tile is stored together, for
+ *     every k at once. The padding is less than a tile edge on each side.
+ *     Besides the functions to create, free, and describe the array and
+ *     access an element, it can traverse the array in storage order, or one
+ *     piece (a tile) of it so that different pieces can be visited by
+ *     different threads.
+ */
+
+#ifndef UARRAY2M_INCLUDED
+#define UARRAY2M_INCLUDED
+
+#define T UArray2m_T
+typedef struct T *T;
+
+extern T UArray2m_new(int width, int height, int size);
+extern void UArray2m_free(T *array2m);
+extern int UArray2m_width(T array2m);
+extern int UArray2m_height(T array2m);
+extern int UArray2m_size(T array2m);
+extern int UArray2m_pieceEdge(T array2m);
+extern int UArray2m_pieces(T array2m);
+extern void *UArray2m_at(T array2m, int column, int row);
+extern void UArray2m_map(T array2m, void apply(int col, int row, T array2m,
+                         void *elem, void *cl), void *cl);
+extern void UArray2m_map_piece(T array2m, int piece,
+                               void apply(int col, int row, T array2m,
+                               void *elem, void *cl), void *cl);
+
+#undef T
+#endif
@@ -0,0 +1,580 @@
+/*
+ *     uring.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the io_uring backend. A ring is the
+ *            submission and completion queues the kernel shares with the
+ *            thread, mapped into memory: a request is an entry written into
+ *            the next slot of the submission queue, io_uring_enter hands the
+ *            new entries to the kernel and waits for at least one to be
+ *            done, and every done request leaves an entry in the completion
+ *            queue, tagged with the number of its chunk.
+ *
+ *            Reads go straight into the caller's memory, chunkBytes at a
+ *            time with up to depth of them in flight. Writes take turns in
+ *            depth chunk buffers registered with the kernel once per ring,
+ *            so it does not have to map them again for every write: the
+ *            caller packs the next chunk into a free buffer while the others
+ *            are being written. A read or write that is cut short is
+ *            submitted again for what is left.
+ *
+ *            The rings are kept in a thread-specific key and torn down when
+ *            their thread ends. A thread whose ring could not be made keeps
+ *            a marker instead, so it does not try again.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <mem.h>
+
+#include "assert.h"
+#include "uring.h"
+
+#define chunkBytes (1 << 20)
+#define defaultDepth 8
+#define maxDepth 64
+#define modeVariable "UARRAY2_IO"
+
+/**********struct ring********
+ * About: This struct holds the ring of a thread: its file descriptor, the
+ *        mappings of its queues and where their heads, tails, masks, and
+ *        entries are in them, and the chunk buffers for writing. registered
+ *        tells whether the kernel took the buffers; if not, they are written
+ *        like any other memory.
+************************/
+struct ring {
+        int fd;
+        int depth;
+        void *sqMap;
+        size_t sqMapBytes;
+        void *cqMap;
+        size_t cqMapBytes;
+        struct io_uring_sqe *sqes;
+        size_t sqesBytes;
+        unsigned *sqHead;
+        unsigned *sqTail;
+        unsigned *sqMask;
+        unsigned *sqArray;
+        unsigned *cqHead;
+        unsigned *cqTail;
+        unsigned *cqMask;
+        struct io_uring_cqe *cqes;
+        unsigned char *buffers; /* depth chunks, page aligned */
+        bool registered;
+        unsigned queued; /* entries written but not handed to the kernel */
+};
+
+/**********struct chunk********
+ * About: This struct holds a request in flight: where its bytes are, how
+ *        many of them are done, and where they go in the file
+************************/
+struct chunk {
+        unsigned char *bytes;
+        size_t length;
+        size_t done;
+        off_t offset;
+};
+
+static pthread_once_t modeOnce = PTHREAD_ONCE_INIT;
+static pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+static pthread_once_t warnOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t ringKey;
+static int mode = -1;
+static int depth = defaultDepth;
+static struct ring noRing; /* the marker of a thread without a ring */
+
+static void readMode(void);
+static void makeKey(void);
+static void warnStdio(void);
+static struct ring *threadRing(void);
+static struct ring *newRing(void);
+static void freeRing(void *ringStruct);
+static void submit(struct ring *ring, int fd, int opcode, int index,
+                   struct chunk *chunk);
+static bool complete(struct ring *ring, struct io_uring_cqe *done);
+
+/**********uringParseMode********
+ * About: This function finds the mode with the given name
+ * Inputs:
+ * const char *name: "stdio" or "uring"
+ * Return: uringOff or uringOn; -1 for any other name
+************************/
+int uringParseMode(const char *name)
+{
+        if (name == NULL)
+                return -1;
+        if (strcmp(name, "stdio") == 0)
+                return uringOff;
+        if (strcmp(name, "uring") == 0)
+                return uringOn;
+        return -1;
+}
+
+/**********uringSetMode********
+ * About: This function sets the backend, in place of the mode of the
+ *        environment
+ * Inputs:
+ * int newMode: uringOff or uringOn
+ * Return: none
+ * Expects
+ * - newMode to be one of the modes; throws CRE otherwise
+ * Note: It should be called before any I/O is done.
+************************/
+void uringSetMode(int newMode)
+{
+        assert(newMode == uringOff || newMode == uringOn);
+        mode = newMode;
+}
+
+/**********uringSetDepth********
+ * About: This function sets the queue depth of the rings made from now on:
+ *        the number of chunks in flight at once
+ * Inputs:
+ * int newDepth: the depth, from 1 to maxDepth
+ * Return: none
+ * Expects
+ * - newDepth to be from 1 to maxDepth; throws CRE otherwise
+ * Note: It should be called before any I/O is done.
+************************/
+void uringSetDepth(int newDepth)
+{
+        assert(newDepth >= 1 && newDepth <= maxDepth);
+        depth = newDepth;
+}
+
+/**********uringEnabled********
+ * About: This function tells whether the io_uring backend is chosen and
+ *        works on the calling thread
+ * Inputs: none
+ * Return: true if uringRead and uringWrite can be used; false otherwise
+************************/
+bool uringEnabled(void)
+{
+        return threadRing() != NULL;
+}
+
+/**********uringRead********
+ * About: This function reads bytes of a file through the ring of the
+ *        calling thread
+ * Inputs:
+ * int fd: the file, which must be able to seek
+ * void *buffer: where to store the bytes
+ * size_t length: the number of bytes
+ * off_t offset: where the bytes start in the file
+ * Return: true if every byte was read; false if the ring cannot be used,
+ *         the file ends early, or a read fails (the caller should then read
+ *         the bytes its own way)
+************************/
+bool uringRead(int fd, void *buffer, size_t length, off_t offset)
+{
+        struct ring *ring = threadRing();
+        if (ring == NULL)
+                return false;
+
+        struct chunk chunks[maxDepth];
+        size_t next = 0;
+        int inFlight = 0;
+        bool ok = true;
+        for (int i = 0; i < ring->depth && next < length; i++) {
+                size_t n = length - next < chunkBytes ? length - next :
+                                                        chunkBytes;
+                chunks[i] = (struct chunk){ (unsigned char *)buffer + next,
+                                            n, 0, offset + next };
+                submit(ring, fd, IORING_OP_READ, i, &chunks[i]);
+                next += n;
+                inFlight++;
+        }
+
+        /* a chunk that is done starts the next one in its place */
+        while (inFlight > 0) {
+                struct io_uring_cqe done;
+                if (!complete(ring, &done)) {
+                        ok = false;
+                        break;
+                }
+                int i = done.user_data;
+                if (done.res == -EINTR || done.res == -EAGAIN) {
+                        submit(ring, fd, IORING_OP_READ, i, &chunks[i]);
+                        continue;
+                }
+                if (done.res <= 0)
+                        ok = false;
+                else
+                        chunks[i].done += done.res;
+                if (ok && chunks[i].done < chunks[i].length) {
+                        submit(ring, fd, IORING_OP_READ, i, &chunks[i]);
+                        continue;
+                }
+                inFlight--;
+                if (ok && next < length) {
+                        size_t n = length - next < chunkBytes ?
+                                   length - next : chunkBytes;
+                        chunks[i] = (struct chunk){ (unsigned char *)buffer +
+                                                    next, n, 0,
+                                                    offset + next };
+                        submit(ring, fd, IORING_OP_READ, i, &chunks[i]);
+                        next += n;
+                        inFlight++;
+                }
+        }
+        return ok;
+}
+
+/**********uringWrite********
+ * About: This function writes the output of fill to a file through the ring
+ *        of the calling thread, starting at the current position of the
+ *        file, which is then moved past the output. fill is called for the
+ *        next chunk while the previous ones are being written. Like
+ *        Pnm_ppmwrite, it stops quietly if the output cannot be written.
+ * Inputs:
+ * int fd: the file; only a regular file that is not in append mode is
+ * written this way
+ * size_t total: bytes of the whole output
+ * uringFill fill: packs the next bytes of the output into a buffer
+ * void *cl: the closure of fill
+ * Return: false if the ring or the file cannot be used (nothing was
+ *         written); true otherwise
+************************/
+bool uringWrite(int fd, size_t total, uringFill fill, void *cl)
+{
+        struct ring *ring = threadRing();
+        if (ring == NULL)
+                return false;
+        struct stat info;
+        int flags = fcntl(fd, F_GETFL);
+        off_t start = lseek(fd, 0, SEEK_CUR);
+        if (start < 0 || flags < 0 || (flags & O_APPEND) ||
+            fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+                return false;
+
+        int opcode = ring->registered ? IORING_OP_WRITE_FIXED :
+                                        IORING_OP_WRITE;
+        struct chunk chunks[maxDepth];
+        int idle[maxDepth];
+        int idleCount = 0;
+        for (int i = ring->depth - 1; i >= 0; i--)
+                idle[idleCount++] = i;
+        size_t packed = 0;
+        int inFlight = 0;
+        bool ok = true;
+        for (;;) {
+                /* fill every free buffer before waiting */
+                while (ok && packed < total && idleCount > 0) {
+                        int i = idle[--idleCount];
+                        unsigned char *bytes = ring->buffers +
+                                               (size_t)i * chunkBytes;
+                        size_t n = fill(bytes, chunkBytes, cl);
+                        if (n == 0) {
+                                idle[idleCount++] = i;
+                                ok = false;
+                                break;
+                        }
+                        chunks[i] = (struct chunk){ bytes, n, 0,
+                                                    start + packed };
+                        submit(ring, fd, opcode, i, &chunks[i]);
+                        packed += n;
+                        inFlight++;
+                }
+                if (inFlight == 0)
+                        break;
+
+                struct io_uring_cqe done;
+                if (!complete(ring, &done)) {
+                        ok = false;
+                        break;
+                }
+                int i = done.user_data;
+                if (done.res == -EINTR || done.res == -EAGAIN) {
+                        submit(ring, fd, opcode, i, &chunks[i]);
+                        continue;
+                }
+                if (done.res <= 0)
+                        ok = false;
+                else
+                        chunks[i].done += done.res;
+                if (ok && chunks[i].done < chunks[i].length) {
+                        submit(ring, fd, opcode, i, &chunks[i]);
+                        continue;
+                }
+                idle[idleCount++] = i;
+                inFlight--;
+        }
+
+        lseek(fd, start + packed, SEEK_SET);
+        return true;
+}
+
+/**********uringStream********
+ * About: This function reads a whole input file through the ring of the
+ *        calling thread and opens the bytes in memory as a stream, so a
+ *        reader like Pnm_ppmread makes no system call at all
+ * Inputs:
+ * FILE *fp: the input file, not read yet
+ * void **contents: where to store the bytes, which the caller frees with
+ * FREE after closing the stream
+ * Return: the stream, or NULL if the ring or the file cannot be used (the
+ *         caller should then read fp)
+************************/
+FILE *uringStream(FILE *fp, void **contents)
+{
+        assert(fp != NULL && contents != NULL);
+        if (threadRing() == NULL)
+                return NULL;
+        int fd = fileno(fp);
+        struct stat info;
+        off_t start = ftello(fp);
+        if (start < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+            info.st_size <= start)
+                return NULL;
+
+        size_t length = info.st_size - start;
+        char *bytes = ALLOC(length);
+        FILE *stream = NULL;
+        if (uringRead(fd, bytes, length, start))
+                stream = fmemopen(bytes, length, "r");
+        if (stream == NULL) {
+                FREE(bytes);
+                return NULL;
+        }
+        *contents = bytes;
+        return stream;
+}
+
+/**********threadRing********
+ * About: This function returns the ring of the calling thread, making it
+ *        the first time
+ * Inputs: none
+ * Return: the ring; NULL if the stdio backend is chosen or no ring can be
+ *         made
+************************/
+static struct ring *threadRing(void)
+{
+        pthread_once(&modeOnce, readMode);
+        if (mode != uringOn)
+                return NULL;
+        pthread_once(&keyOnce, makeKey);
+        struct ring *ring = pthread_getspecific(ringKey);
+        if (ring == NULL) {
+                ring = newRing();
+                if (ring == NULL) {
+                        pthread_once(&warnOnce, warnStdio);
+                        ring = &noRing;
+                }
+                pthread_setspecific(ringKey, ring);
+        }
+        return ring == &noRing ? NULL : ring;
+}
+
+/**********newRing********
+ * About: This function sets up a ring and its chunk buffers
+ * Inputs: none
+ * Return: the ring; NULL if the kernel has no io_uring, forbids it, or
+ *         lacks the plain read and write requests (before Linux 5.6)
+************************/
+static struct ring *newRing(void)
+{
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = syscall(SYS_io_uring_setup, depth, &params);
+        if (fd < 0)
+                return NULL;
+        if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+                close(fd);
+                return NULL;
+        }
+
+        struct ring *ring;
+        NEW(ring);
+        memset(ring, 0, sizeof(*ring));
+        ring->fd = fd;
+        ring->depth = depth;
+        ring->sqMapBytes = params.sq_off.array +
+                           params.sq_entries * sizeof(unsigned);
+        ring->cqMapBytes = params.cq_off.cqes +
+                           params.cq_entries * sizeof(struct io_uring_cqe);
+        ring->sqesBytes = params.sq_entries * sizeof(struct io_uring_sqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single && ring->cqMapBytes > ring->sqMapBytes)
+                ring->sqMapBytes = ring->cqMapBytes;
+
+        ring->sqMap = mmap(NULL, ring->sqMapBytes, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        ring->cqMap = single ? ring->sqMap :
+                      mmap(NULL, ring->cqMapBytes, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        ring->sqes = mmap(NULL, ring->sqesBytes, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        ring->buffers = mmap(NULL, (size_t)depth * chunkBytes,
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring->sqMap == MAP_FAILED || ring->cqMap == MAP_FAILED ||
+            ring->sqes == MAP_FAILED || ring->buffers == MAP_FAILED) {
+                freeRing(ring);
+                return NULL;
+        }
+
+        char *sq = ring->sqMap;
+        char *cq = ring->cqMap;
+        ring->sqHead = (unsigned *)(sq + params.sq_off.head);
+        ring->sqTail = (unsigned *)(sq + params.sq_off.tail);
+        ring->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+        ring->sqArray = (unsigned *)(sq + params.sq_off.array);
+        ring->cqHead = (unsigned *)(cq + params.cq_off.head);
+        ring->cqTail = (unsigned *)(cq + params.cq_off.tail);
+        ring->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+        ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+        /* registering may fail (e.g. past the locked memory limit); the
+         * buffers are then written without it */
+        struct iovec iov[maxDepth];
+        for (int i = 0; i < depth; i++) {
+                iov[i].iov_base = ring->buffers + (size_t)i * chunkBytes;
+                iov[i].iov_len = chunkBytes;
+        }
+        ring->registered = syscall(SYS_io_uring_register, fd,
+                                   IORING_REGISTER_BUFFERS, iov, depth) == 0;
+        return ring;
+}
+
+/**********freeRing********
+ * About: This function tears down a ring; it is the destructor of the key
+ * Inputs:
+ * void *ringStruct: the ring, or the marker of a thread without one
+ * Return: none
+************************/
+static void freeRing(void *ringStruct)
+{
+        struct ring *ring = ringStruct;
+        if (ring == &noRing)
+                return;
+        if (ring->buffers != NULL && ring->buffers != MAP_FAILED)
+                munmap(ring->buffers, (size_t)ring->depth * chunkBytes);
+        if (ring->sqes != NULL && ring->sqes != MAP_FAILED)
+                munmap(ring->sqes, ring->sqesBytes);
+        if (ring->cqMap != NULL && ring->cqMap != MAP_FAILED &&
+            ring->cqMap != ring->sqMap)
+                munmap(ring->cqMap, ring->cqMapBytes);
+        if (ring->sqMap != NULL && ring->sqMap != MAP_FAILED)
+                munmap(ring->sqMap, ring->sqMapBytes);
+        close(ring->fd);
+        FREE(ring);
+}
+
+/**********submit********
+ * About: This function writes a request for the rest of a chunk into the
+ *        submission queue; complete hands it to the kernel
+ * Inputs:
+ * struct ring *ring: the ring
+ * int fd: the file to read or write
+ * int opcode: IORING_OP_READ, IORING_OP_WRITE, or IORING_OP_WRITE_FIXED
+ * int index: the number of the chunk (and of its buffer for a fixed write)
+ * struct chunk *chunk: the chunk
+ * Return: none
+ * Note: There is always a free entry, since no more than depth requests
+ * are in flight.
+************************/
+static void submit(struct ring *ring, int fd, int opcode, int index,
+                   struct chunk *chunk)
+{
+        unsigned tail = *ring->sqTail;
+        unsigned slot = tail & *ring->sqMask;
+        struct io_uring_sqe *sqe = &ring->sqes[slot];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->addr = (uintptr_t)(chunk->bytes + chunk->done);
+        sqe->len = chunk->length - chunk->done;
+        sqe->off = chunk->offset + chunk->done;
+        sqe->user_data = index;
+        if (opcode == IORING_OP_WRITE_FIXED)
+                sqe->buf_index = index;
+        ring->sqArray[slot] = slot;
+        ring->queued++;
+
+        /* the entry must be in place before the kernel sees the tail */
+        __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**********complete********
+ * About: This function hands the queued requests to the kernel, waits for
+ *        one request to be done, and takes it off the completion queue
+ * Inputs:
+ * struct ring *ring: the ring
+ * struct io_uring_cqe *done: where to store the completion
+ * Return: true if a completion was taken; false if io_uring_enter failed
+************************/
+static bool complete(struct ring *ring, struct io_uring_cqe *done)
+{
+        for (;;) {
+                unsigned head = *ring->cqHead;
+                unsigned tail = __atomic_load_n(ring->cqTail,
+                                                __ATOMIC_ACQUIRE);
+                if (head != tail) {
+                        *done = ring->cqes[head & *ring->cqMask];
+                        __atomic_store_n(ring->cqHead, head + 1,
+                                         __ATOMIC_RELEASE);
+                        return true;
+                }
+                int n = syscall(SYS_io_uring_enter, ring->fd, ring->queued,
+                                1, IORING_ENTER_GETEVENTS, NULL, 0);
+                if (n < 0 && errno != EINTR)
+                        return false;
+                if (n > 0)
+                        ring->queued -= n;
+        }
+}
+
+/**********readMode********
+ * About: This function reads the mode from the environment, unless
+ *        uringSetMode already chose one; an unknown name is stdio
+ * Inputs: none
+ * Return: none
+************************/
+static void readMode(void)
+{
+        if (mode >= 0)
+                return;
+        const char *name = getenv(modeVariable);
+        mode = uringParseMode(name);
+        if (mode < 0 && name != NULL && *name != '\0')
+                fprintf(stderr, "%s: unknown mode '%s', using stdio\n",
+                        modeVariable, name);
+        if (mode < 0)
+                mode = uringOff;
+}
+
+/**********makeKey********
+ * About: This function makes the key that holds the ring of every thread
+ * Inputs: none
+ * Return: none
+************************/
+static void makeKey(void)
+{
+        int status = pthread_key_create(&ringKey, freeRing);
+        assert(status == 0);
+}
+
+/**********warnStdio********
+ * About: This function tells the user, once, that io_uring was asked for
+ *        but cannot be had
+ * Inputs: none
+ * Return: none
+************************/
+static void warnStdio(void)
+{
+        fprintf(stderr, "io_uring is not available, using stdio\n");
+}
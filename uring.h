@@ -0,0 +1,47 @@
+/*
+ *     uring.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the I/O backend used for reading input files
+ *            and writing output files:
+ *              stdio  read, mmap, and writev, one call at a time (the
+ *                     default)
+ *              uring  the reads of an input file and the writes of an output
+ *                     file go through an io_uring, several chunks at a time,
+ *                     so the kernel works on the next chunks while the
+ *                     program packs pixels, and one system call hands over
+ *                     or collects many of them
+ *            Every thread gets its own ring, made the first time it does
+ *            I/O, with a queue depth set by uringSetDepth (8 by default) and
+ *            as many chunk buffers registered with the kernel for writing.
+ *            When the kernel has no io_uring (or forbids it), every function
+ *            here says so and the callers use the stdio path. The mode is
+ *            set by uringSetMode, or else read from the UARRAY2_IO
+ *            environment variable. The rings are set up with the raw system
+ *            calls, so liburing is not needed.
+ */
+
+#ifndef URING_INCLUDED
+#define URING_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define uringOff 0
+#define uringOn 1
+
+/* fills buffer with at most space bytes of the output; returns how many */
+typedef size_t uringFill(unsigned char *buffer, size_t space, void *cl);
+
+extern int uringParseMode(const char *name);
+extern void uringSetMode(int mode);
+extern void uringSetDepth(int depth);
+extern bool uringEnabled(void);
+extern bool uringRead(int fd, void *buffer, size_t length, off_t offset);
+extern bool uringWrite(int fd, size_t total, uringFill fill, void *cl);
+extern FILE *uringStream(FILE *fp, void **contents);
+
+#endif
@@ -0,0 +1,378 @@
+/*
+ *     writer.c
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file implements the P6 writer. The pixels are visited in
+ *            the order of the output file, but in runs that are contiguous in
+ *            memory: a whole row of a plain array, or the part of a row inside
+ *            one block of a blocked array. methods->at is only called once per
+ *            run, and every Pnm_rgb of the run is packed to 3 bytes (6 bytes
+ *            of big-endian samples when the maxval is over 255). Arrays that
+ *            already hold the pixels in a compact format (see kernels.h) are
+ *            copied run by run, dropping the padding byte of RGBX8.
+ *
+ *            Into a file or a terminal, the packed bytes go through one page
+ *            aligned chunkBytes buffer that is written with writev (the header
+ *            and the first chunk in one call). With the io_uring backend (see
+ *            uring.h), a file is written through the ring instead, a chunk
+ *            being packed while the ones before it are written. Into a pipe,
+ *            every chunk is packed into an anonymous mapping of its own and
+ *            handed to the pipe with vmsplice, so the kernel takes the pages
+ *            instead of copying them. vmsplice lets the reader see the pages
+ *            themselves, so they are never written again: the mapping of a
+ *            chunk is unmapped once it is spliced (the pages stay alive until
+ *            the pipe lets go of them) and the next chunk gets fresh pages.
+ *            The writer then holds one chunk at a time, however large the
+ *            image is.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <mem.h>
+
+#include "assert.h"
+#include "writer.h"
+#include "kernels.h"
+#include "a2methods.h"
+#include "uring.h"
+
+/* bytes packed before they are handed to the kernel; a multiple of the
+ * page size */
+#define chunkBytes (1 << 20)
+#define pageBytes 4096
+
+/**********struct packer********
+ * About: This struct holds the image being written and the next pixel to
+ *        pack. size is the element size of the array and pixelBytes the
+ *        size of a pixel in the file. run is the number of pixels of a row
+ *        that are contiguous in memory, starting from a column that is a
+ *        multiple of run.
+************************/
+struct packer {
+        Pnm_ppm image;
+        int size;
+        int pixelBytes;
+        unsigned run;
+        unsigned col;
+        unsigned row;
+};
+
+/**********struct headedPacker********
+ * About: This struct holds a packer and the part of the header that is not
+ *        packed yet, for fillChunk
+************************/
+struct headedPacker {
+        struct packer *packer;
+        const char *header;
+        size_t headerBytes;
+};
+
+static size_t packPixels(struct packer *packer, unsigned char *out,
+                         size_t space);
+static bool writeToPipe(int fd, struct packer *packer, const char *header,
+                        size_t headerBytes, size_t total);
+static bool writeBuffered(int fd, struct packer *packer, const char *header,
+                          size_t headerBytes, size_t total);
+static bool writeAll(int fd, struct iovec *iov, int count);
+static size_t fillChunk(unsigned char *buffer, size_t space, void *cl);
+
+/**********writeImage********
+ * About: This function prints an image as a binary (P6) ppm, like
+ *        Pnm_ppmwrite. Arrays of suites the kernels do not know are left to
+ *        Pnm_ppmwrite.
+ * Inputs:
+ * FILE *fp: the stream to write to; anything already buffered in it is
+ * flushed first, since the pixels go to its file descriptor
+ * Pnm_ppm image: the image to write
+ * Return: none
+ * Expects
+ * - fp and image to be nonnull; throws CRE otherwise
+ * Note: Like Pnm_ppmwrite, this function stops quietly if the output cannot
+ * be written.
+************************/
+void writeImage(FILE *fp, Pnm_ppm image)
+{
+        assert(fp != NULL && image != NULL);
+        A2Methods_T methods = (A2Methods_T)image->methods;
+        if (!kernelSupports(methods)) {
+                Pnm_ppmwrite(fp, image);
+                return;
+        }
+
+        char header[64];
+        int headerBytes = snprintf(header, sizeof(header), "P6\n%u %u\n%u\n",
+                                   image->width, image->height,
+                                   image->denominator);
+        assert(headerBytes > 0 && headerBytes < (int)sizeof(header));
+
+        /* a row of a plain array is contiguous; in a blocked array only the
+         * part inside a block is (a blocksize of 1 makes the whole array
+         * row major) */
+        int blocksize = methods->blocksize(image->pixels);
+        struct packer packer = { image, methods->size(image->pixels),
+                                 image->denominator > 255 ? 6 : 3,
+                                 blocksize == 1 ? image->width :
+                                                  (unsigned)blocksize,
+                                 0, 0 };
+        if (image->width == 0)
+                packer.row = image->height;
+        size_t total = headerBytes + (size_t)image->width * image->height *
+                                     packer.pixelBytes;
+
+        fflush(fp);
+        int fd = fileno(fp);
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISFIFO(info.st_mode) &&
+            writeToPipe(fd, &packer, header, headerBytes, total))
+                return;
+        struct headedPacker headed = { &packer, header, headerBytes };
+        if (uringWrite(fd, total, fillChunk, &headed))
+                return;
+        writeBuffered(fd, &packer, header, headerBytes, total);
+}
+
+/**********packPixels********
+ * About: This function packs the next pixels of the image into out, run by
+ *        run, until out is full or the image is done
+ * Inputs:
+ * struct packer *packer: the image and the next pixel to pack
+ * unsigned char *out: where to pack the pixels
+ * size_t space: bytes available in out
+ * Return: the number of bytes packed, a multiple of the pixel size
+************************/
+static size_t packPixels(struct packer *packer, unsigned char *out,
+                         size_t space)
+{
+        Pnm_ppm image = packer->image;
+        A2Methods_T methods = (A2Methods_T)image->methods;
+        size_t used = 0;
+
+        while (packer->row < image->height) {
+                size_t fits = (space - used) / packer->pixelBytes;
+                if (fits == 0)
+                        break;
+                unsigned col = packer->col;
+                unsigned end = (col / packer->run + 1) * packer->run;
+                if (end > image->width)
+                        end = image->width;
+                if (end - col > fits)
+                        end = col + fits;
+
+                const struct Pnm_rgb *pixel = methods->at(image->pixels, col,
+                                                          packer->row);
+                unsigned char *to = out + used;
+                if (packer->size == packer->pixelBytes) {
+                        size_t bytes = (size_t)(end - col) * packer->size;
+                        memcpy(to, pixel, bytes);
+                        to += bytes;
+                } else if (packer->size == pixelRgbx8) {
+                        const unsigned char *from =
+                                (const unsigned char *)pixel;
+                        for (unsigned i = col; i < end; i++) {
+                                to[0] = from[0];
+                                to[1] = from[1];
+                                to[2] = from[2];
+                                from += pixelRgbx8;
+                                to += 3;
+                        }
+                } else if (packer->pixelBytes == 3) {
+                        for (unsigned i = col; i < end; i++, pixel++) {
+                                to[0] = pixel->red;
+                                to[1] = pixel->green;
+                                to[2] = pixel->blue;
+                                to += 3;
+                        }
+                } else {
+                        for (unsigned i = col; i < end; i++, pixel++) {
+                                to[0] = pixel->red >> 8;
+                                to[1] = pixel->red;
+                                to[2] = pixel->green >> 8;
+                                to[3] = pixel->green;
+                                to[4] = pixel->blue >> 8;
+                                to[5] = pixel->blue;
+                                to += 6;
+                        }
+                }
+                used = to - out;
+
+                packer->col = end;
+                if (end == image->width) {
+                        packer->col = 0;
+                        packer->row++;
+                }
+        }
+        return used;
+}
+
+/**********fillChunk********
+ * About: This function packs the next chunk of the output for uringWrite:
+ *        the header first, then the pixels
+ * Inputs:
+ * unsigned char *buffer: where to pack the chunk
+ * size_t space: bytes available in buffer
+ * void *cl: the struct headedPacker
+ * Return: the number of bytes packed
+************************/
+static size_t fillChunk(unsigned char *buffer, size_t space, void *cl)
+{
+        struct headedPacker *headed = cl;
+        size_t used = headed->headerBytes < space ? headed->headerBytes :
+                                                    space;
+        memcpy(buffer, headed->header, used);
+        headed->header += used;
+        headed->headerBytes -= used;
+        return used + packPixels(headed->packer, buffer + used,
+                                 space - used);
+}
+
+/**********writeToPipe********
+ * About: This function packs the output one chunk at a time, each into an
+ *        anonymous mapping of its own, and splices every chunk into the
+ *        pipe before unmapping it. If vmsplice stops working part way, the
+ *        rest of the chunk and the later chunks are written with writev;
+ *        if a later mapping cannot be made, the rest goes through
+ *        writeBuffered.
+ * Inputs:
+ * int fd: the pipe
+ * struct packer *packer: the image, with no pixel packed yet
+ * const char *header, size_t headerBytes: the P6 header
+ * size_t total: bytes of the whole output
+ * Return: false if the first mapping could not be made (nothing was
+ *         written); true otherwise
+************************/
+static bool writeToPipe(int fd, struct packer *packer, const char *header,
+                        size_t headerBytes, size_t total)
+{
+        size_t sent = 0;
+        bool splicing = true;
+        bool ok = true;
+        while (ok && sent < total) {
+                size_t bytes = total - sent < chunkBytes ? total - sent :
+                                                           chunkBytes;
+                unsigned char *out = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (out == MAP_FAILED && sent == 0)
+                        return false;
+                if (out == MAP_FAILED) {
+                        writeBuffered(fd, packer, header, 0, total - sent);
+                        break;
+                }
+
+                /* a pipe as large as a chunk wakes the reader up less often;
+                 * it is fine to keep the default size if this fails */
+                size_t packed = 0;
+                if (sent == 0) {
+                        fcntl(fd, F_SETPIPE_SZ, chunkBytes);
+                        memcpy(out, header, headerBytes);
+                        packed = headerBytes;
+                }
+                packed += packPixels(packer, out + packed, bytes - packed);
+
+                size_t spliced = 0;
+                while (splicing && spliced < packed) {
+                        struct iovec iov = { out + spliced,
+                                             packed - spliced };
+                        ssize_t n = vmsplice(fd, &iov, 1, 0);
+                        if (n > 0)
+                                spliced += n;
+                        else if (n == 0 || errno != EINTR)
+                                splicing = false;
+                }
+                if (spliced < packed) {
+                        struct iovec iov = { out + spliced,
+                                             packed - spliced };
+                        ok = writeAll(fd, &iov, 1);
+                }
+
+                /* the pipe keeps the pages it was given; these addresses
+                 * are never written again */
+                munmap(out, bytes);
+                sent += packed;
+        }
+        return true;
+}
+
+/**********writeBuffered********
+ * About: This function packs the output one chunk at a time into a page
+ *        aligned buffer and writes every chunk with writev
+ * Inputs:
+ * int fd: the file descriptor to write to
+ * struct packer *packer: the image, with no pixel packed yet
+ * const char *header, size_t headerBytes: the P6 header
+ * size_t total: bytes of the whole output
+ * Return: true if everything was written; false otherwise
+************************/
+static bool writeBuffered(int fd, struct packer *packer, const char *header,
+                          size_t headerBytes, size_t total)
+{
+        char *memory = ALLOC(chunkBytes + pageBytes - 1);
+        assert(memory != NULL);
+        unsigned char *buffer = (unsigned char *)(((uintptr_t)memory +
+                                pageBytes - 1) & ~(uintptr_t)(pageBytes - 1));
+
+        /* the header goes out with the first chunk */
+        struct iovec iov[2] = { { (char *)header, headerBytes },
+                                { buffer, 0 } };
+        int first = 0;
+        size_t sent = 0;
+        bool ok = true;
+        while (ok && (sent < total || first == 0)) {
+                iov[1].iov_base = buffer;
+                iov[1].iov_len = packPixels(packer, buffer, chunkBytes);
+                size_t bytes = iov[first].iov_len +
+                               (first == 0 ? iov[1].iov_len : 0);
+                ok = writeAll(fd, &iov[first], 2 - first);
+                sent += bytes;
+                first = 1;
+        }
+
+        FREE(memory);
+        return ok;
+}
+
+/**********writeAll********
+ * About: This function writes every byte of the given buffers, calling
+ *        writev again after partial writes and interrupts
+ * Inputs:
+ * int fd: the file descriptor to write to
+ * struct iovec *iov: the buffers; changed as they are written
+ * int count: number of buffers
+ * Return: true if everything was written; false after a write error
+************************/
+static bool writeAll(int fd, struct iovec *iov, int count)
+{
+        while (count > 0) {
+                if (iov->iov_len == 0) {
+                        iov++;
+                        count--;
+                        continue;
+                }
+                ssize_t n = writev(fd, iov, count);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return false;
+                }
+                while (count > 0 && (size_t)n >= iov->iov_len) {
+                        n -= iov->iov_len;
+                        iov++;
+                        count--;
+                }
+                if (count > 0) {
+                        iov->iov_base = (char *)iov->iov_base + n;
+                        iov->iov_len -= n;
+                }
+        }
+        return true;
+}
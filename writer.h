@@ -0,0 +1,21 @@
+/*
+ *     writer.h
+ *     by Doga Kilinc (dkilin01) & Cansu Birsen (cbirse01), October 10
+ *     HW3: locality
+ *
+ *     About: This file holds the P6 writer used in place of Pnm_ppmwrite. It
+ *            packs the pixels of plain and blocked arrays into large buffers
+ *            straight from their rows, without calling methods->at for every
+ *            pixel, and hands the buffers to the kernel with writev, or with
+ *            vmsplice when the output is a pipe.
+ */
+
+#ifndef WRITER_INCLUDED
+#define WRITER_INCLUDED
+
+#include <stdio.h>
+#include "pnm.h"
+
+extern void writeImage(FILE *fp, Pnm_ppm image);
+
+#endif